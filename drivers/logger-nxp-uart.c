@@ -15,6 +15,7 @@
 #include "fsl_usart.h"
 
 #include "logger.h"
+#include "logger-fmt.h"
 
 char uart_logger_buffer[MAX_STR_LEN + 1] = { 0 };
 
@@ -43,11 +44,8 @@ static int _init_uart(void *drv)
 static void _print_header(struct line_info_t *linfo)
 {
 	memset(uart_logger_buffer, 0, MAX_STR_LEN + 1);
-	snprintf(uart_logger_buffer, MAX_HDR_LEN,
-		 "[%s%5s%s] (%20s)(%30s @%3d) : ",
-		 _log_levels[logger_mask2id(linfo->lvl)].color,
-		 _log_levels[logger_mask2id(linfo->lvl)].name,
-		 RESET, linfo->file, linfo->fn, linfo->ln);
+	logger_fmt_header(uart_logger_buffer, MAX_HDR_LEN, linfo->lvl,
+			  linfo->file, linfo->fn, linfo->ln);
 	USART_WriteBlocking(_ctxt.base, uart_logger_buffer,
 			    strlen(uart_logger_buffer));
 }
@@ -60,7 +58,7 @@ static int _write_uart(void *priv, struct line_info_t *linfo, char *fmt,
 	_print_header(linfo);
 
 	memset(uart_logger_buffer, 0, MAX_STR_LEN + 1);
-	vsnprintf(uart_logger_buffer, MAX_STR_LEN, fmt, *v);
+	logger_fmt_vformat(uart_logger_buffer, MAX_STR_LEN, fmt, *v);
 	USART_WriteBlocking(_ctxt.base, uart_logger_buffer,
 			    strlen(uart_logger_buffer));
 	USART_WriteBlocking(_ctxt.base, "\r\n", 2);
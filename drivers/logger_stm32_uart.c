@@ -13,6 +13,7 @@
 #include "main.h"
 
 #include "logger.h"
+#include "logger-fmt.h"
 
 static uint8_t uart_logger_buffer[MAX_STR_LEN + 1] = { 0 };
 
@@ -60,11 +61,8 @@ static int _init_uart(void *drv)
 static void _print_header(struct line_info_t *linfo)
 {
 	memset(uart_logger_buffer, 0, MAX_STR_LEN + 1);
-	snprintf((char *)uart_logger_buffer, MAX_HDR_LEN,
-		 "[%s%5s%s] (%20s)(%30s @%3d) : ",
-		 _log_levels[logger_mask2id(linfo->lvl)].color,
-		 _log_levels[logger_mask2id(linfo->lvl)].name,
-		 RESET, linfo->file, linfo->fn, linfo->ln);
+	logger_fmt_header((char *)uart_logger_buffer, MAX_HDR_LEN, linfo->lvl,
+			  linfo->file, linfo->fn, linfo->ln);
 	HAL_UART_Transmit(_ctxt.handle, uart_logger_buffer,
 			  strlen((char *)uart_logger_buffer), 1000);
 }
@@ -79,7 +77,7 @@ static int _write_uart(void *priv, struct line_info_t *linfo, char *fmt,
 	}
 
 	memset(uart_logger_buffer, 0, MAX_STR_LEN + 1);
-	vsnprintf((char *)uart_logger_buffer, MAX_STR_LEN, fmt, *v);
+	logger_fmt_vformat((char *)uart_logger_buffer, MAX_STR_LEN, fmt, *v);
 	HAL_UART_Transmit(_ctxt.handle, uart_logger_buffer,
 			  strlen((char *)uart_logger_buffer), 1000);
 	HAL_UART_Transmit(_ctxt.handle, (uint8_t *)"\r\n", 2, 1000);
@@ -3,11 +3,29 @@
  * @brief Header file for Circular buffer implementation
  * @author Bram Vlerick <bram.vlerick@openpixelsystems.org> (v1.0, v2.1)
  * @author Laurens Miers <laurens.miers@mind.be> (v2.0)
- * @version v2.1
- * @date 2020-04-20
+ * @version v3.1
+ * @date 2026-10-16
  */
 
 /**
+ * Notable changes with v3.1:
+ * - The producer and the consumer index live on separate cache lines, each
+ *   side keeps a cached copy of the other side's index and only reloads it
+ *   when the buffer looks full (producer) or empty (consumer). In SPSC mode a
+ *   write or read no longer touches a cache line owned by the other side.
+ * - current_nr_elements is gone, cbuffer_get_count() derives the count from
+ *   both indices and never writes to the cbuffer.
+ * - Per-slot sequence numbers are only used (and allocated) in MPSC mode.
+ *
+ * Notable changes with v3.0:
+ * - Read / Write positions are tracked with per-slot sequence numbers. A slot
+ *   can only be written when its sequence matches the write position and only
+ *   be read once the producer has published it.
+ * - Added a lock-free multi-producer mode (CBUFFER_MODE_MPSC). Producers claim
+ *   a slot with a CAS on the write position. Every thread can hold one write
+ *   pointer at a time, cbuffer_signal_element_written publishes the slot that
+ *   was claimed by the calling thread.
+ *
  * Notable changes with v2.0:
  * - Write / Read pointer validity no longer depends on current_nr_elements.
  *   While current_nr_elements is still susceptive to race-conditions it no longer
@@ -28,9 +46,17 @@
 #include <stdatomic.h>
 
 /* #define CBUFFER_DEBUG_OUTPUT */
-/* #define CBUFFER_VALIDATE_PTRS */
 /* #define CBUFFER_VALIDATE_USAGE */
 
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+#define CBUFFER_THREAD_LOCAL _Thread_local
+#else
+#define CBUFFER_THREAD_LOCAL
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+/** Keeps the producer and consumer side on separate cache lines */
+#define CBUFFER_CACHE_LINE 64
+
 #define CBUF_INFO(msg, ...) \
 	printf("(INFO) %s: %s: (%d) " msg "\n", __FILE__, __FUNCTION__, __LINE__,      \
 	       ## __VA_ARGS__)
@@ -46,27 +72,39 @@
 #define CBUF_DEBUG(msg, ...) while (0) {};
 #endif
 
+/**
+ * @brief Cbuffer producer modes
+ */
+enum cbuffer_mode_t {
+	CBUFFER_MODE_SPSC = 0,  //!< Single producer, single consumer
+	CBUFFER_MODE_MPSC,      //!< Multiple producers, single consumer
+};
+
 /**
  * @brief Cbuffer data structure
  */
 struct cbuffer_t {
-	int	nr_elements;            //!< Number of elements available
-	atomic_int	current_nr_elements;    //!< Current Number of elements
-
-	void **		rp;                     //!< Current read pointer
-	void **		wp;                     //!< Current write pointer
-
+	/* Read-only after init */
+	int			nr_elements;    //!< Number of elements available
+	enum cbuffer_mode_t	mode;           //!< Producer mode
+	atomic_size_t *		seq;            //!< Sequence number per slot (MPSC)
+	void **			data;           //!< The actual data elements
+
+	/* Producer side */
+	_Alignas(CBUFFER_CACHE_LINE)
+	atomic_size_t		head;           //!< Next position to write
+	size_t			tail_cache;     //!< Last seen tail (SPSC)
 #ifdef CBUFFER_VALIDATE_USAGE
-	bool		rp_in_use;      //!< Is a write pointer in use?
-	bool		wp_in_use;      //!< Is a read pointer in use?
+	bool			wp_in_use;      //!< Is a write pointer in use? (SPSC)
 #endif /* CBUFFER_VALIDATE_USAGE */
 
-#ifdef CBUFFER_VALIDATE_PTRS
-	uint8_t		rp_index;       //!< Current wp index in data
-	uint8_t		wp_index;       //!< Current rp index in data
-#endif /* CBUFFER_VALIDATE_PTRS */
-
-	void **		data; //!< The actual data elements
+	/* Consumer side */
+	_Alignas(CBUFFER_CACHE_LINE)
+	atomic_size_t		tail;           //!< Next position to read
+	size_t			head_cache;     //!< Last seen head (SPSC)
+#ifdef CBUFFER_VALIDATE_USAGE
+	bool			rp_in_use;      //!< Is a read pointer in use?
+#endif /* CBUFFER_VALIDATE_USAGE */
 };
 
 
@@ -79,6 +117,37 @@ struct cbuffer_t {
  */
 struct cbuffer_t *cbuffer_init_cbuffer(int nr_elements);
 
+/**
+ * @brief  Initialize the cbuffer for a given producer mode
+ *
+ * @param nr_elements Number of elements the buffer should hold
+ * @param mode Producer mode
+ *
+ * @returns  NULL if failed, otherwise an allocated cbuffer
+ */
+struct cbuffer_t *cbuffer_init_cbuffer_mode(int nr_elements,
+					    enum cbuffer_mode_t mode);
+
+/**
+ * @brief  Claim a slot in a multi-producer cbuffer
+ *
+ * Use cbuffer_get_write_pointer instead.
+ *
+ * @param cbuf The cbuffer in which a slot will be claimed
+ *
+ * @returns  NULL if full, otherwise the data pointer of the claimed slot
+ */
+void *cbuffer_claim_write_pointer_mpsc(struct cbuffer_t *cbuf);
+
+/**
+ * @brief  Retrieve the slot claimed by the calling thread
+ *
+ * @param cbuf The cbuffer in which the slot was claimed
+ *
+ * @returns  NULL if no slot was claimed, otherwise a pointer to the data pointer
+ */
+void **cbuffer_claimed_slot_mpsc(struct cbuffer_t *cbuf);
+
 /**
  * @brief  Retrieve the cbuffer size
  *
@@ -97,18 +166,20 @@ static inline int cbuffer_get_size(struct cbuffer_t *cbuf)
 /**
  * @brief  Retrieve the cbuffer count
  *
+ * In MPSC mode slots that are claimed but not yet written are counted as well.
+ *
  * @param cbuf Cbuffer of which we retrieve the count
  *
- * @returns  The size or -1 if failed
+ * @returns  The count or -1 if failed
  */
 static inline int cbuffer_get_count(struct cbuffer_t *cbuf)
 {
 	if (cbuf) {
-		if (atomic_load(&cbuf->current_nr_elements) < 0) {
-			/* Recover from previously commited crimes.. don't worry */
-			atomic_store(&cbuf->current_nr_elements, 0);
-		}
-		return atomic_load(&cbuf->current_nr_elements);
+		/* The tail never passes the head, load it first */
+		size_t tail = atomic_load_explicit(&cbuf->tail, memory_order_acquire);
+		size_t head = atomic_load_explicit(&cbuf->head, memory_order_acquire);
+
+		return (int)(head - tail);
 	}
 	return -1;
 }
@@ -122,13 +193,26 @@ static inline int cbuffer_get_count(struct cbuffer_t *cbuf)
  */
 static inline void *cbuffer_get_read_pointer(struct cbuffer_t *cbuf)
 {
-	if (!cbuf || !cbuf->rp) {
-		CBUF_ERR("Invalid argument, cbuf || cbuf->rp == NULL");
+	if (!cbuf || !cbuf->data) {
+		CBUF_ERR("Invalid argument, cbuf || cbuf->data == NULL");
 		return NULL;
 	}
 
-	if (!cbuffer_get_count(cbuf)) {
-		return NULL;
+	size_t pos = atomic_load_explicit(&cbuf->tail, memory_order_relaxed);
+	size_t idx = pos % cbuf->nr_elements;
+
+	if (cbuf->mode == CBUFFER_MODE_MPSC) {
+		if (atomic_load_explicit(&cbuf->seq[idx], memory_order_acquire) != pos + 1) {
+			/* Empty or not yet published */
+			return NULL;
+		}
+	} else if (pos == cbuf->head_cache) {
+		cbuf->head_cache = atomic_load_explicit(&cbuf->head,
+							memory_order_acquire);
+		if (pos == cbuf->head_cache) {
+			/* Empty */
+			return NULL;
+		}
 	}
 
 #ifdef CBUFFER_VALIDATE_USAGE
@@ -139,7 +223,7 @@ static inline void *cbuffer_get_read_pointer(struct cbuffer_t *cbuf)
 	cbuf->rp_in_use = true;
 #endif /* CBUFFER_VALIDATE_USAGE */
 
-	return *cbuf->rp;
+	return cbuf->data[idx];
 }
 
 /**
@@ -151,13 +235,24 @@ static inline void *cbuffer_get_read_pointer(struct cbuffer_t *cbuf)
  */
 static inline void *cbuffer_get_write_pointer(struct cbuffer_t *cbuf)
 {
-	if (!cbuf || !cbuf->wp) {
-		CBUF_ERR("Invalid argument, cbuf || cbuf->wp == NULL");
+	if (!cbuf || !cbuf->data) {
+		CBUF_ERR("Invalid argument, cbuf || cbuf->data == NULL");
 		return NULL;
 	}
 
-	if (cbuffer_get_count(cbuf) == cbuf->nr_elements) {
-		return NULL;
+	if (cbuf->mode == CBUFFER_MODE_MPSC) {
+		return cbuffer_claim_write_pointer_mpsc(cbuf);
+	}
+
+	size_t pos = atomic_load_explicit(&cbuf->head, memory_order_relaxed);
+
+	if (pos - cbuf->tail_cache == (size_t)cbuf->nr_elements) {
+		cbuf->tail_cache = atomic_load_explicit(&cbuf->tail,
+							memory_order_acquire);
+		if (pos - cbuf->tail_cache == (size_t)cbuf->nr_elements) {
+			/* Full, the oldest slot still holds an unread element */
+			return NULL;
+		}
 	}
 
 #ifdef CBUFFER_VALIDATE_USAGE
@@ -168,7 +263,7 @@ static inline void *cbuffer_get_write_pointer(struct cbuffer_t *cbuf)
 	cbuf->wp_in_use = true;
 #endif /* CBUFFER_VALIDATE_USAGE */
 
-	return *cbuf->wp;
+	return cbuf->data[pos % cbuf->nr_elements];
 }
 
 /**
@@ -180,28 +275,37 @@ static inline void *cbuffer_get_write_pointer(struct cbuffer_t *cbuf)
  */
 static inline void **cbuffer_get_raw_read_pointer(struct cbuffer_t *cbuf)
 {
-	if (!cbuf || !cbuf->rp) {
-		CBUF_ERR("Invalid argument, cbuf || cbuf->rp == NULL");
+	if (!cbuf || !cbuf->data) {
+		CBUF_ERR("Invalid argument, cbuf || cbuf->data == NULL");
 		return NULL;
 	}
 
-	return cbuf->rp;
+	return &cbuf->data[atomic_load_explicit(&cbuf->tail, memory_order_relaxed) %
+			   cbuf->nr_elements];
 }
 
 /**
  * @brief  Retrieve the current raw write pointer
  *
+ * In MPSC mode this is the slot claimed by the calling thread.
+ *
  * @param cbuf The cbuffer of which the pointer will be retrieved
  *
  * @returns  NULL if failed, otherwise a valid pointer to the data pointer
  */
 static inline void **cbuffer_get_raw_write_pointer(struct cbuffer_t *cbuf)
 {
-	if (!cbuf || !cbuf->wp) {
-		CBUF_ERR("Invalid argument, cbuf || cbuf->wp == NULL");
+	if (!cbuf || !cbuf->data) {
+		CBUF_ERR("Invalid argument, cbuf || cbuf->data == NULL");
 		return NULL;
 	}
-	return cbuf->wp;
+
+	if (cbuf->mode == CBUFFER_MODE_MPSC) {
+		return cbuffer_claimed_slot_mpsc(cbuf);
+	}
+
+	return &cbuf->data[atomic_load_explicit(&cbuf->head, memory_order_relaxed) %
+			   cbuf->nr_elements];
 }
 
 /**
@@ -0,0 +1,128 @@
+/**
+ * @file logger-bin.h
+ * @brief  Binary log file driver and decoder
+ *
+ * Enabled by defining CFG_LOGGER_BIN_LOGGER. Instead of text, every message
+ * is stored as a small record holding a callsite id, the time stamp, the
+ * level and the packed arguments (or the formatted body when the message
+ * wasn't deferred). File, function, line and format of a callsite are written
+ * once, in a dictionary record in front of its first message.
+ *
+ * A file is a sequence of runs. Every run starts with a logger_bin_file_t,
+ * callsite ids are only valid within their run. All values are stored in
+ * the byte order of the writer, records are not aligned. A CLOCK record is
+ * written at the start of a run and on every driver flush, so wall clock
+ * time stamps can be restored.
+ *
+ * logger_bin_decode() (or the ops-logdecode tool) turns a file back into the
+ * text layout of the other drivers or into JSON lines. Packed arguments can
+ * only be decoded on a machine with the same type sizes as the writer.
+ *
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v0.1
+ * @date 2026-10-16
+ */
+
+#ifndef _LOGGER_BIN_H_
+#define _LOGGER_BIN_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "logger.h"
+
+#if !defined(CFG_LOGGER_BIN_PATH)
+#define CFG_LOGGER_BIN_PATH "logger.bin" //!< Default binary log file
+#endif /* CFG_LOGGER_BIN_PATH */
+
+#if !defined(CFG_LOGGER_BIN_BUF_SIZE)
+#define CFG_LOGGER_BIN_BUF_SIZE 16384 //!< Records are collected up to this size before a write
+#endif /* CFG_LOGGER_BIN_BUF_SIZE */
+
+#define LOGGER_BIN_MAGIC 0x42474f4c //!< "LOGB" when written little endian
+#define LOGGER_BIN_VERSION 1        //!< File format version
+
+/**
+ * @brief  Record types
+ */
+enum logger_bin_type_t {
+	LOGGER_BIN_ARGS = 0,    //!< Message, arguments packed by logger-deferred
+	LOGGER_BIN_BODY,        //!< Message, formatted body
+	LOGGER_BIN_LINE,        //!< Message, complete line without callsite
+	LOGGER_BIN_CALLSITE,    //!< Dictionary: logger_bin_callsite_t, file, function and format
+	LOGGER_BIN_CLOCK,       //!< Epoch time minus time stamp (int64_t, ns)
+	LOGGER_BIN_KV,          //!< Message, fields packed by logger-kv
+};
+
+/**
+ * @brief  Start of a run
+ */
+struct logger_bin_file_t {
+	uint32_t	magic;          //!< LOGGER_BIN_MAGIC
+	uint16_t	version;        //!< LOGGER_BIN_VERSION
+	uint8_t		long_size;      //!< sizeof(long) of the writer
+	uint8_t		ptr_size;       //!< sizeof(void *) of the writer
+	uint64_t	base;           //!< logger_clock_ns() when the run started
+};
+
+/**
+ * @brief  Record header, followed by len bytes of payload
+ */
+struct logger_bin_rec_t {
+	uint8_t		type;           //!< ::logger_bin_type_t
+	uint8_t		lvl;            //!< Level id, index in _log_levels
+	uint16_t	len;            //!< Payload length
+	uint32_t	id;             //!< Callsite id, unused for LOGGER_BIN_LINE
+	uint64_t	ts;             //!< Time stamp, logger_clock_ns()
+};
+
+/**
+ * @brief  Fixed part of a dictionary record, followed by 3 NUL terminated
+ *         strings: file, function and format
+ */
+struct logger_bin_callsite_t {
+	int32_t	lvl;    //!< Log level mask
+	int32_t	ln;     //!< Line number
+};
+
+/**
+ * @brief  Binary driver context, set as priv_data of bin_logger before logger_init
+ */
+struct logger_bin_ctxt_t {
+	const char *	path;           //!< Path of the binary log file
+	bool		sync;           //!< fdatasync() the file on every driver flush
+	int		fd;             //!< File descriptor, -1 if not opened
+	const void **	ids;            //!< Open addressing table of the known callsites
+	uint32_t *	id_of;          //!< Id of every entry in ids
+	size_t		nr_slots;       //!< Size of ids (power of 2)
+	uint32_t	nr_ids;         //!< Number of ids handed out
+	char *		buf;            //!< Records waiting to be written
+	size_t		used;           //!< Bytes in buf
+};
+
+/**
+ * @brief  Output formats of logger_bin_decode()
+ */
+enum logger_bin_output_t {
+	LOGGER_BIN_OUT_TEXT = 0,        //!< Same layout as the text drivers
+	LOGGER_BIN_OUT_JSON,            //!< One JSON object per line
+};
+
+/**
+ * @brief  Decode a binary log file
+ *
+ * @param in Binary log file
+ * @param out Output
+ * @param fmt Output format
+ * @param ts Time stamp format of LOGGER_BIN_OUT_TEXT
+ *
+ * @returns  -1 if the file is damaged or not supported, otherwise the number
+ *           of decoded messages
+ */
+int logger_bin_decode(FILE *in, FILE *out, enum logger_bin_output_t fmt,
+		      enum logger_ts_format_t ts);
+
+extern struct logger_driver_t bin_logger; //!< Binary driver
+
+#endif /* _LOGGER_BIN_H_ */
@@ -0,0 +1,52 @@
+/**
+ * @file logger-deferred.h
+ * @brief  Deferred formatting support for the logger
+ *
+ * With deferred formatting the caller only stores the format pointer and the
+ * raw argument values. The printf work is done later when the ring is flushed.
+ *
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v0.1
+ * @date 2026-10-16
+ */
+
+#ifndef _LOGGER_DEFERRED_H_
+#define _LOGGER_DEFERRED_H_
+
+#include <stddef.h>
+#include <stdarg.h>
+
+/**
+ * @brief  Pack the arguments belonging to a printf style format string
+ *
+ * Strings are copied by value, all other arguments are stored as raw bytes.
+ * The format string itself is not copied and must outlive the packed data.
+ *
+ * @param fmt printf style format string
+ * @param buf Buffer that will receive the packed arguments
+ * @param len Size of buf
+ * @param va Arguments matching fmt. Consumed by this call.
+ *
+ * @returns  Number of bytes used in buf or -1 if the arguments can't be
+ *           deferred (buffer too small or unsupported conversion)
+ */
+int logger_deferred_pack(const char *fmt, void *buf, size_t len, va_list va);
+
+/**
+ * @brief  Render previously packed arguments
+ *
+ * The output is identical to what vsnprintf(str, size, fmt, ...) would have
+ * produced with the original arguments.
+ *
+ * @param str Output buffer
+ * @param size Size of the output buffer
+ * @param fmt Format string used while packing
+ * @param buf Packed arguments
+ * @param len Number of bytes in buf
+ *
+ * @returns  Number of characters written (excluding the terminating NUL)
+ */
+int logger_deferred_render(char *str, size_t size, const char *fmt,
+			   const void *buf, size_t len);
+
+#endif /* _LOGGER_DEFERRED_H_ */
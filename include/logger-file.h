@@ -0,0 +1,36 @@
+/**
+ * @file logger-file.h
+ * @brief  File driver for logger
+ *
+ * Enabled by defining CFG_LOGGER_FILE_LOGGER. The file is opened in append
+ * mode by logger_init(), every batch of messages is written with a single
+ * writev() call.
+ *
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v0.1
+ * @date 2026-10-16
+ */
+
+#ifndef _LOGGER_FILE_H_
+#define _LOGGER_FILE_H_
+
+#include <stdbool.h>
+
+#include "logger.h"
+
+#if !defined(CFG_LOGGER_FILE_PATH)
+#define CFG_LOGGER_FILE_PATH "logger.log" //!< Default log file
+#endif /* CFG_LOGGER_FILE_PATH */
+
+/**
+ * @brief  File driver context, set as priv_data of file_logger before logger_init
+ */
+struct logger_file_ctxt_t {
+	const char *	path;   //!< Path of the log file
+	bool		sync;   //!< fdatasync() the file on every driver flush
+	int		fd;     //!< File descriptor, -1 if not opened
+};
+
+extern struct logger_driver_t file_logger; //!< File driver
+
+#endif /* _LOGGER_FILE_H_ */
@@ -0,0 +1,73 @@
+/**
+ * @file logger-fmt.h
+ * @brief  Built-in formatter used for log headers and messages
+ *
+ * A snprintf replacement for the conversions that show up in log messages:
+ * %d %i %u %o %x %X %c %s %p %% and %f %F (precision up to 9). The output is
+ * byte-identical to the C library. As soon as a conversion isn't handled
+ * (%e, %g, %ls, %n, ...) the rest of the format string is handed to
+ * vsnprintf.
+ *
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v0.1
+ * @date 2026-10-16
+ */
+
+#ifndef _LOGGER_FMT_H_
+#define _LOGGER_FMT_H_
+
+#include <stddef.h>
+#include <stdarg.h>
+
+#include "logger.h"
+
+/**
+ * @brief  Format a string, vsnprintf semantics
+ *
+ * @param str Output buffer
+ * @param size Size of the output buffer
+ * @param fmt Format string
+ * @param va Arguments
+ *
+ * @returns  Length of the complete output, even if it was truncated
+ */
+int logger_fmt_vformat(char *str, size_t size, const char *fmt, va_list va);
+
+/**
+ * @brief  Format a string, snprintf semantics
+ *
+ * @param str Output buffer
+ * @param size Size of the output buffer
+ * @param fmt Format string
+ * @param ... Arguments
+ *
+ * @returns  Length of the complete output, even if it was truncated
+ */
+int logger_fmt_format(char *str, size_t size, const char *fmt, ...);
+
+/**
+ * @brief  Precompute the "[LEVEL] (" prefix of every log level
+ *
+ * Called by logger_init(), has to be called again when _log_levels changes.
+ */
+void logger_fmt_init_levels();
+
+/**
+ * @brief  Format the message header ("[LEVEL] (file)(function @line) : ")
+ *
+ * Same output as snprintf(str, size, "[%s%5s%s] (%20s)(%30s @%3d) : ", ...)
+ * with the color and name of the level.
+ *
+ * @param str Output buffer
+ * @param size Size of the output buffer
+ * @param lvl Log level
+ * @param file File name
+ * @param fn Function name
+ * @param ln Line number
+ *
+ * @returns  Length of the header in str (truncated to size - 1)
+ */
+size_t logger_fmt_header(char *str, size_t size, int lvl, const char *file,
+			 const char *fn, int ln);
+
+#endif /* _LOGGER_FMT_H_ */
@@ -0,0 +1,116 @@
+/**
+ * @file logger-kv.h
+ * @brief  Structured (key-value) log messages
+ *
+ * The fields of a LOG_*_KV call are stored in the ring as typed binary
+ * values, nothing is formatted by the caller. They are rendered when the ring
+ * is flushed, as the text layout ("msg key=value ..."), as logfmt or as one
+ * JSON object per line (see logger_set_kv_format()).
+ *
+ * Keys and string values are copied, the message itself is the format of
+ * the callsite and has to be a string literal.
+ *
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v0.1
+ * @date 2026-10-16
+ */
+
+#ifndef _LOGGER_KV_H_
+#define _LOGGER_KV_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @brief  Type of a field
+ */
+enum logger_kv_type_t {
+	LOGGER_KV_INT = 0,      //!< long long
+	LOGGER_KV_UINT,         //!< unsigned long long
+	LOGGER_KV_DOUBLE,       //!< double
+	LOGGER_KV_BOOL,         //!< bool
+	LOGGER_KV_STR,          //!< NUL terminated string, copied
+};
+
+/**
+ * @brief  Output layout of structured messages
+ */
+enum logger_kv_format_t {
+	LOGGER_KV_TEXT = 0,     //!< Text layout, the fields follow the message
+	LOGGER_KV_LOGFMT,       //!< time=... level=... msg="..." key=value
+	LOGGER_KV_JSON,         //!< {"time":...,"level":...,"msg":...,"key":value}
+};
+
+/**
+ * @brief  A single field, built with the KV_* macros
+ */
+struct logger_kv_t {
+	const char *	key;    //!< Name of the field
+	int		type;   //!< ::logger_kv_type_t
+	union {
+		long long		i;      //!< LOGGER_KV_INT
+		unsigned long long	u;      //!< LOGGER_KV_UINT
+		double			d;      //!< LOGGER_KV_DOUBLE
+		bool			b;      //!< LOGGER_KV_BOOL
+		const char *		s;      //!< LOGGER_KV_STR
+	} v;                    //!< Value
+};
+
+#define KV_INT(k, x) \
+	((struct logger_kv_t){ .key = (k), .type = LOGGER_KV_INT, .v.i = (x) })
+#define KV_UINT(k, x) \
+	((struct logger_kv_t){ .key = (k), .type = LOGGER_KV_UINT, .v.u = (x) })
+#define KV_DOUBLE(k, x) \
+	((struct logger_kv_t){ .key = (k), .type = LOGGER_KV_DOUBLE, .v.d = (x) })
+#define KV_BOOL(k, x) \
+	((struct logger_kv_t){ .key = (k), .type = LOGGER_KV_BOOL, .v.b = (x) })
+#define KV_STR(k, x) \
+	((struct logger_kv_t){ .key = (k), .type = LOGGER_KV_STR, .v.s = (x) })
+
+/**
+ * @brief  Everything but the fields of a structured line
+ */
+struct logger_kv_line_t {
+	const char *	time;   //!< Time stamp in the text layout, NULL if none
+	int		lvl;    //!< Log level
+	const char *	file;   //!< File name
+	const char *	fn;     //!< Function name
+	int		ln;     //!< Line number
+	const char *	msg;    //!< Message
+};
+
+/**
+ * @brief  Pack fields in their binary form
+ *
+ * Long keys and strings are cut, fields that don't fit at all are left out.
+ *
+ * @param buf Buffer that will receive the packed fields
+ * @param len Size of buf
+ * @param kv Fields
+ * @param cnt Number of fields
+ *
+ * @returns  Number of bytes used in buf
+ */
+size_t logger_kv_pack(void *buf, size_t len, const struct logger_kv_t *kv, int cnt);
+
+/**
+ * @brief  Render a structured line
+ *
+ * In the logfmt and JSON layouts a field named like a built-in member (time,
+ * level, file, function, line, msg, kv_error) gets the prefix "fields.".
+ * logfmt keys are quoted like the values when needed.
+ *
+ * @param str Output buffer
+ * @param size Size of the output buffer
+ * @param fmt Output layout
+ * @param line Time stamp, level, callsite and message of the line
+ * @param buf Packed fields
+ * @param len Number of bytes in buf
+ *
+ * @returns  Length of the line (NUL excluded, no line ending)
+ */
+size_t logger_kv_render(char *str, size_t size, enum logger_kv_format_t fmt,
+			const struct logger_kv_line_t *line, const void *buf,
+			size_t len);
+
+#endif /* _LOGGER_KV_H_ */
@@ -0,0 +1,73 @@
+/**
+ * @file logger-mmap.h
+ * @brief  Crash persistent memory mapped driver for logger
+ *
+ * Enabled by defining CFG_LOGGER_MMAP_LOGGER. Messages are copied into a
+ * ring inside a MAP_SHARED file mapping, so writing a message doesn't need a
+ * single system call. The mapping lives in the page cache: whatever was
+ * written survives a crash or a kill -9 of the process (not a power loss,
+ * unless sync is set).
+ *
+ * When logger_init() finds the ring of a previous run, its tail is kept and
+ * can be read back with the read op of mmap_logger.
+ *
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v0.1
+ * @date 2026-10-16
+ */
+
+#ifndef _LOGGER_MMAP_H_
+#define _LOGGER_MMAP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "logger.h"
+
+#if !defined(CFG_LOGGER_MMAP_PATH)
+#define CFG_LOGGER_MMAP_PATH "logger.mmap" //!< Default ring file
+#endif /* CFG_LOGGER_MMAP_PATH */
+
+#if !defined(CFG_LOGGER_MMAP_SIZE)
+#define CFG_LOGGER_MMAP_SIZE 65536 //!< Default size of the ring in bytes
+#endif /* CFG_LOGGER_MMAP_SIZE */
+
+#define LOGGER_MMAP_MAGIC 0x4c4f4752 //!< "LOGR"
+#define LOGGER_MMAP_VERSION 1        //!< Layout version of the ring file
+
+/**
+ * @brief  Header at the start of the ring file, followed by the data area
+ *
+ * Offsets are free running, the data of offset x is stored at x % size. A
+ * write first moves reserved, copies the data and then moves offset. After a
+ * crash, the bytes between offset and reserved may have been overwritten
+ * partially, only [reserved - size, offset) is recovered.
+ */
+struct logger_mmap_hdr_t {
+	uint32_t	magic;          //!< LOGGER_MMAP_MAGIC
+	uint32_t	version;        //!< LOGGER_MMAP_VERSION
+	uint64_t	size;           //!< Size of the data area
+	uint64_t	offset;         //!< Write offset, end of the written data
+	uint64_t	reserved;       //!< End of the write in progress
+	uint64_t	seq;            //!< Number of messages written
+	uint64_t	runs;           //!< Number of times the ring was opened
+};
+
+/**
+ * @brief  Memory mapped driver context, set as priv_data of mmap_logger before logger_init
+ */
+struct logger_mmap_ctxt_t {
+	const char *			path;           //!< Path of the ring file
+	size_t				size;           //!< Size of the data area
+	bool				sync;           //!< msync() the ring on every driver flush
+	int				fd;             //!< File descriptor, -1 if not opened
+	struct logger_mmap_hdr_t *	hdr;            //!< Mapped header
+	char *				data;           //!< Mapped data area
+	char *				prev;           //!< Tail of the previous run, NULL if none
+	size_t				prev_len;       //!< Length of prev
+	size_t				prev_pos;       //!< Read position in prev
+};
+
+extern struct logger_driver_t mmap_logger; //!< Memory mapped driver
+
+#endif /* _LOGGER_MMAP_H_ */
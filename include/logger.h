@@ -13,10 +13,62 @@
 #include <stddef.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 
 #include "colors.h"
+#include "logger-kv.h"
 
-#define CFG_RING_NR_ELEMS 100
+#if !defined(CFG_RING_SIZE)
+#define CFG_RING_SIZE 8192 //!< Size of the log ring in bytes
+#endif /* CFG_RING_SIZE */
+
+#if !defined(CFG_RING_THREAD_SIZE)
+#define CFG_RING_THREAD_SIZE 4096 //!< Size of a per-thread ring in async mode
+#endif /* CFG_RING_THREAD_SIZE */
+
+#if !defined(CFG_RING_SPILL_SIZE)
+#define CFG_RING_SPILL_SIZE 8192 //!< Default size of the spill ring
+#endif /* CFG_RING_SPILL_SIZE */
+
+#if !defined(CFG_LOGGER_BATCH_NR)
+#define CFG_LOGGER_BATCH_NR 32 //!< Max number of messages handed to a driver at once
+#endif /* CFG_LOGGER_BATCH_NR */
+
+#if !defined(CFG_LOGGER_RENDER_SIZE)
+#define CFG_LOGGER_RENDER_SIZE 4096 //!< Scratch space for messages formatted during flush
+#endif /* CFG_LOGGER_RENDER_SIZE */
+
+#if !defined(CFG_LOGGER_FLUSH_BYTES)
+#define CFG_LOGGER_FLUSH_BYTES 0 //!< Default driver flush threshold in bytes
+#endif /* CFG_LOGGER_FLUSH_BYTES */
+
+#if !defined(CFG_LOGGER_FLUSH_MSGS)
+#define CFG_LOGGER_FLUSH_MSGS 0 //!< Default driver flush threshold in messages
+#endif /* CFG_LOGGER_FLUSH_MSGS */
+
+#if !defined(CFG_LOGGER_FLUSH_INTERVAL_MS)
+#define CFG_LOGGER_FLUSH_INTERVAL_MS 0 //!< Default driver flush interval
+#endif /* CFG_LOGGER_FLUSH_INTERVAL_MS */
+
+#if !defined(CFG_LOGGER_FLUSH_ON_ERROR)
+#define CFG_LOGGER_FLUSH_ON_ERROR 1 //!< Flush the drivers right after an ERROR message
+#endif /* CFG_LOGGER_FLUSH_ON_ERROR */
+
+#if !defined(CFG_LOGGER_ASYNC_INTERVAL_MS)
+#define CFG_LOGGER_ASYNC_INTERVAL_MS 10 //!< Max idle time of the drainer thread
+#endif /* CFG_LOGGER_ASYNC_INTERVAL_MS */
+
+#if !defined(CFG_LOGGER_STATS_SAMPLE)
+#define CFG_LOGGER_STATS_SAMPLE 64 //!< Time the formatting of one LOG_* call in this many, 0 to disable
+#endif /* CFG_LOGGER_STATS_SAMPLE */
+
+#if !defined(CFG_LOGGER_TS_FORMAT)
+#define CFG_LOGGER_TS_FORMAT LOGGER_TS_NONE //!< Default time stamp format
+#endif /* CFG_LOGGER_TS_FORMAT */
+
+#if !defined(CFG_LOGGER_KV_FORMAT)
+#define CFG_LOGGER_KV_FORMAT LOGGER_KV_TEXT //!< Default layout of structured messages
+#endif /* CFG_LOGGER_KV_FORMAT */
 
 #define LOG_LVL_DEBUG           0x00000001      //!< Debugging
 #define LOG_LVL_INFO            0x00000002      //!< Info
@@ -39,11 +91,29 @@
 /** No logging at all */
 #define LOG_LVL_NONE 0
 
+/**
+ * Lowest log level that is compiled in. Log calls of a lower level compile to
+ * nothing and their arguments are never evaluated. LOG_LVL_RAW counts as the
+ * highest level. CFG_LOGGER_HARD_DISABLE_DEBUG is kept for compatibility and
+ * strips DEBUG, INFO and RAW.
+ */
+#if !defined(CFG_LOGGER_MIN_LEVEL)
+#if defined(CFG_LOGGER_HARD_DISABLE_DEBUG)
+#define CFG_LOGGER_MIN_LEVEL LOG_LVL_OK
+#else
+#define CFG_LOGGER_MIN_LEVEL LOG_LVL_DEBUG
+#endif /* CFG_LOGGER_HARD_DISABLE_DEBUG */
+#endif /* CFG_LOGGER_MIN_LEVEL */
+
 /** Max logger name */
 #define LOGGER_DRV_NAME 16
 
-/** Max string length */
-#define MAX_STR_LEN 256
+#if !defined(MAX_STR_LEN)
+#define MAX_STR_LEN 256 //!< Max string length, upper bound of logger_config_t.max_msg_len
+#endif /* MAX_STR_LEN */
+
+/** Lower bound of logger_config_t.max_msg_len */
+#define LOGGER_MIN_MSG_LEN 16
 
 struct line_info_t {
 	const int	lvl;    //!< Log level
@@ -52,14 +122,51 @@ struct line_info_t {
 	const int	ln;     //!< Line number
 };
 
+/**
+ * @brief  Runtime control of a callsite
+ */
+enum logger_callsite_ctrl_t {
+	LOGGER_CS_DEFAULT = 0,  //!< Follow the log level
+	LOGGER_CS_ON,           //!< Always enabled, regardless of the log level
+	LOGGER_CS_OFF,          //!< Always disabled
+};
+
+/**
+ * @brief  Mutable state of a callsite, kept next to its static descriptor
+ */
+struct logger_callsite_state_t {
+	atomic_int	active; //!< Checked by the LOG_* macros, derived from ctrl
+	atomic_int	ctrl;   //!< ::logger_callsite_ctrl_t
+	atomic_uint	hits;   //!< Messages written to the ring
+	atomic_uint	drops;  //!< Messages dropped because the ring was full
+};
+
+/**
+ * @brief  Static description of a single log statement
+ *
+ * Every LOG_* macro emits one of these as a static const object, so the
+ * metadata of a message is never rebuilt at runtime. Unless
+ * CFG_LOGGER_NO_CALLSITE_SECTION is set, all descriptors are collected in the
+ * "logger_callsites" linker section and can be enumerated, see
+ * logger_callsite_get().
+ */
+struct logger_callsite_t {
+	int		lvl;    //!< Log level
+	int		ln;     //!< Line number
+	const char *	file;   //!< File name (without directories when supported)
+	const char *	fn;     //!< Function name
+	const char *	fmt;    //!< Format string
+	struct logger_callsite_state_t *state; //!< Runtime state, NULL for logger_log()
+};
+
 /** Init driver callback */
 typedef int (*init_fn)(void *drv);
 
 /** Write callback function */
 typedef int (*write_fn)(void *drv, char *str);
 
-/** Read callback function */
-typedef int (*read_fn)(void *drv, char *buffer);
+/** Read callback function, returns the number of bytes read (0 at the end) */
+typedef int (*read_fn)(void *drv, char *buffer, size_t size);
 
 /** Flush callback function */
 typedef int (*flush_fn)(void *drv);
@@ -67,6 +174,36 @@ typedef int (*flush_fn)(void *drv);
 /** Close callback function */
 typedef void (*close_fn)(void *drv);
 
+/** Contiguous span of output, a single formatted message */
+struct logger_iovec_t {
+	const char *	base;   //!< Start of the span, NUL terminated
+	size_t		len;    //!< Length of the span (NUL excluded)
+};
+
+/** Vectored write callback function, writes cnt spans in one go */
+typedef int (*writev_fn)(void *drv, const struct logger_iovec_t *iov, int cnt);
+
+/** Payload of a ::logger_entry_t */
+enum logger_entry_type_t {
+	LOGGER_ENTRY_ARGS = 0,  //!< Arguments packed by logger_deferred_pack()
+	LOGGER_ENTRY_BODY,      //!< Formatted message body
+	LOGGER_ENTRY_LINE,      //!< Complete line (header included), no callsite
+	LOGGER_ENTRY_KV,        //!< Fields packed by logger_kv_pack(), cs->fmt is the message
+};
+
+/** A message as stored by the logger, before it is rendered as text */
+struct logger_entry_t {
+	const struct logger_callsite_t *	cs;     //!< Callsite, NULL for LOGGER_ENTRY_LINE
+	uint64_t				ts;     //!< Time stamp, logger_clock_ns()
+	int					lvl;    //!< Log level
+	int					type;   //!< ::logger_entry_type_t
+	const void *				data;   //!< Payload
+	size_t					len;    //!< Payload length (CRLF and NUL excluded)
+};
+
+/** Entry write callback function, used instead of write/writev when set */
+typedef int (*write_entries_fn)(void *drv, const struct logger_entry_t *ent, int cnt);
+
 /** Logger operation struct */
 struct logger_ops_t {
 	init_fn		init;   //!< Init driver
@@ -74,14 +211,146 @@ struct logger_ops_t {
 	read_fn		read;   //!< Read function for driver
 	flush_fn	flush;  //!< Flush function for driver
 	close_fn	close;  //!< Close function for driver
+	writev_fn	writev; //!< Optional batch write, write is used if NULL
+	write_entries_fn write_entries; //!< Optional, receives messages unrendered
+};
+
+/** Number of buckets of a ::logger_hist_t */
+#define LOGGER_HIST_BUCKETS 20
+
+/**
+ * @brief  Latency histogram
+ *
+ * Bucket 0 counts calls below 1 us, bucket i calls from 2^(i-1) up to 2^i us.
+ * The last bucket also counts everything above.
+ */
+struct logger_hist_t {
+	unsigned long long	count[LOGGER_HIST_BUCKETS];     //!< Calls per bucket
+	unsigned long long	total_ns;                       //!< Time spent in all calls
+	unsigned long long	max_ns;                         //!< Slowest call
+};
+
+/**
+ * @brief  Driver statistics, kept by the logger
+ */
+struct logger_driver_stats_t {
+	struct logger_hist_t	write;  //!< Write calls, one per batch
+	struct logger_hist_t	flush;  //!< Flush calls
 };
 
 /** Logger driver structure */
 struct logger_driver_t {
-	bool				enabled;                //!< Enable the logger
+	bool				enabled;                //!< Enable the logger, see logger_set_driver_enabled
 	char				name[LOGGER_DRV_NAME];  //!< Driver name
 	const struct logger_ops_t *	ops;                    //!< Logger operations
 	void *				priv_data;              //!< private driver data
+	struct logger_driver_stats_t	stats;                  //!< Use logger_get_driver_stats()
+	int				loglvl;                 //!< Levels written to this driver, 0 for all
+};
+
+/**
+ * @brief  When the drivers are flushed
+ *
+ * Drivers are flushed after a written batch once one of the thresholds is
+ * reached. When all thresholds are 0, the drivers are flushed at the end of
+ * every logger_flush(). logger_close() always flushes.
+ */
+struct logger_flush_policy_t {
+	size_t	bytes;          //!< Flush after this many bytes, 0 to ignore
+	int	msgs;           //!< Flush after this many messages, 0 to ignore
+	int	interval_ms;    //!< Flush when the last flush is this old, 0 to ignore
+	bool	on_error;       //!< Flush right after a batch holding an ERROR message
+};
+
+/**
+ * @brief  What happens to a message when the ring is full
+ */
+enum logger_overflow_t {
+	LOGGER_OVERFLOW_DROP_NEWEST = 0,        //!< Drop the new message
+	LOGGER_OVERFLOW_OVERWRITE_OLDEST,       //!< Drop the oldest messages to make room
+	LOGGER_OVERFLOW_BLOCK,                  //!< Wait for room, drop after a timeout
+	LOGGER_OVERFLOW_SPILL,                  //!< Store the message in a secondary ring
+};
+
+/**
+ * @brief  Ring overflow policy
+ *
+ * Whenever a message can't be stored it is counted as dropped. Policies fall
+ * back to dropping the new message when they can't make room either.
+ */
+struct logger_overflow_policy_t {
+	enum logger_overflow_t	mode;           //!< Overflow mode
+	int			timeout_ms;     //!< Max wait time in LOGGER_OVERFLOW_BLOCK mode
+	size_t			spill_size;     //!< Size of the spill ring, 0 for CFG_RING_SPILL_SIZE
+};
+
+/**
+ * @brief  Logger configuration, see logger_init_ex()
+ *
+ * A zeroed configuration gives the build time defaults.
+ */
+struct logger_config_t {
+	size_t				ring_size;              //!< Shared ring in bytes (or length of ring_mem), 0 for CFG_RING_SIZE
+	void *				ring_mem;               //!< Caller memory for the shared ring, NULL to allocate it
+	unsigned			ring_flags;             //!< ::logger_ring_flags_t
+	size_t				thread_ring_size;       //!< Per-thread ring in async mode, 0 for CFG_RING_THREAD_SIZE
+	size_t				max_msg_len;            //!< Longest message body (NUL included), 0 for MAX_STR_LEN
+	struct logger_overflow_policy_t	overflow;               //!< What happens when the ring is full
+};
+
+/**
+ * @brief  Dropped message counters
+ */
+struct logger_drops_t {
+	unsigned long long	msgs;   //!< Number of dropped messages
+	unsigned long long	bytes;  //!< Estimated output bytes of the dropped messages
+};
+
+/** Number of log levels, entries in _log_levels */
+#define LOGGER_NR_LEVELS 6
+
+/**
+ * @brief  Messages of one log level
+ */
+struct logger_level_stats_t {
+	unsigned long long	msgs;   //!< Messages stored in the ring
+	unsigned long long	bytes;  //!< Bytes written to the drivers
+};
+
+/**
+ * @brief  Ring occupancy, in bytes (record headers and padding included)
+ */
+struct logger_ring_stats_t {
+	size_t	size;   //!< Size of the ring
+	size_t	used;   //!< Bytes in use right now
+	size_t	peak;   //!< Highest number of bytes in use (high-watermark)
+};
+
+/**
+ * @brief  Logger statistics, see logger_get_stats()
+ */
+struct logger_stats_t {
+	struct logger_level_stats_t	levels[LOGGER_NR_LEVELS];       //!< Indexed like _log_levels
+	struct logger_ring_stats_t	ring;           //!< Shared ring
+	struct logger_ring_stats_t	spill;          //!< Spill ring, all 0 without one
+	struct logger_ring_stats_t	threads;        //!< Thread rings: sizes and usage summed, highest peak
+	int				nr_threads;     //!< Number of thread rings
+	struct logger_drops_t		drops;          //!< Dropped messages
+	unsigned long long		render_ns;      //!< Time spent preparing batches for the drivers
+	unsigned long long		format_ns;      //!< Estimated time spent formatting in the LOG_* calls
+};
+
+/**
+ * @brief  How the time stamp of a message is rendered
+ *
+ * Every message is stamped when it is logged, the stamp is only converted
+ * when the message is written to the drivers. RAW messages never get one.
+ */
+enum logger_ts_format_t {
+	LOGGER_TS_NONE = 0,     //!< No time stamp
+	LOGGER_TS_UPTIME,       //!< "[    12.345678] ", seconds since logger_init()
+	LOGGER_TS_EPOCH,        //!< "1760609472.345678 ", seconds since the epoch
+	LOGGER_TS_UTC,          //!< "2026-10-16T10:11:12.345678Z "
 };
 
 /** brief  Log level definition */
@@ -89,10 +358,12 @@ struct log_level_t {
 	int		mask;           //!< Mask associated with the log level
 	const char *	name;           //!< Log level name. (What will be printed before msg)
 	const char *	color;          //!< Color for the name
-	int		counter;        //!< Internal counter for number of messages
+	atomic_uint	counter;        //!< Internal counter for number of messages
 };
 
 extern struct log_level_t _log_levels[]; //!< Log levels
+extern int _current_loglvl; //!< Runtime log level mask, use logger_set_loglvl
+extern int _drivers_loglvl; //!< Levels wanted by any driver, use logger_set_driver_loglvl
 
 /**
  * @brief  Convert logger mask to id in _log_levels array
@@ -103,6 +374,33 @@ extern struct log_level_t _log_levels[]; //!< Log levels
  */
 int logger_mask2id(int mask);
 
+/**
+ * @brief  Flags of logger_set_ring_memory()
+ */
+enum logger_ring_flags_t {
+	LOGGER_RING_HUGE_PAGES = 1 << 0,        //!< Back the ring with huge pages if possible
+};
+
+/**
+ * @brief  Set the memory of the shared ring, call before logger_init()
+ *
+ * With mem set, the ring (structure and data) is placed in that memory, e.g.
+ * a static array, and nothing is allocated for it. rbuffer_mem_size() gives
+ * the length needed for a ring size. Otherwise logger_init() allocates one
+ * cache line aligned block for a ring of size bytes, logger_close() frees it.
+ *
+ * LOGGER_RING_HUGE_PAGES maps the block from the huge page pool and falls back
+ * to transparent huge pages. It is ignored when CFG_LOGGER_DEEP_EMBEDDED is
+ * defined.
+ *
+ * @param mem Memory for the ring, valid until logger_close(), or NULL
+ * @param size Length of mem, or the ring size in bytes (0 for CFG_RING_SIZE)
+ * @param flags ::logger_ring_flags_t, only used when mem is NULL
+ *
+ * @returns -1 if failed (the logger is initialized) otherwise 0
+ */
+int logger_set_ring_memory(void *mem, size_t size, unsigned flags);
+
 /**
  * @brief  Initial the logger
  *
@@ -110,6 +408,20 @@ int logger_mask2id(int mask);
  */
 int logger_init();
 
+/**
+ * @brief  Initialize the logger with a runtime configuration
+ *
+ * The ring sizes, memory source and maximum message length replace the build
+ * time settings. They stay in effect for later logger_init() calls, like the
+ * values set with logger_set_ring_memory() and logger_set_overflow_policy().
+ * Longer message bodies are truncated, max_msg_len can't exceed MAX_STR_LEN.
+ *
+ * @param cfg Configuration, NULL is the same as logger_init()
+ *
+ * @returns -1 if failed (invalid configuration) otherwise 0
+ */
+int logger_init_ex(const struct logger_config_t *cfg);
+
 /**
  * @brief  Set a new log level
  *
@@ -125,8 +437,172 @@ void logger_set_loglvl(int loglvl);
  */
 int logger_get_loglvl();
 
+/**
+ * @brief  Write all pending messages to the drivers
+ */
 void logger_flush();
 
+/**
+ * @brief  Set when the drivers are flushed
+ *
+ * The interval is not available when CFG_LOGGER_DEEP_EMBEDDED is defined.
+ *
+ * @param policy The new flush policy
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+int logger_set_flush_policy(const struct logger_flush_policy_t *policy);
+
+/**
+ * @brief  Get the current flush policy
+ *
+ * @param policy Will hold the flush policy
+ */
+void logger_get_flush_policy(struct logger_flush_policy_t *policy);
+
+/**
+ * @brief  Set what happens to messages when the ring is full
+ *
+ * LOGGER_OVERFLOW_SPILL allocates the spill ring the first time it is
+ * selected, it is kept until logger_close(). Like the mode, the spill ring
+ * size stays in effect, logger_init() allocates the ring again.
+ *
+ * @param policy The new overflow policy
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+int logger_set_overflow_policy(const struct logger_overflow_policy_t *policy);
+
+/**
+ * @brief  Get the number of messages dropped since logger_init()
+ *
+ * A message that didn't fit in the ring is never formatted, its bytes are
+ * counted with the format string in place of the body.
+ *
+ * @param drops Will hold the drop counters
+ */
+void logger_get_drops(struct logger_drops_t *drops);
+
+/**
+ * @brief  Get the logger statistics
+ *
+ * Counters run from logger_init(). The time spent formatting in the LOG_*
+ * calls is measured on one call in CFG_LOGGER_STATS_SAMPLE per thread and
+ * scaled up, it is 0 when CFG_LOGGER_DEEP_EMBEDDED is defined.
+ *
+ * @param stats Will hold the statistics
+ */
+void logger_get_stats(struct logger_stats_t *stats);
+
+/**
+ * @brief  Get the write and flush latencies of a driver
+ *
+ * @param drv Driver
+ * @param stats Will hold the statistics of the driver
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+int logger_get_driver_stats(const struct logger_driver_t *drv,
+			    struct logger_driver_stats_t *stats);
+
+/**
+ * @brief  Set the levels written to a driver
+ *
+ * The driver only gets the messages of these levels, on top of the global
+ * log level. Messages no driver wants are neither formatted nor stored.
+ *
+ * @param drv Driver
+ * @param loglvl Level mask, LOG_LVL_NONE writes every level
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+int logger_set_driver_loglvl(struct logger_driver_t *drv, int loglvl);
+
+/**
+ * @brief  Enable or disable a driver at runtime
+ *
+ * Levels that only disabled drivers want are neither formatted nor stored.
+ * Changing enabled directly works as well, but those levels are then only
+ * left out again after the next logger_init(). A driver that was disabled
+ * during logger_init() isn't initialized when it is enabled.
+ *
+ * @param drv Driver
+ * @param enabled Write messages to the driver
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+int logger_set_driver_enabled(struct logger_driver_t *drv, bool enabled);
+
+/**
+ * @brief  Get the levels written to a driver
+ *
+ * @param drv Driver
+ *
+ * @returns  Level mask of the driver, LOG_LVL_EXTRA if it gets every level
+ */
+int logger_get_driver_loglvl(const struct logger_driver_t *drv);
+
+/**
+ * @brief  Set how time stamps are rendered
+ *
+ * @param fmt The new time stamp format
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+int logger_set_ts_format(enum logger_ts_format_t fmt);
+
+/**
+ * @brief  Get the current time stamp format
+ *
+ * @returns  The time stamp format
+ */
+enum logger_ts_format_t logger_get_ts_format();
+
+/**
+ * @brief  Set how structured (LOG_*_KV) messages are rendered by text drivers
+ *
+ * @param fmt The new layout
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+int logger_set_kv_format(enum logger_kv_format_t fmt);
+
+/**
+ * @brief  Get the layout of structured messages
+ *
+ * @returns  The layout
+ */
+enum logger_kv_format_t logger_get_kv_format();
+
+/**
+ * @brief  Clock used to stamp messages, in nanoseconds
+ *
+ * Reads CFG_LOGGER_TS_CLOCK (CLOCK_MONOTONIC_COARSE by default). Defined
+ * weak, so a target can provide its own cheap clock, e.g. a cycle counter.
+ * Returns 0 when CFG_LOGGER_DEEP_EMBEDDED is defined.
+ *
+ * @returns  Monotonic time in nanoseconds
+ */
+uint64_t logger_clock_ns();
+
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+/**
+ * @brief  Start the asynchronous mode
+ *
+ * Every producer thread gets its own ring and a dedicated drainer thread
+ * writes those rings to the drivers. Messages of different threads are not
+ * ordered with respect to each other.
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+int logger_start_async();
+
+/**
+ * @brief  Stop the asynchronous mode, pending messages are written out
+ */
+void logger_stop_async();
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
 /**
  * @brief  Close the logger
  */
@@ -144,30 +620,290 @@ void logger_close();
  */
 void logger_log(const int lvl, const char *file, const char *fn, const int ln, char *fmt, ...);
 
-#define LOG_OK(msg, ...)                                                       \
-  logger_log(LOG_LVL_OK, __FILE__, __FUNCTION__, __LINE__, msg, ##__VA_ARGS__)
+/**
+ * @brief  Write to the logger(s) from a static callsite, used by the LOG_* macros
+ *
+ * @param cs Callsite descriptor of the log statement
+ * @param ... va_args for cs->fmt
+ */
+void logger_log_cs(const struct logger_callsite_t *cs, ...);
+
+/**
+ * @brief  Write a structured message from a static callsite, used by the
+ *         LOG_*_KV macros
+ *
+ * @param cs Callsite descriptor, cs->fmt is the message
+ * @param kv Fields, packed in binary form
+ * @param cnt Number of fields
+ */
+void logger_log_kv(const struct logger_callsite_t *cs,
+		   const struct logger_kv_t *kv, int cnt);
+
+/**
+ * @brief  Reserve room for a message body in the ring, used by logger_reserve()
+ *
+ * The header is added when the message is written to the drivers.
+ *
+ * @param cs Callsite descriptor of the reservation
+ * @param len Maximum body length, less than the maximum message length
+ *
+ * @returns  NULL if the level is disabled or the message was dropped,
+ *           otherwise len writable bytes
+ */
+char *logger_reserve_cs(const struct logger_callsite_t *cs, size_t len);
+
+/**
+ * @brief  Reserve room for a message body in the ring
+ *
+ * Same as logger_reserve() for a given location, the header is formatted
+ * right away.
+ *
+ * @param lvl Log level
+ * @param file Current file name
+ * @param fn Current function name
+ * @param ln Current line number
+ * @param len Maximum body length, less than the maximum message length
+ *
+ * @returns  NULL if the level is disabled or the message was dropped,
+ *           otherwise len writable bytes
+ */
+char *logger_reserve_at(const int lvl, const char *file, const char *fn,
+			const int ln, size_t len);
+
+/**
+ * @brief  Publish the message handed out by logger_reserve()
+ *
+ * @param len Length of the body that was written, at most the reserved length
+ *
+ * @returns  -1 if the calling thread holds no reservation otherwise 0
+ */
+int logger_commit(size_t len);
 
-#define LOG_WARN(msg, ...)                                                     \
-  logger_log(LOG_LVL_WARN, __FILE__, __FUNCTION__, __LINE__, msg, ##__VA_ARGS__)
+/**
+ * @brief  Retrieve the number of callsites in the binary
+ *
+ * @returns  Number of callsites, 0 if CFG_LOGGER_NO_CALLSITE_SECTION is set
+ */
+size_t logger_callsite_count();
 
-#define LOG_ERROR(msg, ...)                                                    \
-  logger_log(LOG_LVL_ERROR, __FILE__, __FUNCTION__, __LINE__, msg,             \
-             ##__VA_ARGS__)
+/**
+ * @brief  Retrieve a callsite by its id
+ *
+ * @param id Callsite id, 0 up to logger_callsite_count()
+ *
+ * @returns  NULL if the id is invalid, otherwise the callsite
+ */
+const struct logger_callsite_t *logger_callsite_get(size_t id);
 
-#if !defined (CFG_LOGGER_HARD_DISABLE_DEBUG)
-#define LOG_DEBUG(msg, ...) \
-	logger_log(LOG_LVL_DEBUG, __FILE__, __FUNCTION__, __LINE__, msg, \
-		   ## __VA_ARGS__)
+/**
+ * @brief  Retrieve the unique id of a callsite
+ *
+ * The id is the index of the callsite in the callsite section, it is stable
+ * for a given binary.
+ *
+ * @param cs Callsite of which we retrieve the id
+ *
+ * @returns  -1 if the callsite isn't part of the section, otherwise the id
+ */
+int logger_callsite_id(const struct logger_callsite_t *cs);
 
-#define LOG_RAW(msg, ...)                                                      \
-  logger_log(LOG_LVL_RAW, __FILE__, __FUNCTION__, __LINE__, msg, ##__VA_ARGS__)
+/**
+ * @brief  Enable or disable a single callsite at runtime
+ *
+ * @param cs Callsite that will be changed
+ * @param ctrl New control value
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+int logger_callsite_set(const struct logger_callsite_t *cs,
+			enum logger_callsite_ctrl_t ctrl);
 
-#define LOG_INFO(msg, ...)                                                     \
-  logger_log(LOG_LVL_INFO, __FILE__, __FUNCTION__, __LINE__, msg, ##__VA_ARGS__)
+/**
+ * @brief  Enable or disable all callsites of a file at runtime
+ *
+ * Requires the callsite section, directories in file are ignored.
+ *
+ * @param file File name of the callsites
+ * @param ln Line of the callsite, 0 for every callsite in the file
+ * @param ctrl New control value
+ *
+ * @returns  Number of changed callsites
+ */
+int logger_callsite_set_file(const char *file, int ln,
+			     enum logger_callsite_ctrl_t ctrl);
+
+#if defined(__FILE_NAME__)
+#define LOGGER_FILE_NAME __FILE_NAME__
 #else
-#define LOG_INFO(msg,...)while(0){};
-#define LOG_DEBUG(msg,...)while(0){};
-#define LOG_RAW(msg, ...)while(0){};
-#endif /* CFG_LOGGER_HARD_DISABLE_DEBUG */
+#define LOGGER_FILE_NAME __FILE__ //!< Directories are stripped when printing
+#endif /* __FILE_NAME__ */
+
+#if defined(__GNUC__) && !defined(CFG_LOGGER_NO_CALLSITE_SECTION)
+/** Keep every callsite, back to back, in the callsite section */
+#define LOGGER_CALLSITE_ATTR \
+	__attribute__((section("logger_callsites"), used, \
+		       aligned(__alignof__(struct logger_callsite_t))))
+
+/**
+ * The active flag of every callsite is updated by logger_set_loglvl() and
+ * logger_set_driver_loglvl(), so the level check is a single load.
+ */
+#define LOGGER_CALLSITE_ACTIVE(lvl, state) \
+	atomic_load_explicit(&(state).active, memory_order_relaxed)
+#else
+#define LOGGER_CALLSITE_ATTR
+
+/** Callsites can't be enumerated, the active flag only follows ctrl */
+#define LOGGER_CALLSITE_ACTIVE(lvl, state) \
+	(((lvl) & _current_loglvl & _drivers_loglvl) && \
+	 atomic_load_explicit(&(state).active, memory_order_relaxed))
+#endif /* __GNUC__ && !CFG_LOGGER_NO_CALLSITE_SECTION */
+
+#if defined(__GNUC__)
+#define LOGGER_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define LOGGER_UNLIKELY(x) (x)
+#endif /* __GNUC__ */
+
+/**
+ * Emit a log call. The runtime level check is done inline, before any of
+ * the arguments are evaluated. msg has to be a string literal, use
+ * logger_log() directly for formats built at runtime.
+ */
+#define _LOGGER_LOG(lvl, msg, ...) \
+	do { \
+		static struct logger_callsite_state_t _logger_cs_state = { \
+			.active = 1, \
+		}; \
+		static const struct logger_callsite_t _logger_cs \
+			LOGGER_CALLSITE_ATTR = { \
+			lvl, __LINE__, LOGGER_FILE_NAME, __FUNCTION__, msg, \
+			&_logger_cs_state \
+		}; \
+		if (LOGGER_UNLIKELY(LOGGER_CALLSITE_ACTIVE(lvl, _logger_cs_state))) { \
+			logger_log_cs(&_logger_cs, ## __VA_ARGS__); \
+		} \
+	} while (0)
+
+/**
+ * Reserve room for a text message of up to len bytes directly in the ring,
+ * the caller writes the body in place and publishes it with logger_commit().
+ * The level check and the overflow policy are the same as for a LOG_* call.
+ *
+ * A thread holds at most one reservation and may not log anything else
+ * until it commits. Consumers can't pass an uncommitted message, commit
+ * soon.
+ */
+#if defined(__GNUC__)
+#define logger_reserve(lvl, len) \
+	({ \
+		static struct logger_callsite_state_t _logger_cs_state = { \
+			.active = 1, \
+		}; \
+		static const struct logger_callsite_t _logger_cs \
+			LOGGER_CALLSITE_ATTR = { \
+			lvl, __LINE__, LOGGER_FILE_NAME, __FUNCTION__, "%s", \
+			&_logger_cs_state \
+		}; \
+		((lvl) >= CFG_LOGGER_MIN_LEVEL && \
+		 LOGGER_CALLSITE_ACTIVE(lvl, _logger_cs_state)) ? \
+		logger_reserve_cs(&_logger_cs, len) : (char *)NULL; \
+	})
+#else
+#define logger_reserve(lvl, len) \
+	((lvl) >= CFG_LOGGER_MIN_LEVEL ? \
+	 logger_reserve_at(lvl, LOGGER_FILE_NAME, __FUNCTION__, __LINE__, len) : \
+	 (char *)NULL)
+#endif /* __GNUC__ */
+
+/**
+ * Emit a structured log call, the fields are built with the KV_* macros.
+ * Like _LOGGER_LOG(), nothing is evaluated when the callsite is inactive.
+ */
+#define _LOGGER_LOG_KV(lvl, msg, ...) \
+	do { \
+		static struct logger_callsite_state_t _logger_cs_state = { \
+			.active = 1, \
+		}; \
+		static const struct logger_callsite_t _logger_cs \
+			LOGGER_CALLSITE_ATTR = { \
+			lvl, __LINE__, LOGGER_FILE_NAME, __FUNCTION__, msg, \
+			&_logger_cs_state \
+		}; \
+		if (LOGGER_UNLIKELY(LOGGER_CALLSITE_ACTIVE(lvl, _logger_cs_state))) { \
+			const struct logger_kv_t _logger_kv[] = { __VA_ARGS__ }; \
+			logger_log_kv(&_logger_cs, _logger_kv, \
+				      sizeof(_logger_kv) / sizeof(_logger_kv[0])); \
+		} \
+	} while (0)
+
+/**
+ * Compiled out structured log call, see _LOGGER_NOP().
+ */
+#define _LOGGER_NOP_KV(msg, ...) \
+	do { \
+		if (0) { \
+			const struct logger_kv_t _logger_kv[] = { __VA_ARGS__ }; \
+			(void)_logger_kv; \
+			(void)(msg); \
+		} \
+	} while (0)
+
+/**
+ * Compiled out log call. The arguments are still type checked but never
+ * evaluated and no code is generated.
+ */
+#define _LOGGER_NOP(msg, ...) \
+	do { \
+		if (0) { \
+			logger_log(0, NULL, NULL, 0, msg, ## __VA_ARGS__); \
+		} \
+	} while (0)
+
+#if LOG_LVL_OK >= CFG_LOGGER_MIN_LEVEL
+#define LOG_OK(msg, ...) _LOGGER_LOG(LOG_LVL_OK, msg, ## __VA_ARGS__)
+#define LOG_OK_KV(msg, ...) _LOGGER_LOG_KV(LOG_LVL_OK, msg, __VA_ARGS__)
+#else
+#define LOG_OK(msg, ...) _LOGGER_NOP(msg, ## __VA_ARGS__)
+#define LOG_OK_KV(msg, ...) _LOGGER_NOP_KV(msg, __VA_ARGS__)
+#endif
+
+#if LOG_LVL_WARN >= CFG_LOGGER_MIN_LEVEL
+#define LOG_WARN(msg, ...) _LOGGER_LOG(LOG_LVL_WARN, msg, ## __VA_ARGS__)
+#define LOG_WARN_KV(msg, ...) _LOGGER_LOG_KV(LOG_LVL_WARN, msg, __VA_ARGS__)
+#else
+#define LOG_WARN(msg, ...) _LOGGER_NOP(msg, ## __VA_ARGS__)
+#define LOG_WARN_KV(msg, ...) _LOGGER_NOP_KV(msg, __VA_ARGS__)
+#endif
+
+#if LOG_LVL_ERROR >= CFG_LOGGER_MIN_LEVEL
+#define LOG_ERROR(msg, ...) _LOGGER_LOG(LOG_LVL_ERROR, msg, ## __VA_ARGS__)
+#define LOG_ERROR_KV(msg, ...) _LOGGER_LOG_KV(LOG_LVL_ERROR, msg, __VA_ARGS__)
+#else
+#define LOG_ERROR(msg, ...) _LOGGER_NOP(msg, ## __VA_ARGS__)
+#define LOG_ERROR_KV(msg, ...) _LOGGER_NOP_KV(msg, __VA_ARGS__)
+#endif
+
+#if LOG_LVL_DEBUG >= CFG_LOGGER_MIN_LEVEL
+#define LOG_DEBUG(msg, ...) _LOGGER_LOG(LOG_LVL_DEBUG, msg, ## __VA_ARGS__)
+#define LOG_DEBUG_KV(msg, ...) _LOGGER_LOG_KV(LOG_LVL_DEBUG, msg, __VA_ARGS__)
+#else
+#define LOG_DEBUG(msg, ...) _LOGGER_NOP(msg, ## __VA_ARGS__)
+#define LOG_DEBUG_KV(msg, ...) _LOGGER_NOP_KV(msg, __VA_ARGS__)
+#endif
+
+#if LOG_LVL_INFO >= CFG_LOGGER_MIN_LEVEL
+#define LOG_INFO(msg, ...) _LOGGER_LOG(LOG_LVL_INFO, msg, ## __VA_ARGS__)
+#define LOG_INFO_KV(msg, ...) _LOGGER_LOG_KV(LOG_LVL_INFO, msg, __VA_ARGS__)
+#else
+#define LOG_INFO(msg, ...) _LOGGER_NOP(msg, ## __VA_ARGS__)
+#define LOG_INFO_KV(msg, ...) _LOGGER_NOP_KV(msg, __VA_ARGS__)
+#endif
+
+#if LOG_LVL_RAW >= CFG_LOGGER_MIN_LEVEL && !defined(CFG_LOGGER_HARD_DISABLE_DEBUG)
+#define LOG_RAW(msg, ...) _LOGGER_LOG(LOG_LVL_RAW, msg, ## __VA_ARGS__)
+#else
+#define LOG_RAW(msg, ...) _LOGGER_NOP(msg, ## __VA_ARGS__)
+#endif
 
 #endif /* _LOGGER_V3_H_ */
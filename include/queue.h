@@ -1,6 +1,24 @@
 /**
  * @file   queue.h
  * @brief  Queue implementation
+ *
+ * A two-lock FIFO queue (Michael & Scott): producers only take the tail lock
+ * and consumers only take the head lock, so a push and a pop never wait on
+ * each other. The queue always holds one dummy element, the head, which keeps
+ * both ends apart.
+ *
+ * Elements come from a pool owned by the queue. The pool is allocated in
+ * chunks: the first one at creation, every next one as large as all chunks
+ * before it, up to an optional maximum. A popped element is put on a
+ * lock-free recycle list which the producers take over as a whole, so once
+ * the pool is large enough there are no allocator calls at all. Chunks are
+ * only freed by queue_destroy().
+ *
+ * A queue with a maximum pool size is bounded. The timed variants of push and
+ * pop sleep on a condition variable while the queue is full or empty, a
+ * thread only takes the lock of the other side to wake a sleeper when there
+ * is one. queue_pop_batch() takes many elements under a single lock.
+ *
  * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
  * @date   Mon May 13 15:48:56 2019
  */
@@ -12,13 +30,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <stdatomic.h>
 
 #ifndef CFG_LOGGER_DEEP_EMBEDDED
 #include <pthread.h>
+#include <time.h>
 #endif /* CFG_LOGGER_DEEP_EMBEDDED */
 
+#include "logger.h"
 
-#include "logger-wrapper.h"
+#if !defined(CFG_QUEUE_POOL_NODES)
+#define CFG_QUEUE_POOL_NODES 64 //!< Elements allocated by queue_create()
+#endif /* CFG_QUEUE_POOL_NODES */
+
+/** Keeps the producer and consumer side of a queue on separate cache lines */
+#define QUEUE_CACHE_LINE 64
 
 /** Typedef for destroy function pointer */
 typedef void (*queue_destroy_t)(void *data);
@@ -30,12 +56,18 @@ typedef void (*queue_destroy_t)(void *data);
  */
 /* --------------------------------------------------------------------------*/
 struct queue_elm_t {
-	int			id;     //!< Psuedo unique id for element
-	struct queue_elm_t *	next;   //!< Ptr to next element
-	struct queue_elm_t *	prev;   //!< Ptr to previous element
-	void *			data;   //!< Ptr to actual data
+	_Atomic(struct queue_elm_t *)	next;   //!< Ptr to next element (queue or pool)
+	void *				data;   //!< Ptr to actual data
 };
 
+/**
+ * @brief  Chunk of preallocated elements
+ */
+struct queue_chunk_t {
+	struct queue_chunk_t *	next;   //!< Previously allocated chunk
+	size_t			nr;     //!< Number of elements in the chunk
+	struct queue_elm_t	elms[]; //!< The elements
+};
 
 /* --------------------------------------------------------------------------*/
 /**
@@ -44,47 +76,136 @@ struct queue_elm_t {
  */
 /* --------------------------------------------------------------------------*/
 struct queue_t {
-	int			n_elements;     //!< Number of elements in the queue
-	struct queue_elm_t *	head;           //!< Ptr to ::queue_elm_t:: that's the head of the queue
-	struct queue_elm_t *	tail;           //!< Ptr to ::queue_elm_t:: that's the tail of the queue
-	queue_destroy_t		destroy;        //!< Callback for deleting data
+	/* Consumer side */
+	struct queue_elm_t *		head;           //!< Dummy element, its next is the first in line
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	pthread_mutex_t			head_lock;      //!< Serializes the consumers
+	pthread_cond_t			not_empty;      //!< Consumers wait here, head lock
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+	queue_destroy_t			destroy;        //!< Callback for deleting data
+
+	/* Producer side */
+	_Alignas(QUEUE_CACHE_LINE)
+	struct queue_elm_t *		tail;           //!< Last element of the queue
+	struct queue_elm_t *		free;           //!< Free elements, only used by producers
+	struct queue_chunk_t *		chunks;         //!< All allocated chunks
+	size_t				nr_nodes;       //!< Allocated elements
+	size_t				max_nodes;      //!< Allocation limit, 0 is unbounded
 #ifndef CFG_LOGGER_DEEP_EMBEDDED
-	pthread_mutex_t		mutex;          //!< Mutex to protect the queue
+	pthread_mutex_t			tail_lock;      //!< Serializes the producers
+	pthread_cond_t			not_full;       //!< Producers wait here, tail lock
 #endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+	/* Shared */
+	_Alignas(QUEUE_CACHE_LINE)
+	_Atomic(struct queue_elm_t *)	recycled;       //!< Popped elements, lock-free stack
+	atomic_int			n_elements;     //!< Number of elements in the queue
+	atomic_int			pop_waiters;    //!< Consumers waiting for an element
+	atomic_int			push_waiters;   //!< Producers waiting for a free element
 };
 
 /** Retrieve the size of a given queue */
-#define QUEUE_SIZE(x) (x)->n_elements
+#define QUEUE_SIZE(x) atomic_load(&(x)->n_elements)
 
 /**
  * @brief Create new queue
  *
+ * The pool starts with CFG_QUEUE_POOL_NODES elements and grows without limit.
+ *
  * @param destroy Destroy callback called when queue is removed
  *
- * @return
+ * @return NULL if failed otherwise the queue
  */
 struct queue_t *queue_create(queue_destroy_t destroy);
 
+/**
+ * @brief Create new queue with a given pool size
+ *
+ * @param destroy Destroy callback called when queue is removed
+ * @param nodes Number of elements allocated up front
+ * @param max_nodes The pool never grows beyond this number of elements (a
+ *                  push fails or waits when the queue is full), 0 means
+ *                  unbounded
+ *
+ * @return NULL if failed otherwise the queue
+ */
+struct queue_t *queue_create_pool(queue_destroy_t destroy, size_t nodes,
+				  size_t max_nodes);
+
 /**
  * @brief Push some data to a queue
  *
  * @param q Queue to which the data will be pushed
  * @param data Data that will be stored
  *
- * @return -1 if failed otherwise 0
+ * @return -1 if failed (or full) otherwise 0
  */
 int queue_push(struct queue_t *q, void *data);
 
+/**
+ * @brief Push some data to a queue, wait while it is full
+ *
+ * @param q Queue to which the data will be pushed
+ * @param data Data that will be stored
+ * @param timeout_ms Maximum time to wait, 0 doesn't wait, < 0 waits forever
+ *
+ * @return -1 if failed (or still full) otherwise 0
+ */
+int queue_push_timed(struct queue_t *q, void *data, int timeout_ms);
+
 /**
  * @brief Pop data from the queue
  *
  * @param q Queue from which data will be pop'd
  * @param data Pointer to the address of the stored data
  *
- * @return -1 if failed otherwise 0
+ * @return -1 if failed (or empty) otherwise 0
  */
 int queue_pop(struct queue_t *q, void **data);
 
+/**
+ * @brief Pop data from the queue, wait while it is empty
+ *
+ * @param q Queue from which data will be pop'd
+ * @param data Pointer to the address of the stored data
+ * @param timeout_ms Maximum time to wait, 0 doesn't wait, < 0 waits forever
+ *
+ * @return -1 if failed (or still empty) otherwise 0
+ */
+int queue_pop_timed(struct queue_t *q, void **data, int timeout_ms);
+
+/**
+ * @brief Pop up to max elements at once
+ *
+ * @param q Queue from which data will be pop'd
+ * @param out Array receiving the data, in queue order
+ * @param max Size of out
+ *
+ * @return -1 if failed otherwise the number of elements pop'd (0 if empty)
+ */
+int queue_pop_batch(struct queue_t *q, void **out, int max);
+
+/**
+ * @brief Pop up to max elements at once, wait until there is at least one
+ *
+ * @param q Queue from which data will be pop'd
+ * @param out Array receiving the data, in queue order
+ * @param max Size of out
+ * @param timeout_ms Maximum time to wait, 0 doesn't wait, < 0 waits forever
+ *
+ * @return -1 if failed otherwise the number of elements pop'd (0 on timeout)
+ */
+int queue_pop_batch_timed(struct queue_t *q, void **out, int max, int timeout_ms);
+
+/**
+ * @brief Retrieve the number of elements the pool can hand out without growing
+ *
+ * @param q Queue
+ *
+ * @return Number of allocated elements (the dummy excluded)
+ */
+size_t queue_capacity(struct queue_t *q);
+
 /**
  * @brief Remove a given queue
  *
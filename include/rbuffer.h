@@ -0,0 +1,277 @@
+/**
+ * @file rbuffer.h
+ * @brief Header file for the record (byte oriented) ring buffer
+ *
+ * Unlike the cbuffer, which stores a fixed number of pointers, the rbuffer
+ * stores variable length records back to back in a single byte array. Every
+ * record is prefixed with a small header holding its length, so memory usage
+ * follows the actual record size.
+ *
+ * A record is always contiguous in memory. When a record doesn't fit in the
+ * space left before the end of the buffer, that space is filled with a padding
+ * record and the record is placed at the start of the buffer.
+ *
+ * Two producer modes are available:
+ * - RBUFFER_MODE_SPSC: one producer, one consumer. The write offset is only
+ *   moved on commit, so a record can be shrunk when it is committed.
+ * - RBUFFER_MODE_MPSC: lock-free multiple producers, one consumer. Producers
+ *   reserve space with a CAS on the write offset and publish the record by
+ *   setting its sequence number. The consumer only hands out records whose
+ *   sequence number matches the read offset and clears every record it
+ *   releases, so stale data can never be mistaken for a committed record.
+ *   A record that is still the last one is shrunk when it is committed, one
+ *   that was followed by another reservation keeps its reserved size.
+ *
+ * In MPSC mode a thread may hold more than one reserved record at a time.
+ *
+ * The write offset (producer side) and the read offset (consumer side) live
+ * on separate cache lines. Producers keep a copy of the read offset and only
+ * reload it when the buffer looks full, in SPSC mode the consumer keeps a
+ * copy of the write offset and only reloads it when the buffer looks empty.
+ * The high-watermark is sampled by the consumer, never by the producers.
+ *
+ * The rbuffer structure and its data area live in one block of memory, the
+ * data area starts on a cache line. rbuffer_init_rbuffer_mem() places both in
+ * memory supplied by the caller (e.g. a static array), nothing is allocated.
+ *
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v1.3
+ * @date 2026-10-16
+ */
+
+#ifndef _RBUFFER_H_
+#define _RBUFFER_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define RBUF_ERR(msg, ...) \
+	printf("(ERROR) %s: %s: (%d) " msg "\n", __FILE__, __FUNCTION__, __LINE__, \
+	       ## __VA_ARGS__)
+
+/**
+ * Alignment of every record in the buffer. At least the size of a record
+ * header, so the space left before the end always holds a padding header.
+ */
+#define RBUFFER_ALIGN 16
+
+/** The data area starts on a cache line */
+#define RBUFFER_CACHE_LINE 64
+
+/** Length value marking a padding record */
+#define RBUFFER_PAD UINT32_MAX
+
+/**
+ * @brief Rbuffer producer modes
+ */
+enum rbuffer_mode_t {
+	RBUFFER_MODE_SPSC = 0,  //!< Single producer, single consumer
+	RBUFFER_MODE_MPSC,      //!< Multiple producers, single consumer
+};
+
+/**
+ * @brief Record header, stored in front of every record
+ */
+struct rbuffer_hdr_t {
+	atomic_size_t	seq;    //!< Offset of the record, offset + 1 once committed
+	uint32_t	size;   //!< Size of the record in the buffer (header included)
+	uint32_t	len;    //!< Payload length or RBUFFER_PAD
+};
+
+/**
+ * @brief Rbuffer data structure
+ */
+struct rbuffer_t {
+	/* Read-only after init */
+	size_t			size;           //!< Size of the data area (power of 2)
+	enum rbuffer_mode_t	mode;           //!< Producer mode
+	uint8_t *		data;           //!< The actual data area
+	bool			external;       //!< Memory supplied by the caller, never freed
+
+	/* Producer side */
+	_Alignas(RBUFFER_CACHE_LINE)
+	atomic_size_t		head;           //!< Write offset (free running)
+	atomic_size_t		tail_cache;     //!< Last seen read offset
+
+	/* Consumer side */
+	_Alignas(RBUFFER_CACHE_LINE)
+	atomic_size_t		tail;           //!< Read offset (free running)
+	size_t			head_cache;     //!< Last seen write offset (SPSC)
+	atomic_size_t		peak;           //!< Highest number of bytes in use, see rbuffer_get_peak
+};
+
+/**
+ * @brief  Initialize a single producer rbuffer
+ *
+ * @param size Number of bytes the buffer should hold, rounded up to a power of 2
+ *
+ * @returns  NULL if failed, otherwise an allocated rbuffer
+ */
+struct rbuffer_t *rbuffer_init_rbuffer(size_t size);
+
+/**
+ * @brief  Initialize the rbuffer for a given producer mode
+ *
+ * @param size Number of bytes the buffer should hold, rounded up to a power of 2
+ * @param mode Producer mode
+ *
+ * @returns  NULL if failed, otherwise an allocated rbuffer
+ */
+struct rbuffer_t *rbuffer_init_rbuffer_mode(size_t size, enum rbuffer_mode_t mode);
+
+/**
+ * @brief  Initialize an rbuffer in memory supplied by the caller
+ *
+ * The rbuffer structure is placed at the first cache line of mem, the data
+ * area uses the largest power of 2 that fits behind it. Destroying the
+ * rbuffer doesn't free mem.
+ *
+ * @param mem Memory that holds the rbuffer, outlives it
+ * @param len Length of mem, see rbuffer_mem_size()
+ * @param mode Producer mode
+ *
+ * @returns  NULL if failed (mem is too small), otherwise the rbuffer
+ */
+struct rbuffer_t *rbuffer_init_rbuffer_mem(void *mem, size_t len, enum rbuffer_mode_t mode);
+
+/**
+ * @brief  Retrieve the memory rbuffer_init_rbuffer_mem() needs for a size
+ *
+ * @param size Number of bytes the buffer should hold, rounded up to a power of 2
+ *
+ * @returns  Length in bytes, alignment slack included
+ */
+size_t rbuffer_mem_size(size_t size);
+
+/**
+ * @brief  Retrieve the rbuffer size in bytes
+ *
+ * @param rbuf Rbuffer of which we retrieve the size
+ *
+ * @returns  The size or 0 if failed
+ */
+static inline size_t rbuffer_get_size(struct rbuffer_t *rbuf)
+{
+	if (rbuf) {
+		return rbuf->size;
+	}
+	return 0;
+}
+
+/**
+ * @brief  Retrieve the number of bytes in use (headers and padding included)
+ *
+ * @param rbuf Rbuffer of which we retrieve the usage
+ *
+ * @returns  The number of bytes in use
+ */
+static inline size_t rbuffer_get_used(struct rbuffer_t *rbuf)
+{
+	if (rbuf) {
+		return atomic_load_explicit(&rbuf->head, memory_order_acquire) -
+		       atomic_load_explicit(&rbuf->tail, memory_order_acquire);
+	}
+	return 0;
+}
+
+/**
+ * @brief  Retrieve the highest number of bytes that was in use at once
+ *
+ * Sampled by the consumer when it looks at the write offset and by this call.
+ * The ring only fills up between two reads, so this is the highest usage
+ * seen at those moments. In MPSC mode records that weren't committed yet
+ * count with their reserved length.
+ *
+ * @param rbuf Rbuffer of which we retrieve the high-watermark
+ *
+ * @returns  The high-watermark in bytes
+ */
+static inline size_t rbuffer_get_peak(struct rbuffer_t *rbuf)
+{
+	if (rbuf) {
+		size_t peak = atomic_load_explicit(&rbuf->peak, memory_order_relaxed);
+		size_t used = rbuffer_get_used(rbuf);
+
+		return used > peak ? used : peak;
+	}
+	return 0;
+}
+
+/**
+ * @brief  Reserve a record and retrieve its write pointer
+ *
+ * @param rbuf The rbuffer in which the record will be reserved
+ * @param len Maximum payload length of the record
+ *
+ * @returns  NULL if failed or full, otherwise a pointer to len writable bytes
+ */
+void *rbuffer_get_write_pointer(struct rbuffer_t *rbuf, size_t len);
+
+/**
+ * @brief  Signal that a reserved record was written
+ *
+ * @param rbuf The rbuffer to which we signal this
+ * @param ptr Pointer returned by rbuffer_get_write_pointer
+ * @param len Actual payload length, can be smaller than the reserved length
+ *
+ * @returns   -1 if failed otherwise 0
+ */
+int rbuffer_signal_element_written(struct rbuffer_t *rbuf, void *ptr, size_t len);
+
+/**
+ * @brief  Retrieve the oldest record
+ *
+ * @param rbuf The rbuffer of which the record will be retrieved
+ * @param len Will hold the payload length of the record
+ *
+ * @returns  NULL if empty, otherwise a pointer to the payload
+ */
+void *rbuffer_get_read_pointer(struct rbuffer_t *rbuf, size_t *len);
+
+/**
+ * @brief  Retrieve the record following a record that wasn't released yet
+ *
+ * Allows the consumer to look at several records before releasing them, each
+ * rbuffer_signal_element_read() then releases the oldest one.
+ *
+ * @param rbuf The rbuffer of which the record will be retrieved
+ * @param prev Payload pointer of the previous record, NULL for the oldest
+ * @param len Will hold the payload length of the record
+ *
+ * @returns  NULL if there is no next record, otherwise a pointer to the payload
+ */
+void *rbuffer_get_next_read_pointer(struct rbuffer_t *rbuf, const void *prev,
+				    size_t *len);
+
+/**
+ * @brief  Signal that the oldest record was read
+ *
+ * @param rbuf The rbuffer to which we signal this
+ *
+ * @returns   -1 if failed otherwise 0
+ */
+int rbuffer_signal_element_read(struct rbuffer_t *rbuf);
+
+/**
+ * @brief  Drop all committed records in the buffer
+ *
+ * Must be called from the consumer side.
+ *
+ * @param rbuf The rbuffer that will be flushed
+ */
+void rbuffer_flush(struct rbuffer_t *rbuf);
+
+/**
+ * @brief  Destroy a given rbuffer
+ *
+ * @param rbuf The rbuffer that will be cleaned
+ */
+void rbuffer_destroy_rbuffer(struct rbuffer_t *rbuf);
+
+#define rbuffer_init(x) rbuffer_init_rbuffer(x)
+#define rbuffer_destroy(x) rbuffer_destroy_rbuffer(x)
+
+#endif /* _RBUFFER_H_ */
@@ -1,9 +1,22 @@
 /**
  * @file tracer.h
- * @brief  A simple header only tracer lib
+ * @brief  A simple tracer lib
+ *
+ * Spans are recorded with TRACE_SCOPE() or TRACE_BEGIN()/TRACE_END(). A span
+ * only lives on the stack until it ends, then it is stored in a ring owned by
+ * the calling thread: no lock and no allocation (besides the first span of a
+ * thread, which allocates its ring). Every ring keeps about the last
+ * CFG_TRACER_RING_EVENTS spans of its thread, tracer_export_chrome() writes
+ * them as Chrome/Perfetto trace JSON.
+ *
+ * Define CFG_TRACER_DISABLE to compile the span macros out.
+ *
+ * The time_trace_t functions are the original, malloc based interface. They
+ * measure CPU time with clock() and are kept for existing users.
+ *
  * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
- * @version v0.1
- * @date 2020-04-16
+ * @version v0.2
+ * @date 2026-10-16
  */
 
 #ifndef _TRACER_H_
@@ -12,8 +25,129 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
 #include <time.h>
 
+#if !defined(CFG_TRACER_RING_EVENTS)
+#define CFG_TRACER_RING_EVENTS 4096 //!< Spans kept per thread, power of 2
+#endif /* CFG_TRACER_RING_EVENTS */
+
+/**
+ * @brief  Span that is being measured
+ */
+struct tracer_span_t {
+	const char *	name;   //!< Name, has to outlive the export (string literal)
+	uint64_t	begin;  //!< tracer_now_ns() at the start, 0 if tracing was off
+};
+
+extern atomic_bool _tracer_enabled; //!< Use tracer_set_enabled
+
+/**
+ * @brief  Monotonic wall clock time in nanoseconds
+ */
+static inline uint64_t tracer_now_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * @brief  Store a finished span in the ring of the calling thread
+ *
+ * @param name Name of the span
+ * @param begin tracer_now_ns() at the start of the span
+ * @param end tracer_now_ns() at the end of the span
+ */
+void tracer_record(const char *name, uint64_t begin, uint64_t end);
+
+/**
+ * @brief  Start a span
+ *
+ * @param name Name of the span, has to outlive the export
+ *
+ * @returns  The span, pass it to tracer_span_end()
+ */
+static inline struct tracer_span_t tracer_span_begin(const char *name)
+{
+	struct tracer_span_t span = { .name = name, .begin = 0 };
+
+	if (atomic_load_explicit(&_tracer_enabled, memory_order_relaxed)) {
+		span.begin = tracer_now_ns();
+	}
+	return span;
+}
+
+/**
+ * @brief  End a span and record it
+ *
+ * @param span Span returned by tracer_span_begin()
+ */
+static inline void tracer_span_end(struct tracer_span_t *span)
+{
+	if (span->begin) {
+		tracer_record(span->name, span->begin, tracer_now_ns());
+	}
+}
+
+/**
+ * @brief  Turn span recording on or off (on by default)
+ *
+ * @param enabled Record spans
+ */
+void tracer_set_enabled(bool enabled);
+
+/**
+ * @brief  Name the calling thread in the exported trace
+ *
+ * @param name Thread name, truncated to 15 characters
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+int tracer_set_thread_name(const char *name);
+
+/**
+ * @brief  Write the recorded spans of all threads as Chrome trace JSON
+ *
+ * The output can be loaded in chrome://tracing or ui.perfetto.dev. Spans that
+ * end while exporting may be missing, recording is never blocked.
+ *
+ * @param out Output
+ *
+ * @returns  -1 if failed, otherwise the number of exported spans
+ */
+int tracer_export_chrome(FILE *out);
+
+/**
+ * @brief  Forget all recorded spans
+ *
+ * Can be called from any thread. A span that ends on another thread while
+ * resetting may be kept.
+ */
+void tracer_reset(void);
+
+#define _TRACER_CAT2(a, b) a ## b
+#define _TRACER_CAT(a, b) _TRACER_CAT2(a, b)
+
+#if !defined(CFG_TRACER_DISABLE)
+/** Trace the rest of the enclosing scope */
+#define TRACE_SCOPE(name) \
+	struct tracer_span_t _TRACER_CAT(_tracer_span_, __LINE__) \
+	__attribute__((cleanup(tracer_span_end))) = tracer_span_begin(name)
+
+/** Start a span stored in var, end it with TRACE_END(var) */
+#define TRACE_BEGIN(var, name) struct tracer_span_t var = tracer_span_begin(name)
+
+/** End a span started with TRACE_BEGIN() */
+#define TRACE_END(var) tracer_span_end(&(var))
+#else /* CFG_TRACER_DISABLE */
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_BEGIN(var, name) do {} while (0)
+#define TRACE_END(var) do {} while (0)
+#endif /* CFG_TRACER_DISABLE */
+
 struct time_trace_t {
 	clock_t begin;
 	clock_t end;
@@ -1,14 +1,26 @@
 /**
  * @file util-cbuffer.c
  * @brief Header file for Circular buffer implementation
- * @author Bram Vlerick <bram.vlerick@openpixelsystems.org> (v1.0, v2.1)
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org> (v1.0, v2.1, v3.0, v3.1)
  * @author Laurens Miers <laurens.miers@mind.be> (v2.0)
- * @version v2.1
- * @date 2020-04-20
+ * @version v3.1
+ * @date 2026-10-16
  */
 
+#include <stdlib.h>
+
 #include "cbuffer.h"
 
+/**
+ * @brief  Slot claimed by the current thread in a MPSC cbuffer
+ */
+struct cbuffer_claim_t {
+	struct cbuffer_t *	cbuf;   //!< Cbuffer in which the slot was claimed
+	size_t			pos;    //!< Claimed write position
+};
+
+static CBUFFER_THREAD_LOCAL struct cbuffer_claim_t _claim;
+
 static inline int _allocate_internal_buffers(struct cbuffer_t *cbuf)
 {
 	cbuf->data = malloc(cbuf->nr_elements * sizeof(void *));
@@ -16,14 +28,39 @@ static inline int _allocate_internal_buffers(struct cbuffer_t *cbuf)
 		CBUF_ERR("Failed to create data pointer");
 		return -1;
 	}
+
+	if (cbuf->mode != CBUFFER_MODE_MPSC) {
+		return 0;
+	}
+
+	cbuf->seq = malloc(cbuf->nr_elements * sizeof(atomic_size_t));
+	if (!cbuf->seq) {
+		CBUF_ERR("Failed to create sequence numbers");
+		free(cbuf->data);
+		return -1;
+	}
 	return 0;
 }
 
-struct cbuffer_t *cbuffer_init_cbuffer(int nr_elements)
+static void _reset_positions(struct cbuffer_t *cbuf)
+{
+	for (int i = 0; cbuf->seq && i < cbuf->nr_elements; i++) {
+		atomic_init(&cbuf->seq[i], (size_t)i);
+	}
+
+	atomic_init(&cbuf->head, 0);
+	atomic_init(&cbuf->tail, 0);
+	cbuf->tail_cache = 0;
+	cbuf->head_cache = 0;
+}
+
+struct cbuffer_t *cbuffer_init_cbuffer_mode(int nr_elements,
+					    enum cbuffer_mode_t mode)
 {
 	struct cbuffer_t *cbuf = NULL;
 
-	cbuf = malloc(sizeof(struct cbuffer_t));
+	/* sizeof is a multiple of the cache line due to the aligned members */
+	cbuf = aligned_alloc(CBUFFER_CACHE_LINE, sizeof(struct cbuffer_t));
 	if (!cbuf) {
 		CBUF_ERR("Failed to allocate the cbuffer");
 		goto error;
@@ -32,14 +69,12 @@ struct cbuffer_t *cbuffer_init_cbuffer(int nr_elements)
 	CBUF_INFO("Buffer created");
 
 	cbuf->nr_elements = nr_elements;
+	cbuf->mode = mode;
 	if (_allocate_internal_buffers(cbuf) < 0) {
 		goto error;
 	}
 
-	cbuf->wp = cbuf->data;
-	cbuf->rp = cbuf->data;
-
-	atomic_init(&cbuf->current_nr_elements, 0);
+	_reset_positions(cbuf);
 
 	return cbuf;
 error:
@@ -49,12 +84,63 @@ error:
 	return NULL;
 }
 
+struct cbuffer_t *cbuffer_init_cbuffer(int nr_elements)
+{
+	return cbuffer_init_cbuffer_mode(nr_elements, CBUFFER_MODE_SPSC);
+}
+
+void *cbuffer_claim_write_pointer_mpsc(struct cbuffer_t *cbuf)
+{
+	if (_claim.cbuf) {
+		CBUF_ERR("WP Already taken!");
+		return NULL;
+	}
+
+	size_t pos = atomic_load_explicit(&cbuf->head, memory_order_relaxed);
+
+	for (;;) {
+		size_t idx = pos % cbuf->nr_elements;
+		size_t seq = atomic_load_explicit(&cbuf->seq[idx],
+						  memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+		if (diff == 0) {
+			if (atomic_compare_exchange_weak_explicit(&cbuf->head,
+								  &pos, pos + 1,
+								  memory_order_relaxed,
+								  memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			/* Slot still holds an element of the previous lap */
+			return NULL;
+		} else {
+			/* Another producer took this slot */
+			pos = atomic_load_explicit(&cbuf->head,
+						   memory_order_relaxed);
+		}
+	}
+
+	_claim.cbuf = cbuf;
+	_claim.pos = pos;
+
+	return cbuf->data[pos % cbuf->nr_elements];
+}
+
+void **cbuffer_claimed_slot_mpsc(struct cbuffer_t *cbuf)
+{
+	if (_claim.cbuf != cbuf) {
+		return NULL;
+	}
+	return &cbuf->data[_claim.pos % cbuf->nr_elements];
+}
+
 int cbuffer_signal_element_read(struct cbuffer_t *cbuf)
 {
 	int error = 0;
 
-	if (!cbuf || !cbuf->rp) {
-		CBUF_ERR("RP: cbuffer or cbuffer->wp cannot be NULL!");
+	if (!cbuf || !cbuf->data) {
+		CBUF_ERR("RP: cbuffer or cbuffer->data cannot be NULL!");
 		return -1;
 	}
 
@@ -66,30 +152,26 @@ int cbuffer_signal_element_read(struct cbuffer_t *cbuf)
 	cbuf->rp_in_use = false;
 #endif /* CBUFFER_VALIDATE_USAGE */
 
-#ifdef CBUFFER_VALIDATE_PTRS
-	CBUF_DEBUG("%p - %p", cbuf->rp, &cbuf->data[cbuf->rp_index]);
-	if (cbuf->rp != &cbuf->data[cbuf->rp_index]) {
-		CBUF_ERR("RP: Something went wrong with read pointer");
-		CBUF_ERR("RP: Either RP is not inline with RP_Index or data ptr has corrupted");
+	size_t pos = atomic_load_explicit(&cbuf->tail, memory_order_relaxed);
+	size_t idx = pos % cbuf->nr_elements;
+
+	if (cbuf->mode == CBUFFER_MODE_MPSC) {
+		if (atomic_load_explicit(&cbuf->seq[idx], memory_order_relaxed) != pos + 1) {
+			CBUF_ERR("RP: Nothing to read!");
+			return -1;
+		}
+
+		/* Hand the slot back to the producers for the next lap */
+		atomic_store_explicit(&cbuf->seq[idx], pos + cbuf->nr_elements,
+				      memory_order_release);
+	} else if (pos == cbuf->head_cache &&
+		   pos == atomic_load_explicit(&cbuf->head, memory_order_acquire)) {
+		CBUF_ERR("RP: Nothing to read!");
 		return -1;
 	}
-#endif /* CBUFFER_VALIDATE_PTRS */
 
-	if (cbuf->rp == &cbuf->data[cbuf->nr_elements - 1]) {
-		CBUF_DEBUG("RP: final element! Moving to start");
-		cbuf->rp = cbuf->data;
-#ifdef CBUFFER_VALIDATE_PTRS
-		cbuf->rp_index = 0;
-#endif /* CBUFFER_VALIDATE_PTRS */
-	} else {
-		CBUF_DEBUG("RP: Incrementing pointer");
-		cbuf->rp++;
-#ifdef CBUFFER_VALIDATE_PTRS
-		cbuf->rp_index++;
-#endif /* CBUFFER_VALIDATE_PTRS */
-	}
-
-	atomic_fetch_sub(&cbuf->current_nr_elements, 1);
+	/* Releases the slot to the producer (SPSC) */
+	atomic_store_explicit(&cbuf->tail, pos + 1, memory_order_release);
 
 	return error;
 }
@@ -97,44 +179,37 @@ int cbuffer_signal_element_read(struct cbuffer_t *cbuf)
 int cbuffer_signal_element_written(struct cbuffer_t *cbuf)
 {
 	int error = 0;
+	size_t pos = 0;
 
-	if (!cbuf || !cbuf->wp) {
-		CBUF_ERR("WP: cbuffer or cbuffer->wp cannot be NULL!");
+	if (!cbuf || !cbuf->data) {
+		CBUF_ERR("WP: cbuffer or cbuffer->data cannot be NULL!");
 		return -1;
 	}
 
+	if (cbuf->mode == CBUFFER_MODE_MPSC) {
+		if (_claim.cbuf != cbuf) {
+			CBUF_ERR("WP: No write pointer taken!");
+			return -1;
+		}
+		pos = _claim.pos;
+		_claim.cbuf = NULL;
+	} else {
 #ifdef CBUFFER_VALIDATE_USAGE
-	if (cbuf->wp_in_use == false) {
-		CBUF_ERR("WP: No write pointer taken!");
-		return -1;
-	}
-	cbuf->wp_in_use = false;
+		if (cbuf->wp_in_use == false) {
+			CBUF_ERR("WP: No write pointer taken!");
+			return -1;
+		}
+		cbuf->wp_in_use = false;
 #endif /* CBUFFER_VALIDATE_USAGE */
-
-#ifdef CBUFFER_VALIDATE_PTRS
-	CBUF_DEBUG("%p - %p", cbuf->wp, &cbuf->data[cbuf->wp_index]);
-	if (cbuf->wp != &cbuf->data[cbuf->wp_index]) {
-		CBUF_ERR("WP: Something went wrong with write pointer");
-		CBUF_ERR("WP: Either WP is not inline with WP_Index or data ptr has corrupted");
-		return -1;
+		/* Publish the slot to the consumer */
+		pos = atomic_load_explicit(&cbuf->head, memory_order_relaxed);
+		atomic_store_explicit(&cbuf->head, pos + 1, memory_order_release);
+		return error;
 	}
-#endif /* CBUFFER_VALIDATE_PTRS */
 
-	if (cbuf->wp == &cbuf->data[cbuf->nr_elements - 1]) {
-		CBUF_DEBUG("WP: Final element! Moving to start");
-		cbuf->wp = cbuf->data;
-#ifdef CBUFFER_VALIDATE_PTRS
-		cbuf->wp_index = 0;
-#endif /* CBUFFER_VALIDATE_PTRS */
-	} else {
-		CBUF_DEBUG("WP: Incrementing pointer");
-		cbuf->wp++;
-#ifdef CBUFFER_VALIDATE_PTRS
-		cbuf->wp_index++;
-#endif /* CBUFFER_VALIDATE_PTRS */
-	}
-
-	atomic_fetch_add(&cbuf->current_nr_elements, 1);
+	/* Publish the slot to the consumer */
+	atomic_store_explicit(&cbuf->seq[pos % cbuf->nr_elements], pos + 1,
+			      memory_order_release);
 
 	return error;
 }
@@ -145,13 +220,7 @@ void cbuffer_flush(struct cbuffer_t *cbuf)
 		return;
 	}
 
-	cbuffer_signal_element_read(cbuf);
-	cbuffer_signal_element_written(cbuf);
-
-	atomic_store(&cbuf->current_nr_elements, 0);
-
-	cbuf->wp = cbuf->data;
-	cbuf->rp = cbuf->data;
+	_reset_positions(cbuf);
 }
 
 void cbuffer_destroy_cbuffer(struct cbuffer_t *cbuf)
@@ -161,6 +230,7 @@ void cbuffer_destroy_cbuffer(struct cbuffer_t *cbuf)
 		/* if (cbuf->data) { */
 		/* CBUFFER_DEALLOCATOR_HELPER(cbuf); */
 		/* } */
+		free(cbuf->seq);
 		free(cbuf->data);
 		free(cbuf);
 	}
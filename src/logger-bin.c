@@ -0,0 +1,775 @@
+/**
+ * @file logger-bin.c
+ * @brief  Binary log file driver and decoder
+ *
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v0.1
+ * @date 2026-10-16
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "logger-bin.h"
+#include "logger-fmt.h"
+#include "logger-deferred.h"
+#include "logger-kv.h"
+
+/** Max length of a file, function or format string in the dictionary */
+#define MAX_CS_STR_LEN 1024
+
+#if CFG_LOGGER_BIN_BUF_SIZE < 4 * MAX_CS_STR_LEN
+#error "CFG_LOGGER_BIN_BUF_SIZE must hold at least one dictionary record"
+#endif /* CFG_LOGGER_BIN_BUF_SIZE */
+
+/** Initial number of slots of the callsite table */
+#define INITIAL_SLOTS 64
+
+/**
+ * @brief  Default binary context
+ */
+static struct logger_bin_ctxt_t _default_ctxt = {
+	.path		= CFG_LOGGER_BIN_PATH,
+	.sync		= false,
+	.fd		= -1,
+	.ids		= NULL,
+	.id_of		= NULL,
+	.nr_slots	= 0,
+	.nr_ids		= 0,
+	.buf		= NULL,
+	.used		= 0,
+};
+
+/**
+ * @brief  Write the collected records to the file
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _write_buf(struct logger_bin_ctxt_t *ctxt)
+{
+	const char *buf = ctxt->buf;
+	size_t len = ctxt->used;
+
+	ctxt->used = 0;
+	while (len) {
+		ssize_t n = write(ctxt->fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/**
+ * @brief  Reserve room for a record in the buffer, writing it out if full
+ *
+ * @param ctxt Binary context
+ * @param len Payload length of the record
+ *
+ * @returns  NULL if failed, otherwise the location of the payload
+ */
+static char *_put_rec(struct logger_bin_ctxt_t *ctxt, int type, int lvl,
+		      uint32_t id, uint64_t ts, size_t len)
+{
+	struct logger_bin_rec_t rec = {
+		.type	= type,
+		.lvl	= lvl,
+		.len	= len,
+		.id	= id,
+		.ts	= ts,
+	};
+
+	if (ctxt->used + sizeof(rec) + len > CFG_LOGGER_BIN_BUF_SIZE &&
+	    _write_buf(ctxt) < 0) {
+		return NULL;
+	}
+
+	memcpy(&ctxt->buf[ctxt->used], &rec, sizeof(rec));
+	ctxt->used += sizeof(rec) + len;
+	return &ctxt->buf[ctxt->used - len];
+}
+
+/**
+ * @brief  Add the offset between logger_clock_ns() and the epoch
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _put_clock(struct logger_bin_ctxt_t *ctxt)
+{
+	struct timespec now;
+	uint64_t ts = logger_clock_ns();
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	int64_t realtime = (int64_t)((uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec) -
+			   (int64_t)ts;
+
+	char *payload = _put_rec(ctxt, LOGGER_BIN_CLOCK, 0, 0, ts, sizeof(realtime));
+	if (!payload) {
+		return -1;
+	}
+	memcpy(payload, &realtime, sizeof(realtime));
+	return 0;
+}
+
+/**
+ * @brief  Add a dictionary record
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _put_callsite(struct logger_bin_ctxt_t *ctxt, const struct logger_callsite_t *cs,
+			 uint32_t id)
+{
+	struct logger_bin_callsite_t fixed = {
+		.lvl	= cs->lvl,
+		.ln	= cs->ln,
+	};
+	const char *slash = strrchr(cs->file, '/');
+	const char *str[3] = { slash ? slash + 1 : cs->file, cs->fn, cs->fmt };
+	size_t len[3];
+	size_t total = sizeof(fixed);
+
+	for (int i = 0; i < 3; i++) {
+		len[i] = strnlen(str[i], MAX_CS_STR_LEN - 1);
+		total += len[i] + 1;
+	}
+
+	char *payload = _put_rec(ctxt, LOGGER_BIN_CALLSITE, logger_mask2id(cs->lvl), id,
+				 0, total);
+	if (!payload) {
+		return -1;
+	}
+
+	memcpy(payload, &fixed, sizeof(fixed));
+	payload += sizeof(fixed);
+	for (int i = 0; i < 3; i++) {
+		memcpy(payload, str[i], len[i]);
+		payload[len[i]] = '\0';
+		payload += len[i] + 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief  Double the callsite table
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _grow_ids(struct logger_bin_ctxt_t *ctxt)
+{
+	size_t nr_slots = ctxt->nr_slots ? ctxt->nr_slots * 2 : INITIAL_SLOTS;
+	const void **ids = calloc(nr_slots, sizeof(*ids));
+	uint32_t *id_of = calloc(nr_slots, sizeof(*id_of));
+
+	if (!ids || !id_of) {
+		free(ids);
+		free(id_of);
+		return -1;
+	}
+
+	for (size_t i = 0; i < ctxt->nr_slots; i++) {
+		if (!ctxt->ids[i]) {
+			continue;
+		}
+		size_t slot = ((uintptr_t)ctxt->ids[i] >> 4) & (nr_slots - 1);
+		while (ids[slot]) {
+			slot = (slot + 1) & (nr_slots - 1);
+		}
+		ids[slot] = ctxt->ids[i];
+		id_of[slot] = ctxt->id_of[i];
+	}
+
+	free(ctxt->ids);
+	free(ctxt->id_of);
+	ctxt->ids = ids;
+	ctxt->id_of = id_of;
+	ctxt->nr_slots = nr_slots;
+	return 0;
+}
+
+/**
+ * @brief  Look up the id of a callsite, adding it to the dictionary when new
+ *
+ * @returns  -1 if failed, otherwise the callsite id
+ */
+static int64_t _callsite_id(struct logger_bin_ctxt_t *ctxt, const struct logger_callsite_t *cs)
+{
+	/* Callsites are static, their address identifies them */
+	size_t slot = ((uintptr_t)cs >> 4) & (ctxt->nr_slots - 1);
+
+	while (ctxt->ids[slot]) {
+		if (ctxt->ids[slot] == cs) {
+			return ctxt->id_of[slot];
+		}
+		slot = (slot + 1) & (ctxt->nr_slots - 1);
+	}
+
+	uint32_t id = ctxt->nr_ids;
+	if (_put_callsite(ctxt, cs, id) < 0) {
+		return -1;
+	}
+	ctxt->ids[slot] = cs;
+	ctxt->id_of[slot] = id;
+	ctxt->nr_ids++;
+
+	/* Keep the table at most half full */
+	if (ctxt->nr_ids * 2 > ctxt->nr_slots && _grow_ids(ctxt) < 0) {
+		return -1;
+	}
+	return id;
+}
+
+/**
+ * @brief  Release everything but the file descriptor
+ */
+static void _free_ctxt(struct logger_bin_ctxt_t *ctxt)
+{
+	free(ctxt->ids);
+	free(ctxt->id_of);
+	free(ctxt->buf);
+	ctxt->ids = NULL;
+	ctxt->id_of = NULL;
+	ctxt->buf = NULL;
+	ctxt->nr_slots = 0;
+	ctxt->nr_ids = 0;
+	ctxt->used = 0;
+}
+
+/**
+ * @brief  Open the binary log file and start a new run
+ *
+ * @param drv Driver which will be initialized
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _init_bin(void *drv)
+{
+	struct logger_driver_t *driver = (struct logger_driver_t *)drv;
+	struct logger_bin_file_t file = {
+		.magic		= LOGGER_BIN_MAGIC,
+		.version	= LOGGER_BIN_VERSION,
+		.long_size	= sizeof(long),
+		.ptr_size	= sizeof(void *),
+		.base		= logger_clock_ns(),
+	};
+
+	if (!driver) {
+		return -1;
+	}
+	if (!driver->priv_data) {
+		driver->priv_data = &_default_ctxt;
+	}
+
+	struct logger_bin_ctxt_t *ctxt = (struct logger_bin_ctxt_t *)driver->priv_data;
+
+	ctxt->fd = open(ctxt->path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (ctxt->fd < 0) {
+		fprintf(stderr, "Failed to open %s: %s\n", ctxt->path, strerror(errno));
+		return -1;
+	}
+
+	ctxt->nr_slots = 0;
+	ctxt->nr_ids = 0;
+	ctxt->used = 0;
+	ctxt->buf = malloc(CFG_LOGGER_BIN_BUF_SIZE);
+	if (!ctxt->buf || _grow_ids(ctxt) < 0) {
+		goto error;
+	}
+
+	memcpy(ctxt->buf, &file, sizeof(file));
+	ctxt->used = sizeof(file);
+	if (_put_clock(ctxt) < 0 || _write_buf(ctxt) < 0) {
+		goto error;
+	}
+
+	return 0;
+
+error:
+	fprintf(stderr, "Failed to start %s: %s\n", ctxt->path, strerror(errno));
+	_free_ctxt(ctxt);
+	close(ctxt->fd);
+	ctxt->fd = -1;
+	return -1;
+}
+
+/**
+ * @brief  Write a batch of messages as binary records
+ *
+ * @param drv Driver which will be written
+ * @param ent Messages that will be written
+ * @param cnt Number of messages
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _write_entries_bin(void *drv, const struct logger_entry_t *ent, int cnt)
+{
+	struct logger_bin_ctxt_t *ctxt = ((struct logger_driver_t *)drv)->priv_data;
+
+	if (!ctxt || ctxt->fd < 0) {
+		return -1;
+	}
+
+	for (int i = 0; i < cnt; i++) {
+		int64_t id = 0;
+
+		if (ent[i].cs) {
+			id = _callsite_id(ctxt, ent[i].cs);
+			if (id < 0) {
+				return -1;
+			}
+		}
+
+		/* Entry and record types share their values, except for KV */
+		int type = ent[i].type == LOGGER_ENTRY_KV ? LOGGER_BIN_KV : ent[i].type;
+		size_t len = ent[i].len < UINT16_MAX ? ent[i].len : UINT16_MAX;
+		char *payload = _put_rec(ctxt, type, logger_mask2id(ent[i].lvl),
+					 id, ent[i].ts, len);
+		if (!payload) {
+			return -1;
+		}
+		memcpy(payload, ent[i].data, len);
+	}
+
+	/* _put_rec writes the buffer once it is full, _flush_bin writes the rest */
+	return 0;
+}
+
+/**
+ * @brief  Record the wall clock and sync the file if requested by the context
+ *
+ * @param drv Driver which will be flushed
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _flush_bin(void *drv)
+{
+	struct logger_bin_ctxt_t *ctxt = ((struct logger_driver_t *)drv)->priv_data;
+
+	if (!ctxt || ctxt->fd < 0) {
+		return -1;
+	}
+	if (_put_clock(ctxt) < 0 || _write_buf(ctxt) < 0) {
+		return -1;
+	}
+	if (ctxt->sync) {
+		return fdatasync(ctxt->fd);
+	}
+	return 0;
+}
+
+/**
+ * @brief  Close the binary log file
+ *
+ * @param drv Driver which will be closed
+ */
+static void _close_bin(void *drv)
+{
+	struct logger_bin_ctxt_t *ctxt = ((struct logger_driver_t *)drv)->priv_data;
+
+	if (!ctxt) {
+		return;
+	}
+	if (ctxt->fd >= 0) {
+		_write_buf(ctxt);
+		close(ctxt->fd);
+		ctxt->fd = -1;
+	}
+	_free_ctxt(ctxt);
+}
+
+static const struct logger_ops_t bin_ops = {
+	.init		= _init_bin,
+	.write		= NULL,
+	.read		= NULL,
+	.flush		= _flush_bin,
+	.close		= _close_bin,
+	.writev		= NULL,
+	.write_entries	= _write_entries_bin,
+};
+
+struct logger_driver_t bin_logger = {
+	.enabled	= true,
+	.name		= "bin",
+	.ops		= &bin_ops,
+	.priv_data	= NULL,
+};
+
+/**
+ * @brief  Callsite as restored by the decoder
+ */
+struct _dec_callsite_t {
+	int		lvl;    //!< Log level mask
+	int		ln;     //!< Line number
+	const char *	file;   //!< File name
+	const char *	fn;     //!< Function name
+	const char *	fmt;    //!< Format string
+	char *		strings; //!< Storage of file, fn and fmt
+};
+
+/**
+ * @brief  Decoder state of the current run
+ */
+struct _decoder_t {
+	struct logger_bin_file_t	run;            //!< Header of the current run
+	int64_t				realtime;       //!< Epoch time minus time stamp
+	struct _dec_callsite_t *	cs;             //!< Callsites, indexed by id
+	size_t				nr_cs;          //!< Number of callsites
+	size_t				max_cs;         //!< Allocated callsites
+};
+
+/**
+ * @brief  Forget the callsites of the previous run
+ */
+static void _dec_reset(struct _decoder_t *dec)
+{
+	for (size_t i = 0; i < dec->nr_cs; i++) {
+		free(dec->cs[i].strings);
+	}
+	dec->nr_cs = 0;
+	dec->realtime = 0;
+}
+
+/**
+ * @brief  Restore a dictionary record
+ *
+ * @returns  -1 if the record is damaged otherwise 0
+ */
+static int _dec_callsite(struct _decoder_t *dec, const struct logger_bin_rec_t *rec,
+			 const char *payload)
+{
+	struct logger_bin_callsite_t fixed;
+	const char *str[3];
+	size_t pos = sizeof(fixed);
+
+	if (rec->id != dec->nr_cs || rec->len < sizeof(fixed)) {
+		return -1;
+	}
+	memcpy(&fixed, payload, sizeof(fixed));
+
+	for (int i = 0; i < 3; i++) {
+		const char *nul = memchr(&payload[pos], '\0', rec->len - pos);
+		if (!nul) {
+			return -1;
+		}
+		str[i] = &payload[pos];
+		pos = nul + 1 - payload;
+	}
+
+	if (dec->nr_cs == dec->max_cs) {
+		size_t max_cs = dec->max_cs ? dec->max_cs * 2 : INITIAL_SLOTS;
+		struct _dec_callsite_t *cs = realloc(dec->cs, max_cs * sizeof(*cs));
+		if (!cs) {
+			return -1;
+		}
+		dec->cs = cs;
+		dec->max_cs = max_cs;
+	}
+
+	struct _dec_callsite_t *cs = &dec->cs[dec->nr_cs];
+	cs->strings = malloc(pos - sizeof(fixed));
+	if (!cs->strings) {
+		return -1;
+	}
+	memcpy(cs->strings, &payload[sizeof(fixed)], pos - sizeof(fixed));
+	cs->lvl = fixed.lvl;
+	cs->ln = fixed.ln;
+	cs->file = cs->strings;
+	cs->fn = cs->strings + (str[1] - str[0]);
+	cs->fmt = cs->strings + (str[2] - str[0]);
+	dec->nr_cs++;
+
+	return 0;
+}
+
+/**
+ * @brief  Render a time stamp like the text drivers do
+ *
+ * @returns  Length of the time stamp, 0 for LOGGER_TS_NONE
+ */
+static size_t _dec_ts(const struct _decoder_t *dec, char *str, size_t size, uint64_t ts,
+		      enum logger_ts_format_t fmt)
+{
+	uint64_t base = dec->run.base;
+	uint64_t us = 0;
+	time_t sec = 0;
+	struct tm tm;
+	int len = 0;
+
+	switch (fmt) {
+	case LOGGER_TS_UPTIME:
+		us = (ts > base ? ts - base : 0) / 1000;
+		len = snprintf(str, size, "[%5llu.%06u] ", (unsigned long long)(us / 1000000),
+			       (unsigned)(us % 1000000));
+		break;
+	case LOGGER_TS_EPOCH:
+		us = (ts + dec->realtime) / 1000;
+		len = snprintf(str, size, "%llu.%06u ", (unsigned long long)(us / 1000000),
+			       (unsigned)(us % 1000000));
+		break;
+	case LOGGER_TS_UTC:
+		us = (ts + dec->realtime) / 1000;
+		sec = us / 1000000;
+		gmtime_r(&sec, &tm);
+		len = strftime(str, size, "%Y-%m-%dT%H:%M:%S", &tm);
+		len += snprintf(&str[len], size - len, ".%06uZ ", (unsigned)(us % 1000000));
+		break;
+	default:
+		str[0] = '\0';
+		break;
+	}
+
+	return len < (int)size ? (size_t)len : size - 1;
+}
+
+/**
+ * @brief  Write a JSON string
+ */
+static void _json_str(FILE *out, const char *str, size_t len)
+{
+	fputc('"', out);
+	for (size_t i = 0; i < len; i++) {
+		unsigned char c = str[i];
+
+		switch (c) {
+		case '"':
+			fputs("\\\"", out);
+			break;
+		case '\\':
+			fputs("\\\\", out);
+			break;
+		case '\n':
+			fputs("\\n", out);
+			break;
+		case '\r':
+			fputs("\\r", out);
+			break;
+		case '\t':
+			fputs("\\t", out);
+			break;
+		default:
+			if (c < 0x20) {
+				fprintf(out, "\\u%04x", c);
+			} else {
+				fputc(c, out);
+			}
+			break;
+		}
+	}
+	fputc('"', out);
+}
+
+/**
+ * @brief  Decode a structured message record
+ *
+ * @returns  0
+ */
+static int _dec_kv(struct _decoder_t *dec, const struct logger_bin_rec_t *rec,
+		   const struct _dec_callsite_t *cs, const char *payload, FILE *out,
+		   enum logger_bin_output_t fmt, enum logger_ts_format_t ts)
+{
+	char line[64 + 128 + 2 * MAX_STR_LEN];
+	char time[64];
+	struct logger_kv_line_t kv = {
+		.time	= NULL,
+		.lvl	= cs->lvl,
+		.file	= cs->file,
+		.fn	= cs->fn,
+		.ln	= cs->ln,
+		.msg	= cs->fmt,
+	};
+
+	if (cs->lvl != LOG_LVL_RAW && _dec_ts(dec, time, sizeof(time), rec->ts, ts)) {
+		kv.time = time;
+	}
+
+	if (fmt == LOGGER_BIN_OUT_JSON) {
+		/* Same members as the other messages, the fields follow msg */
+		logger_kv_render(line, sizeof(line), LOGGER_KV_JSON, &kv, payload, rec->len);
+		fprintf(out, "{\"ts\":%llu,%s\n", (unsigned long long)rec->ts, &line[1]);
+		return 0;
+	}
+
+	size_t len = logger_kv_render(line, sizeof(line), LOGGER_KV_TEXT, &kv,
+				      payload, rec->len);
+	fwrite(line, 1, len, out);
+	fwrite("\r\n", 1, 2, out);
+
+	return 0;
+}
+
+/**
+ * @brief  Decode a message record
+ *
+ * @returns  -1 if the record is damaged otherwise 0
+ */
+static int _dec_message(struct _decoder_t *dec, const struct logger_bin_rec_t *rec,
+			const char *payload, FILE *out, enum logger_bin_output_t fmt,
+			enum logger_ts_format_t ts)
+{
+	const struct _dec_callsite_t *cs = NULL;
+	int raw_id = logger_mask2id(LOG_LVL_RAW);
+	char line[64 + 128 + MAX_STR_LEN + 3];
+	char body[MAX_STR_LEN];
+	size_t len = 0;
+	size_t pos = 0;
+
+	if (rec->lvl > raw_id) {
+		return -1;
+	}
+
+	if (rec->type != LOGGER_BIN_LINE) {
+		if (rec->id >= dec->nr_cs) {
+			return -1;
+		}
+		cs = &dec->cs[rec->id];
+	}
+
+	if (rec->type == LOGGER_BIN_KV) {
+		return _dec_kv(dec, rec, cs, payload, out, fmt, ts);
+	}
+
+	if (rec->type == LOGGER_BIN_ARGS) {
+		/* Packed arguments depend on the type sizes of the writer */
+		if (dec->run.long_size != sizeof(long) || dec->run.ptr_size != sizeof(void *)) {
+			return -1;
+		}
+		len = logger_deferred_render(body, sizeof(body), cs->fmt, payload, rec->len);
+		len = len < sizeof(body) ? len : sizeof(body) - 1;
+		payload = body;
+	} else {
+		len = rec->len < sizeof(line) - 64 - 3 ? rec->len : sizeof(line) - 64 - 3;
+		len = (rec->type == LOGGER_BIN_BODY && len > MAX_STR_LEN - 1) ? MAX_STR_LEN - 1 : len;
+	}
+
+	if (fmt == LOGGER_BIN_OUT_JSON) {
+		fprintf(out, "{\"ts\":%llu", (unsigned long long)rec->ts);
+		if (ts != LOGGER_TS_NONE) {
+			/* Without the brackets and padding of the text layout */
+			const char *start = line;
+
+			pos = _dec_ts(dec, line, 64, rec->ts, ts);
+			while (pos && (line[pos - 1] == ' ' || line[pos - 1] == ']')) {
+				pos--;
+			}
+			while (start < &line[pos] && (*start == '[' || *start == ' ')) {
+				start++;
+			}
+			fputs(",\"time\":", out);
+			_json_str(out, start, &line[pos] - start);
+		}
+		fprintf(out, ",\"level\":\"%s\"", _log_levels[rec->lvl].name);
+		if (cs) {
+			fputs(",\"file\":", out);
+			_json_str(out, cs->file, strlen(cs->file));
+			fputs(",\"function\":", out);
+			_json_str(out, cs->fn, strlen(cs->fn));
+			fprintf(out, ",\"line\":%d", cs->ln);
+		}
+		fputs(",\"msg\":", out);
+		_json_str(out, payload, len);
+		fputs("}\n", out);
+		return 0;
+	}
+
+	if (rec->lvl != raw_id) {
+		pos = _dec_ts(dec, line, 64, rec->ts, ts);
+		if (cs) {
+			pos += logger_fmt_header(&line[pos], 128, cs->lvl, cs->file, cs->fn, cs->ln);
+		}
+	}
+	memcpy(&line[pos], payload, len);
+	pos += len;
+	memcpy(&line[pos], "\r\n", 2);
+	fwrite(line, 1, pos + 2, out);
+
+	return 0;
+}
+
+int logger_bin_decode(FILE *in, FILE *out, enum logger_bin_output_t fmt,
+		      enum logger_ts_format_t ts)
+{
+	struct _decoder_t dec = { 0 };
+	struct logger_bin_rec_t rec;
+	bool started = false;
+	char *payload = NULL;
+	uint32_t magic = LOGGER_BIN_MAGIC;
+	int count = 0;
+
+	if (!in || !out) {
+		return -1;
+	}
+
+	payload = malloc(UINT16_MAX + 1);
+	if (!payload) {
+		return -1;
+	}
+
+	logger_fmt_init_levels();
+
+	/* A run header and a record header have the same size */
+	while (fread(&rec, sizeof(rec), 1, in) == 1) {
+		if (!memcmp(&rec, &magic, sizeof(magic))) {
+			memcpy(&dec.run, &rec, sizeof(dec.run));
+			if (dec.run.version != LOGGER_BIN_VERSION) {
+				goto error;
+			}
+			_dec_reset(&dec);
+			started = true;
+			continue;
+		}
+		if (!started) {
+			goto error;
+		}
+
+		if (rec.len && fread(payload, rec.len, 1, in) != 1) {
+			/* Cut off while it was written */
+			break;
+		}
+
+		switch (rec.type) {
+		case LOGGER_BIN_ARGS:
+		case LOGGER_BIN_BODY:
+		case LOGGER_BIN_LINE:
+		case LOGGER_BIN_KV:
+			if (_dec_message(&dec, &rec, payload, out, fmt, ts) < 0) {
+				goto error;
+			}
+			count++;
+			break;
+		case LOGGER_BIN_CALLSITE:
+			if (_dec_callsite(&dec, &rec, payload) < 0) {
+				goto error;
+			}
+			break;
+		case LOGGER_BIN_CLOCK:
+			if (rec.len != sizeof(dec.realtime)) {
+				goto error;
+			}
+			memcpy(&dec.realtime, payload, sizeof(dec.realtime));
+			break;
+		default:
+			goto error;
+		}
+	}
+
+	_dec_reset(&dec);
+	free(dec.cs);
+	free(payload);
+	return count;
+
+error:
+	_dec_reset(&dec);
+	free(dec.cs);
+	free(payload);
+	return -1;
+}
@@ -0,0 +1,358 @@
+/**
+ * @file logger-deferred.c
+ * @brief  Packing and rendering of deferred log arguments
+ *
+ * The packed format is a plain byte stream. For every conversion in the format
+ * string the '*' width/precision values (int) are stored, followed by the
+ * value itself. Strings are stored as a uint16_t length followed by the
+ * characters and a terminating NUL. Nothing is aligned, all access goes
+ * through memcpy.
+ *
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v0.1
+ * @date 2026-10-16
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "logger-deferred.h"
+#include "logger-fmt.h"
+
+/** Max length of a single conversion specification */
+#define MAX_SPEC_LEN 32
+
+/** Length marker for a NULL string */
+#define STR_NULL 0xFFFF
+
+enum arg_kind_t {
+	ARG_INVALID = 0,        //!< Unsupported conversion
+	ARG_PERCENT,            //!< Literal '%'
+	ARG_INT,                //!< int (also char and short)
+	ARG_LONG,               //!< long
+	ARG_LLONG,              //!< long long
+	ARG_INTMAX,             //!< intmax_t
+	ARG_SIZE,               //!< size_t
+	ARG_PTRDIFF,            //!< ptrdiff_t
+	ARG_DOUBLE,             //!< double
+	ARG_LDOUBLE,            //!< long double
+	ARG_PTR,                //!< void *
+	ARG_STR,                //!< char *
+};
+
+/** Parsed conversion specification */
+struct spec_t {
+	size_t		len;            //!< Length of the spec including '%'
+	int		stars;          //!< Number of '*' arguments
+	bool		prec_star;      //!< Precision is passed as argument
+	int		prec;           //!< Literal precision, -1 if none
+	enum arg_kind_t kind;           //!< Type of the argument
+};
+
+/**
+ * @brief  Map a conversion character and length modifier to an argument type
+ *
+ * @param conv Conversion character
+ * @param lmod Length modifier ('H' for hh, 'q' for ll, 0 for none)
+ *
+ * @returns  The argument type, ARG_INVALID if not supported
+ */
+static enum arg_kind_t _arg_kind(char conv, char lmod)
+{
+	switch (conv) {
+	case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+		switch (lmod) {
+		case 0: case 'H': case 'h': return ARG_INT;
+		case 'l': return ARG_LONG;
+		case 'q': return ARG_LLONG;
+		case 'j': return ARG_INTMAX;
+		case 'z': return ARG_SIZE;
+		case 't': return ARG_PTRDIFF;
+		default: return ARG_INVALID;
+		}
+	case 'c':
+		return (lmod == 0 || lmod == 'l') ? ARG_INT : ARG_INVALID;
+	case 'e': case 'E': case 'f': case 'F':
+	case 'g': case 'G': case 'a': case 'A':
+		if (lmod == 0 || lmod == 'l') {
+			return ARG_DOUBLE;
+		}
+		return lmod == 'L' ? ARG_LDOUBLE : ARG_INVALID;
+	case 's':
+		return lmod == 0 ? ARG_STR : ARG_INVALID;
+	case 'p':
+		return lmod == 0 ? ARG_PTR : ARG_INVALID;
+	case '%':
+		return ARG_PERCENT;
+	default:
+		/* %n, %m and friends need to be handled at the callsite */
+		return ARG_INVALID;
+	}
+}
+
+/**
+ * @brief  Parse a single conversion specification
+ *
+ * @param p Pointer to the '%' starting the spec
+ * @param s Parsed spec
+ *
+ * @returns  Pointer to the first character after the spec
+ */
+static const char *_parse_spec(const char *p, struct spec_t *s)
+{
+	const char *start = p++;
+	char lmod = 0;
+
+	s->stars = 0;
+	s->prec_star = false;
+	s->prec = -1;
+	s->kind = ARG_INVALID;
+
+	while (*p && strchr("-+ #0'", *p)) {
+		p++;
+	}
+
+	if (*p == '*') {
+		s->stars++;
+		p++;
+	} else {
+		while (*p >= '0' && *p <= '9') {
+			p++;
+		}
+	}
+
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			s->stars++;
+			s->prec_star = true;
+			p++;
+		} else {
+			s->prec = 0;
+			while (*p >= '0' && *p <= '9') {
+				s->prec = s->prec * 10 + (*p++ - '0');
+			}
+		}
+	}
+
+	switch (*p) {
+	case 'h':
+		lmod = (*++p == 'h') ? (p++, 'H') : 'h';
+		break;
+	case 'l':
+		lmod = (*++p == 'l') ? (p++, 'q') : 'l';
+		break;
+	case 'j': case 'z': case 't': case 'L':
+		lmod = *p++;
+		break;
+	default:
+		break;
+	}
+
+	if (*p) {
+		s->kind = _arg_kind(*p++, lmod);
+	}
+	s->len = p - start;
+
+	return p;
+}
+
+#define PUT(v) \
+	do { \
+		if (pos + sizeof(v) > len) { \
+			return -1; \
+		} \
+		memcpy(&out[pos], &(v), sizeof(v)); \
+		pos += sizeof(v); \
+	} while (0)
+
+#define PUT_ARG(type, va) \
+	do { \
+		type _v = va_arg(va, type); \
+		PUT(_v); \
+	} while (0)
+
+int logger_deferred_pack(const char *fmt, void *buf, size_t len, va_list va)
+{
+	uint8_t *out = (uint8_t *)buf;
+	size_t pos = 0;
+	struct spec_t s;
+
+	if (!fmt) {
+		return -1;
+	}
+
+	while ((fmt = strchr(fmt, '%')) != NULL) {
+		fmt = _parse_spec(fmt, &s);
+		if (s.kind == ARG_INVALID || s.len >= MAX_SPEC_LEN) {
+			return -1;
+		}
+
+		int prec = s.prec;
+		for (int i = 0; i < s.stars; i++) {
+			int v = va_arg(va, int);
+			if (s.prec_star && i == s.stars - 1) {
+				prec = v;
+			}
+			PUT(v);
+		}
+
+		switch (s.kind) {
+		case ARG_INT: PUT_ARG(int, va); break;
+		case ARG_LONG: PUT_ARG(long, va); break;
+		case ARG_LLONG: PUT_ARG(long long, va); break;
+		case ARG_INTMAX: PUT_ARG(intmax_t, va); break;
+		case ARG_SIZE: PUT_ARG(size_t, va); break;
+		case ARG_PTRDIFF: PUT_ARG(ptrdiff_t, va); break;
+		case ARG_DOUBLE: PUT_ARG(double, va); break;
+		case ARG_LDOUBLE: PUT_ARG(long double, va); break;
+		case ARG_PTR: PUT_ARG(void *, va); break;
+		case ARG_STR: {
+			const char *str = va_arg(va, const char *);
+			uint16_t n = STR_NULL;
+
+			if (str) {
+				if (pos + sizeof(n) >= len) {
+					return -1;
+				}
+				size_t max = len - pos - sizeof(n);
+				size_t sl = (prec >= 0 && (size_t)prec < max) ?
+					    strnlen(str, prec) : strnlen(str, max);
+				if (sl >= max || sl >= STR_NULL) {
+					/* No room for the string and its NUL */
+					return -1;
+				}
+				n = (uint16_t)sl;
+			}
+			PUT(n);
+			if (str) {
+				memcpy(&out[pos], str, n);
+				out[pos + n] = '\0';
+				pos += n + 1;
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	return (int)pos;
+}
+
+#define EMIT(...) \
+	do { \
+		int _n = logger_fmt_format(&str[pos], size - pos, __VA_ARGS__); \
+		if (_n > 0) { \
+			pos += ((size_t)_n < size - pos) ? (size_t)_n : size - pos - 1; \
+		} \
+	} while (0)
+
+#define EMIT_ARG(v) \
+	do { \
+		switch (s.stars) { \
+		case 0: EMIT(spec, v); break; \
+		case 1: EMIT(spec, stars[0], v); break; \
+		default: EMIT(spec, stars[0], stars[1], v); break; \
+		} \
+	} while (0)
+
+#define GET(v) \
+	do { \
+		if (rpos + sizeof(v) > len) { \
+			goto out; \
+		} \
+		memcpy(&(v), &in[rpos], sizeof(v)); \
+		rpos += sizeof(v); \
+	} while (0)
+
+#define GET_EMIT(type) \
+	do { \
+		type _v; \
+		GET(_v); \
+		EMIT_ARG(_v); \
+	} while (0)
+
+/**
+ * @brief  Copy literal characters into the output buffer
+ */
+static size_t _put_chars(char *str, size_t size, size_t pos, const char *src,
+			 size_t n)
+{
+	if (pos + n >= size) {
+		n = size - pos - 1;
+	}
+	memcpy(&str[pos], src, n);
+	return pos + n;
+}
+
+int logger_deferred_render(char *str, size_t size, const char *fmt,
+			   const void *buf, size_t len)
+{
+	const uint8_t *in = (const uint8_t *)buf;
+	const char *next = NULL;
+	size_t pos = 0;
+	size_t rpos = 0;
+	char spec[MAX_SPEC_LEN];
+	struct spec_t s;
+
+	if (!str || !size) {
+		return 0;
+	}
+
+	while ((next = strchr(fmt, '%')) != NULL) {
+		pos = _put_chars(str, size, pos, fmt, next - fmt);
+		fmt = _parse_spec(next, &s);
+
+		if (s.kind == ARG_INVALID || s.len >= MAX_SPEC_LEN) {
+			/* Not packed by logger_deferred_pack, bail out */
+			goto out;
+		}
+		memcpy(spec, next, s.len);
+		spec[s.len] = '\0';
+
+		int stars[2] = { 0, 0 };
+		for (int i = 0; i < s.stars; i++) {
+			GET(stars[i]);
+		}
+
+		switch (s.kind) {
+		case ARG_PERCENT:
+			pos = _put_chars(str, size, pos, "%", 1);
+			break;
+		case ARG_INT: GET_EMIT(int); break;
+		case ARG_LONG: GET_EMIT(long); break;
+		case ARG_LLONG: GET_EMIT(long long); break;
+		case ARG_INTMAX: GET_EMIT(intmax_t); break;
+		case ARG_SIZE: GET_EMIT(size_t); break;
+		case ARG_PTRDIFF: GET_EMIT(ptrdiff_t); break;
+		case ARG_DOUBLE: GET_EMIT(double); break;
+		case ARG_LDOUBLE: GET_EMIT(long double); break;
+		case ARG_PTR: GET_EMIT(void *); break;
+		case ARG_STR: {
+			uint16_t n;
+			GET(n);
+			if (n == STR_NULL) {
+				EMIT_ARG((const char *)NULL);
+			} else {
+				if (rpos + n + 1 > len) {
+					goto out;
+				}
+				EMIT_ARG((const char *)&in[rpos]);
+				rpos += n + 1;
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	pos = _put_chars(str, size, pos, fmt, strlen(fmt));
+
+out:
+	str[pos] = '\0';
+	return (int)pos;
+}
@@ -0,0 +1,210 @@
+/**
+ * @file logger-file.c
+ * @brief  File driver for logger
+ *
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v0.1
+ * @date 2026-10-16
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "logger.h"
+#include "logger-file.h"
+
+#if !defined(IOV_MAX)
+#define IOV_MAX 16
+#endif /* IOV_MAX */
+
+/**
+ * @brief  Default file context
+ */
+static struct logger_file_ctxt_t _default_ctxt = {
+	.path	= CFG_LOGGER_FILE_PATH,
+	.sync	= false,
+	.fd	= -1,
+};
+
+/**
+ * @brief  Write a complete buffer, retrying on short writes
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _write_all(int fd, const char *buf, size_t len)
+{
+	while (len) {
+		ssize_t n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/**
+ * @brief  Open the log file
+ *
+ * @param drv Driver which will be initialized
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _init_file(void *drv)
+{
+	struct logger_driver_t *driver = (struct logger_driver_t *)drv;
+
+	if (!driver) {
+		return -1;
+	}
+	if (!driver->priv_data) {
+		driver->priv_data = &_default_ctxt;
+	}
+
+	struct logger_file_ctxt_t *ctxt = (struct logger_file_ctxt_t *)driver->priv_data;
+
+	ctxt->fd = open(ctxt->path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (ctxt->fd < 0) {
+		fprintf(stderr, "Failed to open %s: %s\n", ctxt->path, strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief  Write a single message to the file
+ *
+ * @param drv Driver which will be written
+ * @param str Message that will be written
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _write_file(void *drv, char *str)
+{
+	struct logger_file_ctxt_t *ctxt = ((struct logger_driver_t *)drv)->priv_data;
+
+	if (!ctxt || ctxt->fd < 0) {
+		return -1;
+	}
+
+	return _write_all(ctxt->fd, str, strlen(str));
+}
+
+/**
+ * @brief  Write a batch of messages to the file with a single writev call
+ *
+ * @param drv Driver which will be written
+ * @param iov Messages that will be written
+ * @param cnt Number of messages
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _writev_file(void *drv, const struct logger_iovec_t *iov, int cnt)
+{
+	struct logger_file_ctxt_t *ctxt = ((struct logger_driver_t *)drv)->priv_data;
+	struct iovec vec[IOV_MAX];
+
+	if (!ctxt || ctxt->fd < 0) {
+		return -1;
+	}
+
+	while (cnt > 0) {
+		int n = cnt < IOV_MAX ? cnt : IOV_MAX;
+		size_t total = 0;
+
+		for (int i = 0; i < n; i++) {
+			vec[i].iov_base = (void *)iov[i].base;
+			vec[i].iov_len = iov[i].len;
+			total += iov[i].len;
+		}
+
+		ssize_t written = writev(ctxt->fd, vec, n);
+		if (written < 0 && errno != EINTR) {
+			return -1;
+		}
+		if (written < 0) {
+			written = 0;
+		}
+
+		if ((size_t)written < total) {
+			/* Short write, finish the remaining spans one by one */
+			for (int i = 0; i < n; i++) {
+				if ((size_t)written >= iov[i].len) {
+					written -= iov[i].len;
+					continue;
+				}
+				if (_write_all(ctxt->fd, iov[i].base + written,
+					       iov[i].len - written) < 0) {
+					return -1;
+				}
+				written = 0;
+			}
+		}
+
+		iov += n;
+		cnt -= n;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief  Flush the file to disk, only if requested by the context
+ *
+ * @param drv Driver which will be flushed
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _flush_file(void *drv)
+{
+	struct logger_file_ctxt_t *ctxt = ((struct logger_driver_t *)drv)->priv_data;
+
+	if (!ctxt || ctxt->fd < 0) {
+		return -1;
+	}
+	if (ctxt->sync) {
+		return fdatasync(ctxt->fd);
+	}
+	return 0;
+}
+
+/**
+ * @brief  Close the log file
+ *
+ * @param drv Driver which will be closed
+ */
+static void _close_file(void *drv)
+{
+	struct logger_file_ctxt_t *ctxt = ((struct logger_driver_t *)drv)->priv_data;
+
+	if (ctxt && ctxt->fd >= 0) {
+		close(ctxt->fd);
+		ctxt->fd = -1;
+	}
+}
+
+static const struct logger_ops_t file_ops = {
+	.init	= _init_file,
+	.write	= _write_file,
+	.read	= NULL,
+	.flush	= _flush_file,
+	.close	= _close_file,
+	.writev	= _writev_file,
+};
+
+struct logger_driver_t file_logger = {
+	.enabled	= true,
+	.name		= "file",
+	.ops		= &file_ops,
+	.priv_data	= NULL,
+};
@@ -0,0 +1,686 @@
+/**
+ * @file logger-fmt.c
+ * @brief  Built-in formatter used for log headers and messages
+ *
+ * Conversions are parsed once and written straight into the output buffer.
+ * Integers are converted two decimal digits at a time from a table. %f is
+ * converted through a scaled 64 bit integer, which is only done when the
+ * rounding of the scaled value can't differ from the exact decimal value;
+ * other values go to the C library.
+ *
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v0.1
+ * @date 2026-10-16
+ */
+
+#define _GNU_SOURCE /* strchrnul() */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "logger-fmt.h"
+
+/** Largest precision handled by the %f fast path */
+#define FMT_MAX_FLOAT_PREC 9
+
+/** Max number of levels with a precomputed prefix */
+#define FMT_MAX_LEVELS 8
+
+/** Max length of a precomputed level prefix */
+#define FMT_MAX_PREFIX_LEN 48
+
+static const char _digits2[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static const char _hex_lower[] = "0123456789abcdef";
+static const char _hex_upper[] = "0123456789ABCDEF";
+
+static const uint64_t _pow10[FMT_MAX_FLOAT_PREC + 1] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+	10000000ULL, 100000000ULL, 1000000000ULL,
+};
+
+/** Precomputed "[<color><name><reset>] (" of every level */
+struct fmt_prefix_t {
+	char	str[FMT_MAX_PREFIX_LEN];        //!< The prefix
+	size_t	len;                            //!< Length, 0 if not computed
+};
+
+static struct fmt_prefix_t _prefixes[FMT_MAX_LEVELS];
+
+/** Output buffer, pos keeps counting past the end like snprintf */
+struct fmt_out_t {
+	char *	str;    //!< Output buffer
+	size_t	room;   //!< Number of characters that fit (size - 1)
+	size_t	pos;    //!< Length of the complete output
+};
+
+/** Parsed conversion specification */
+struct fmt_spec_t {
+	bool	left;           //!< '-' flag
+	bool	zero;           //!< '0' flag
+	bool	alt;            //!< '#' flag
+	char	sign;           //!< '+', ' ' or 0
+	bool	width_star;     //!< Width is passed as argument
+	bool	prec_star;      //!< Precision is passed as argument
+	int	width;          //!< Minimum field width
+	int	prec;           //!< Precision, -1 if none
+	char	lmod;           //!< Length modifier ('H' for hh, 'q' for ll)
+	char	conv;           //!< Conversion character
+};
+
+static inline void _put(struct fmt_out_t *o, const char *src, size_t n)
+{
+	if (o->pos < o->room) {
+		size_t cp = (o->room - o->pos < n) ? o->room - o->pos : n;
+		char *dst = &o->str[o->pos];
+
+		/* Digits and short literals, cheaper than a memcpy() call */
+		if (cp <= 8) {
+			while (cp--) {
+				*dst++ = *src++;
+			}
+		} else {
+			memcpy(dst, src, cp);
+		}
+	}
+	o->pos += n;
+}
+
+static inline void _pad(struct fmt_out_t *o, char c, int n)
+{
+	if (n <= 0) {
+		return;
+	}
+	if (o->pos < o->room) {
+		size_t cp = (o->room - o->pos < (size_t)n) ? o->room - o->pos : (size_t)n;
+		memset(&o->str[o->pos], c, cp);
+	}
+	o->pos += n;
+}
+
+static inline void _finish(struct fmt_out_t *o)
+{
+	if (o->str) {
+		o->str[o->pos < o->room ? o->pos : o->room] = '\0';
+	}
+}
+
+/**
+ * @brief  Convert an unsigned value to decimal
+ *
+ * @param end End of the conversion buffer, digits are written backwards
+ * @param v Value
+ *
+ * @returns  Pointer to the first digit
+ */
+static char *_utoa10(char *end, uint64_t v)
+{
+	char *p = end;
+	uint32_t v32;
+
+	while (v > UINT32_MAX) {
+		unsigned d = (v % 100) * 2;
+		v /= 100;
+		*--p = _digits2[d + 1];
+		*--p = _digits2[d];
+	}
+
+	/* 32 bit divisions are a lot cheaper on most targets */
+	v32 = (uint32_t)v;
+	while (v32 >= 100) {
+		unsigned d = (v32 % 100) * 2;
+		v32 /= 100;
+		*--p = _digits2[d + 1];
+		*--p = _digits2[d];
+	}
+	if (v32 >= 10) {
+		*--p = _digits2[v32 * 2 + 1];
+		*--p = _digits2[v32 * 2];
+	} else {
+		*--p = '0' + v32;
+	}
+	return p;
+}
+
+/**
+ * @brief  Convert an unsigned value to hex or octal
+ */
+static char *_utoa_pow2(char *end, uint64_t v, int shift, const char *digits)
+{
+	char *p = end;
+	uint64_t mask = (1U << shift) - 1;
+
+	do {
+		*--p = digits[v & mask];
+		v >>= shift;
+	} while (v);
+	return p;
+}
+
+/**
+ * @brief  Write digits with sign/prefix, precision zeros and padding
+ *
+ * @param o Output
+ * @param s Conversion specification
+ * @param prefix Sign and/or "0x" prefix
+ * @param plen Length of prefix
+ * @param digits Digits of the value
+ * @param nd Number of digits
+ * @param zeros Zeros required by the precision
+ */
+static void _put_number(struct fmt_out_t *o, const struct fmt_spec_t *s,
+			const char *prefix, int plen, const char *digits, int nd,
+			int zeros)
+{
+	int total = plen + zeros + nd;
+
+	if (s->left) {
+		_put(o, prefix, plen);
+		_pad(o, '0', zeros);
+		_put(o, digits, nd);
+		_pad(o, ' ', s->width - total);
+		return;
+	}
+
+	if (s->zero) {
+		zeros += (s->width > total) ? s->width - total : 0;
+	} else {
+		_pad(o, ' ', s->width - total);
+	}
+	_put(o, prefix, plen);
+	_pad(o, '0', zeros);
+	_put(o, digits, nd);
+}
+
+/**
+ * @brief  Format an integer conversion
+ */
+static void _fmt_int(struct fmt_out_t *o, const struct fmt_spec_t *s, uint64_t v,
+		     bool neg)
+{
+	char buf[24];
+	char prefix[2];
+	int plen = 0;
+	char *end = &buf[sizeof(buf)];
+	char *d = NULL;
+
+	switch (s->conv) {
+	case 'x':
+		d = _utoa_pow2(end, v, 4, _hex_lower);
+		break;
+	case 'X':
+		d = _utoa_pow2(end, v, 4, _hex_upper);
+		break;
+	case 'o':
+		d = _utoa_pow2(end, v, 3, _hex_lower);
+		break;
+	default:
+		d = _utoa10(end, v);
+		break;
+	}
+	int nd = end - d;
+
+	if (s->prec == 0 && v == 0) {
+		nd = 0;
+	}
+	int zeros = (s->prec > nd) ? s->prec - nd : 0;
+
+	if (s->conv == 'd' || s->conv == 'i') {
+		if (neg) {
+			prefix[plen++] = '-';
+		} else if (s->sign) {
+			prefix[plen++] = s->sign;
+		}
+	} else if (s->alt && v && (s->conv == 'x' || s->conv == 'X')) {
+		prefix[plen++] = '0';
+		prefix[plen++] = s->conv;
+	} else if (s->alt && s->conv == 'o' && !zeros && (!nd || *d != '0')) {
+		zeros = 1;
+	}
+
+	_put_number(o, s, prefix, plen, d, nd, zeros);
+}
+
+/**
+ * @brief  Format a %f or %F conversion
+ *
+ * @returns  false if the value has to be formatted by the C library
+ */
+static bool _fmt_float(struct fmt_out_t *o, const struct fmt_spec_t *s, double v)
+{
+	int prec = s->prec < 0 ? 6 : s->prec;
+	char buf[32];
+	char *end = &buf[sizeof(buf)];
+	char prefix = 0;
+
+	if (!isfinite(v) || prec > FMT_MAX_FLOAT_PREC || s->alt) {
+		return false;
+	}
+
+	double a = signbit(v) ? -v : v;
+	double y = a * (double)_pow10[prec];
+
+	/* The scaled value has to be an exact integer once rounded */
+	if (y >= 9007199254740992.0) {
+		return false;
+	}
+
+	/* Truncation equals floor() here, no need to pull in libm */
+	uint64_t fl = (uint64_t)y;
+	double frac = y - (double)fl;
+	double tie = (frac > 0.5) ? frac - 0.5 : 0.5 - frac;
+
+	/*
+	 * y carries a rounding error of at most half an ulp. Close to a tie
+	 * the exact decimal value could round the other way, let libc do it.
+	 */
+	if (tie <= y * 0x1p-51) {
+		return false;
+	}
+
+	uint64_t n = fl + (frac > 0.5);
+	uint64_t ip = n / _pow10[prec];
+	uint64_t fp = n % _pow10[prec];
+	char *d = end;
+
+	if (prec) {
+		for (int i = 0; i < prec; i++) {
+			*--d = '0' + fp % 10;
+			fp /= 10;
+		}
+		*--d = '.';
+	}
+	d = _utoa10(d, ip);
+
+	if (signbit(v)) {
+		prefix = '-';
+	} else if (s->sign) {
+		prefix = s->sign;
+	}
+
+	_put_number(o, s, &prefix, prefix ? 1 : 0, d, end - d, 0);
+
+	return true;
+}
+
+/**
+ * @brief  Find the next '%' or the end of the format string
+ */
+static inline const char *_find_conv(const char *p)
+{
+#if defined(__GLIBC__)
+	return strchrnul(p, '%');
+#else
+	while (*p && *p != '%') {
+		p++;
+	}
+	return p;
+#endif /* __GLIBC__ */
+}
+
+/**
+ * @brief  Parse a conversion specification, without consuming arguments
+ *
+ * @returns  Pointer to the character after the spec
+ */
+static const char *_parse(const char *p, struct fmt_spec_t *s)
+{
+	static const struct fmt_spec_t plain = { .prec = -1 };
+
+	*s = plain;
+
+	/* Most conversions come without flags, width or precision */
+	if (*p >= 'a' && *p != 'h' && *p != 'l' && *p != 'j' && *p != 'z' &&
+	    *p != 't') {
+		s->conv = *p;
+		return p + 1;
+	}
+
+	for (;; p++) {
+		switch (*p) {
+		case '-': s->left = true; continue;
+		case '0': s->zero = true; continue;
+		case '#': s->alt = true; continue;
+		case '+': s->sign = '+'; continue;
+		case ' ': if (!s->sign) s->sign = ' '; continue;
+		default: break;
+		}
+		break;
+	}
+
+	if (*p == '*') {
+		s->width_star = true;
+		p++;
+	} else {
+		while (*p >= '0' && *p <= '9') {
+			s->width = s->width * 10 + (*p++ - '0');
+		}
+	}
+
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			s->prec_star = true;
+			p++;
+		} else {
+			s->prec = 0;
+			while (*p >= '0' && *p <= '9') {
+				s->prec = s->prec * 10 + (*p++ - '0');
+			}
+		}
+	}
+
+	switch (*p) {
+	case 'h':
+		s->lmod = (*++p == 'h') ? (p++, 'H') : 'h';
+		break;
+	case 'l':
+		s->lmod = (*++p == 'l') ? (p++, 'q') : 'l';
+		break;
+	case 'j': case 'z': case 't': case 'L':
+		s->lmod = *p++;
+		break;
+	default:
+		break;
+	}
+
+	s->conv = *p;
+	return *p ? p + 1 : p;
+}
+
+/**
+ * @brief  Check if a parsed spec is handled by the fast path
+ */
+static bool _supported(const struct fmt_spec_t *s)
+{
+	switch (s->conv) {
+	case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+		return s->lmod != 'L';
+	case 'c':
+		return s->lmod == 0;
+	case 's':
+		return s->lmod == 0;
+	case 'p':
+		return s->lmod == 0 && !s->zero && !s->sign && !s->alt &&
+		       s->prec < 0 && !s->prec_star;
+	case 'f': case 'F':
+		return s->lmod == 0 || s->lmod == 'l';
+	case '%':
+		return true;
+	default:
+		return false;
+	}
+}
+
+int logger_fmt_vformat(char *str, size_t size, const char *fmt, va_list va)
+{
+	struct fmt_out_t o = {
+		.str	= size ? str : NULL,
+		.room	= size ? size - 1 : 0,
+		.pos	= 0,
+	};
+	struct fmt_spec_t s;
+	const char *pct = NULL;
+	const char *p = fmt;
+
+	while (*p) {
+		pct = _find_conv(p);
+		_put(&o, p, pct - p);
+		if (!*pct) {
+			break;
+		}
+
+		p = _parse(pct + 1, &s);
+		if (!_supported(&s)) {
+			goto fallback;
+		}
+
+		if (s.width_star) {
+			s.width = va_arg(va, int);
+			if (s.width < 0) {
+				s.left = true;
+				s.width = -s.width;
+			}
+		}
+		if (s.prec_star) {
+			s.prec = va_arg(va, int);
+			if (s.prec < 0) {
+				s.prec = -1;
+			}
+		}
+		if (s.left || (s.prec >= 0 && s.conv != 'f' && s.conv != 'F')) {
+			s.zero = false;
+		}
+
+		switch (s.conv) {
+		case 'd': case 'i': {
+			long long v;
+			switch (s.lmod) {
+			case 'H': v = (signed char)va_arg(va, int); break;
+			case 'h': v = (short)va_arg(va, int); break;
+			case 'l': v = va_arg(va, long); break;
+			case 'q': v = va_arg(va, long long); break;
+			case 'j': v = va_arg(va, intmax_t); break;
+			case 'z': v = (ptrdiff_t)va_arg(va, size_t); break;
+			case 't': v = va_arg(va, ptrdiff_t); break;
+			default: v = va_arg(va, int); break;
+			}
+			uint64_t u = (v < 0) ? -(uint64_t)v : (uint64_t)v;
+			_fmt_int(&o, &s, u, v < 0);
+			break;
+		}
+		case 'u': case 'x': case 'X': case 'o': {
+			uint64_t v;
+			switch (s.lmod) {
+			case 'H': v = (unsigned char)va_arg(va, unsigned); break;
+			case 'h': v = (unsigned short)va_arg(va, unsigned); break;
+			case 'l': v = va_arg(va, unsigned long); break;
+			case 'q': v = va_arg(va, unsigned long long); break;
+			case 'j': v = va_arg(va, uintmax_t); break;
+			case 'z': v = va_arg(va, size_t); break;
+			case 't': v = (uint64_t)va_arg(va, ptrdiff_t); break;
+			default: v = va_arg(va, unsigned); break;
+			}
+			_fmt_int(&o, &s, v, false);
+			break;
+		}
+		case 'c': {
+			char c = (char)va_arg(va, int);
+			if (!s.left) {
+				_pad(&o, ' ', s.width - 1);
+			}
+			_put(&o, &c, 1);
+			if (s.left) {
+				_pad(&o, ' ', s.width - 1);
+			}
+			break;
+		}
+		case 's': {
+			const char *str_arg = va_arg(va, const char *);
+			if (!str_arg) {
+				str_arg = "(null)";
+#if defined(__GLIBC__)
+				/* glibc prints nothing if "(null)" doesn't fit */
+				if (s.prec >= 0 && s.prec < 6) {
+					str_arg = "";
+				}
+#endif /* __GLIBC__ */
+			}
+			size_t len = (s.prec >= 0) ? strnlen(str_arg, s.prec) :
+				     strlen(str_arg);
+			if (!s.left) {
+				_pad(&o, ' ', s.width - (int)len);
+			}
+			_put(&o, str_arg, len);
+			if (s.left) {
+				_pad(&o, ' ', s.width - (int)len);
+			}
+			break;
+		}
+		case 'p': {
+			void *ptr = va_arg(va, void *);
+			if (!ptr) {
+				/* "(nil)", "0x0", ... depending on the C library */
+				char nil[16];
+				int len = snprintf(nil, sizeof(nil), "%p", ptr);
+				s.prec = -1;
+				_put_number(&o, &s, "", 0, nil, len, 0);
+				break;
+			}
+			char buf[24];
+			char *end = &buf[sizeof(buf)];
+			char *d = _utoa_pow2(end, (uintptr_t)ptr, 4, _hex_lower);
+			_put_number(&o, &s, "0x", 2, d, end - d, 0);
+			break;
+		}
+		case 'f': case 'F': {
+			double v = va_arg(va, double);
+			if (!_fmt_float(&o, &s, v)) {
+				/* Rebuild the spec with the resolved width and precision */
+				char spec[16];
+				char *sp = spec;
+
+				*sp++ = '%';
+				if (s.left) *sp++ = '-';
+				if (s.zero) *sp++ = '0';
+				if (s.alt) *sp++ = '#';
+				if (s.sign) *sp++ = s.sign;
+				memcpy(sp, "*.*", 3);
+				sp += 3;
+				*sp++ = s.conv;
+				*sp = '\0';
+
+				char *dst = (o.pos < o.room) ? &o.str[o.pos] : NULL;
+				size_t left = (o.pos < o.room) ? o.room - o.pos + 1 : 0;
+				int n = snprintf(dst, left, spec, s.width, s.prec, v);
+				if (n > 0) {
+					o.pos += n;
+				}
+			}
+			break;
+		}
+		case '%':
+			_put(&o, "%", 1);
+			break;
+		default:
+			break;
+		}
+	}
+
+	_finish(&o);
+	return (int)o.pos;
+
+fallback: {
+		/* Let the C library handle the rest of the format string */
+		char *dst = (o.pos < o.room) ? &o.str[o.pos] : NULL;
+		size_t left = (o.pos < o.room) ? o.room - o.pos + 1 : 0;
+		int n = vsnprintf(dst, left, pct, va);
+
+		if (n < 0) {
+			_finish(&o);
+			return n;
+		}
+		o.pos += n;
+		if (!dst) {
+			_finish(&o);
+		}
+		return (int)o.pos;
+	}
+}
+
+int logger_fmt_format(char *str, size_t size, const char *fmt, ...)
+{
+	va_list va;
+	int len;
+
+	va_start(va, fmt);
+	len = logger_fmt_vformat(str, size, fmt, va);
+	va_end(va);
+
+	return len;
+}
+
+/**
+ * @brief  Write a string right aligned in a field, like "%<width>s"
+ */
+static inline void _put_field(struct fmt_out_t *o, const char *str, int width)
+{
+	size_t len = strlen(str);
+
+	_pad(o, ' ', width - (int)len);
+	_put(o, str, len);
+}
+
+/**
+ * @brief  Write the "[<color><name><reset>] (" prefix of a level
+ */
+static void _put_prefix(struct fmt_out_t *o, int id)
+{
+	_put(o, "[", 1);
+	_put(o, _log_levels[id].color, strlen(_log_levels[id].color));
+	_put_field(o, _log_levels[id].name, 5);
+	_put(o, RESET "] (", strlen(RESET "] ("));
+}
+
+void logger_fmt_init_levels()
+{
+	int id = 0;
+
+	/* Every level has its own bit, LOG_LVL_RAW is the last one */
+	do {
+		struct fmt_out_t o = {
+			.str	= _prefixes[id].str,
+			.room	= FMT_MAX_PREFIX_LEN - 1,
+			.pos	= 0,
+		};
+
+		_put_prefix(&o, id);
+		_finish(&o);
+		/* Too long to cache, keep formatting it on the fly */
+		_prefixes[id].len = (o.pos <= o.room) ? o.pos : 0;
+	} while (_log_levels[id++].mask != LOG_LVL_RAW && id < FMT_MAX_LEVELS);
+}
+
+size_t logger_fmt_header(char *str, size_t size, int lvl, const char *file,
+			 const char *fn, int ln)
+{
+	struct fmt_out_t o = {
+		.str	= size ? str : NULL,
+		.room	= size ? size - 1 : 0,
+		.pos	= 0,
+	};
+	struct fmt_spec_t s = {
+		.width	= 3,
+		.prec	= -1,
+		.conv	= 'd',
+	};
+	int id = logger_mask2id(lvl);
+
+	if (id < FMT_MAX_LEVELS && _prefixes[id].len) {
+		_put(&o, _prefixes[id].str, _prefixes[id].len);
+	} else {
+		_put_prefix(&o, id);
+	}
+	_put_field(&o, file, 20);
+	_put(&o, ")(", 2);
+	_put_field(&o, fn, 30);
+	_put(&o, " @", 2);
+	_fmt_int(&o, &s, (ln < 0) ? -(uint64_t)ln : (uint64_t)ln, ln < 0);
+	_put(&o, ") : ", 4);
+	_finish(&o);
+
+	return (o.pos < o.room) ? o.pos : o.room;
+}
@@ -0,0 +1,422 @@
+/**
+ * @file logger-kv.c
+ * @brief  Packing and rendering of structured log fields
+ *
+ * The packed format is a plain byte stream, every field is stored as its
+ * type (uint8_t), the key length (uint8_t) and the key, followed by the
+ * value: 8 bytes for integers and doubles, 1 byte for booleans and a
+ * uint16_t length followed by the characters for strings. Nothing is
+ * aligned, all access goes through memcpy.
+ *
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v0.1
+ * @date 2026-10-16
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "logger.h"
+#include "logger-kv.h"
+#include "logger-fmt.h"
+
+/** Longest key */
+#define MAX_KEY_LEN UINT8_MAX
+
+/** Length marker for a NULL string */
+#define STR_NULL UINT16_MAX
+
+/** Put before a field key that is also the name of a built-in member */
+#define RESERVED_PREFIX "fields."
+
+/** Members written by logger_kv_render() itself in the logfmt and JSON layouts */
+static const char *_reserved_keys[] = {
+	"time", "level", "file", "function", "line", "msg", "kv_error",
+};
+
+/** Output buffer, the length keeps counting when it is full */
+struct kv_out_t {
+	char *	str;    //!< Output buffer
+	size_t	room;   //!< Number of characters that fit (size - 1)
+	size_t	pos;    //!< Length of the complete output
+};
+
+static inline void _put(struct kv_out_t *o, const char *src, size_t n)
+{
+	if (o->pos < o->room) {
+		size_t cp = (o->room - o->pos < n) ? o->room - o->pos : n;
+
+		memcpy(&o->str[o->pos], src, cp);
+	}
+	o->pos += n;
+}
+
+static inline void _putc(struct kv_out_t *o, char c)
+{
+	if (o->pos < o->room) {
+		o->str[o->pos] = c;
+	}
+	o->pos++;
+}
+
+static inline void _puts(struct kv_out_t *o, const char *s)
+{
+	_put(o, s, strlen(s));
+}
+
+size_t logger_kv_pack(void *buf, size_t len, const struct logger_kv_t *kv, int cnt)
+{
+	uint8_t *out = buf;
+	size_t pos = 0;
+
+	for (int i = 0; i < cnt; i++) {
+		size_t key_len = kv[i].key ? strlen(kv[i].key) : 0;
+		size_t val_len = 0;
+		size_t str_len = 0;
+
+		key_len = key_len < MAX_KEY_LEN ? key_len : MAX_KEY_LEN;
+		switch (kv[i].type) {
+		case LOGGER_KV_INT:
+		case LOGGER_KV_UINT:
+		case LOGGER_KV_DOUBLE:
+			val_len = 8;
+			break;
+		case LOGGER_KV_BOOL:
+			val_len = 1;
+			break;
+		case LOGGER_KV_STR:
+			val_len = sizeof(uint16_t);
+			break;
+		default:
+			continue;
+		}
+
+		if (pos + 2 + key_len + val_len > len) {
+			break;
+		}
+
+		out[pos++] = (uint8_t)kv[i].type;
+		out[pos++] = (uint8_t)key_len;
+		memcpy(&out[pos], kv[i].key, key_len);
+		pos += key_len;
+
+		switch (kv[i].type) {
+		case LOGGER_KV_INT:
+			memcpy(&out[pos], &kv[i].v.i, 8);
+			break;
+		case LOGGER_KV_UINT:
+			memcpy(&out[pos], &kv[i].v.u, 8);
+			break;
+		case LOGGER_KV_DOUBLE:
+			memcpy(&out[pos], &kv[i].v.d, 8);
+			break;
+		case LOGGER_KV_BOOL:
+			out[pos] = kv[i].v.b;
+			break;
+		default:
+			if (kv[i].v.s) {
+				str_len = strlen(kv[i].v.s);
+				if (str_len > len - pos - val_len) {
+					/* Cut, the remaining fields are left out */
+					str_len = len - pos - val_len;
+				}
+				str_len = str_len < STR_NULL ? str_len : STR_NULL - 1;
+				memcpy(&out[pos + val_len], kv[i].v.s, str_len);
+			} else {
+				str_len = STR_NULL;
+			}
+			memcpy(&out[pos], &(uint16_t){ str_len }, val_len);
+			pos += str_len != STR_NULL ? str_len : 0;
+			break;
+		}
+		pos += val_len;
+	}
+
+	return pos;
+}
+
+/**
+ * @brief  Write a string as a JSON string
+ */
+static void _put_json(struct kv_out_t *o, const char *s, size_t n)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	_putc(o, '"');
+	for (size_t i = 0; i < n; i++) {
+		unsigned char c = s[i];
+
+		switch (c) {
+		case '"':
+			_put(o, "\\\"", 2);
+			break;
+		case '\\':
+			_put(o, "\\\\", 2);
+			break;
+		case '\n':
+			_put(o, "\\n", 2);
+			break;
+		case '\r':
+			_put(o, "\\r", 2);
+			break;
+		case '\t':
+			_put(o, "\\t", 2);
+			break;
+		default:
+			if (c < 0x20) {
+				char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+				_put(o, esc, sizeof(esc));
+			} else {
+				_putc(o, c);
+			}
+			break;
+		}
+	}
+	_putc(o, '"');
+}
+
+/**
+ * @brief  Write a logfmt value, quoted when needed
+ */
+static void _put_logfmt(struct kv_out_t *o, const char *s, size_t n)
+{
+	bool quote = !n;
+
+	for (size_t i = 0; i < n && !quote; i++) {
+		quote = s[i] == ' ' || s[i] == '=' || s[i] == '"' ||
+			(unsigned char)s[i] < 0x20;
+	}
+	if (!quote) {
+		_put(o, s, n);
+		return;
+	}
+
+	_putc(o, '"');
+	for (size_t i = 0; i < n; i++) {
+		switch (s[i]) {
+		case '"':
+			_put(o, "\\\"", 2);
+			break;
+		case '\\':
+			_put(o, "\\\\", 2);
+			break;
+		case '\n':
+			_put(o, "\\n", 2);
+			break;
+		default:
+			_putc(o, (unsigned char)s[i] < 0x20 ? ' ' : s[i]);
+			break;
+		}
+	}
+	_putc(o, '"');
+}
+
+/**
+ * @brief  Write a key, string or other value in the given layout
+ */
+static void _put_str(struct kv_out_t *o, enum logger_kv_format_t fmt,
+		     const char *s, size_t n)
+{
+	if (fmt == LOGGER_KV_JSON) {
+		_put_json(o, s, n);
+	} else {
+		_put_logfmt(o, s, n);
+	}
+}
+
+/**
+ * @brief  Write a key and its separator, quoted when needed
+ */
+static void _put_key(struct kv_out_t *o, enum logger_kv_format_t fmt,
+		     const char *key, size_t n)
+{
+	if (fmt == LOGGER_KV_JSON) {
+		_putc(o, ',');
+		_put_json(o, key, n);
+		_putc(o, ':');
+	} else {
+		_putc(o, ' ');
+		_put_logfmt(o, key, n);
+		_putc(o, '=');
+	}
+}
+
+/**
+ * @brief  Check if a field key would repeat a built-in member
+ */
+static bool _reserved_key(const char *key, size_t n)
+{
+	for (size_t i = 0; i < sizeof(_reserved_keys) / sizeof(_reserved_keys[0]); i++) {
+		if (strlen(_reserved_keys[i]) == n && !memcmp(_reserved_keys[i], key, n)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * @brief  Write the packed fields
+ *
+ * @returns  -1 if the fields are damaged otherwise 0
+ */
+static int _put_fields(struct kv_out_t *o, enum logger_kv_format_t fmt,
+		       const uint8_t *buf, size_t len)
+{
+	char prefixed[sizeof(RESERVED_PREFIX) - 1 + MAX_KEY_LEN];
+	char num[32];
+	size_t pos = 0;
+
+	while (pos + 2 <= len) {
+		int type = buf[pos];
+		size_t key_len = buf[pos + 1];
+		const char *key = (const char *)&buf[pos + 2];
+		long long i = 0;
+		unsigned long long u = 0;
+		double d = 0;
+		uint16_t str_len = 0;
+
+		pos += 2 + key_len;
+		if (pos > len) {
+			return -1;
+		}
+
+		if (fmt != LOGGER_KV_TEXT && _reserved_key(key, key_len)) {
+			/* A second "level" or "msg" would hide the real one */
+			memcpy(prefixed, RESERVED_PREFIX, sizeof(RESERVED_PREFIX) - 1);
+			memcpy(&prefixed[sizeof(RESERVED_PREFIX) - 1], key, key_len);
+			key = prefixed;
+			key_len += sizeof(RESERVED_PREFIX) - 1;
+		}
+		_put_key(o, fmt, key, key_len);
+		switch (type) {
+		case LOGGER_KV_INT:
+			if (pos + 8 > len) {
+				return -1;
+			}
+			memcpy(&i, &buf[pos], 8);
+			_put(o, num, logger_fmt_format(num, sizeof(num), "%lld", i));
+			pos += 8;
+			break;
+		case LOGGER_KV_UINT:
+			if (pos + 8 > len) {
+				return -1;
+			}
+			memcpy(&u, &buf[pos], 8);
+			_put(o, num, logger_fmt_format(num, sizeof(num), "%llu", u));
+			pos += 8;
+			break;
+		case LOGGER_KV_DOUBLE:
+			if (pos + 8 > len) {
+				return -1;
+			}
+			memcpy(&d, &buf[pos], 8);
+			if (fmt == LOGGER_KV_JSON && !isfinite(d)) {
+				/* Not a JSON number */
+				_puts(o, "null");
+			} else {
+				_put(o, num, logger_fmt_format(num, sizeof(num), "%.15g", d));
+			}
+			pos += 8;
+			break;
+		case LOGGER_KV_BOOL:
+			if (pos + 1 > len) {
+				return -1;
+			}
+			_puts(o, buf[pos] ? "true" : "false");
+			pos += 1;
+			break;
+		case LOGGER_KV_STR:
+			if (pos + sizeof(str_len) > len) {
+				return -1;
+			}
+			memcpy(&str_len, &buf[pos], sizeof(str_len));
+			pos += sizeof(str_len);
+			if (str_len == STR_NULL) {
+				_puts(o, fmt == LOGGER_KV_JSON ? "null" : "(null)");
+				break;
+			}
+			if (pos + str_len > len) {
+				return -1;
+			}
+			_put_str(o, fmt, (const char *)&buf[pos], str_len);
+			pos += str_len;
+			break;
+		default:
+			return -1;
+		}
+	}
+
+	return pos == len ? 0 : -1;
+}
+
+size_t logger_kv_render(char *str, size_t size, enum logger_kv_format_t fmt,
+			const struct logger_kv_line_t *line, const void *buf,
+			size_t len)
+{
+	struct kv_out_t o = {
+		.str	= str,
+		.room	= size ? size - 1 : 0,
+		.pos	= 0,
+	};
+	const char *time = line->time ? line->time : "";
+	size_t time_len = strlen(time);
+	char num[16];
+
+	if (fmt == LOGGER_KV_TEXT) {
+		_puts(&o, time);
+		if (line->lvl != LOG_LVL_RAW && o.pos < o.room) {
+			o.pos += logger_fmt_header(&str[o.pos], o.room - o.pos + 1,
+						   line->lvl, line->file,
+						   line->fn, line->ln);
+		}
+		_puts(&o, line->msg);
+	} else {
+		/* Without the brackets and padding of the text layout */
+		while (time_len && (time[time_len - 1] == ' ' || time[time_len - 1] == ']')) {
+			time_len--;
+		}
+		while (time_len && (*time == '[' || *time == ' ')) {
+			time++;
+			time_len--;
+		}
+
+		if (fmt == LOGGER_KV_JSON) {
+			_putc(&o, '{');
+		}
+		if (time_len) {
+			_put(&o, fmt == LOGGER_KV_JSON ? "\"time\":" : "time=",
+			     fmt == LOGGER_KV_JSON ? 7 : 5);
+			_put_str(&o, fmt, time, time_len);
+			_putc(&o, fmt == LOGGER_KV_JSON ? ',' : ' ');
+		}
+		_puts(&o, fmt == LOGGER_KV_JSON ? "\"level\":" : "level=");
+		_put_str(&o, fmt, _log_levels[logger_mask2id(line->lvl)].name,
+			 strlen(_log_levels[logger_mask2id(line->lvl)].name));
+		_put_key(&o, fmt, "file", 4);
+		_put_str(&o, fmt, line->file, strlen(line->file));
+		_put_key(&o, fmt, "function", 8);
+		_put_str(&o, fmt, line->fn, strlen(line->fn));
+		_put_key(&o, fmt, "line", 4);
+		_put(&o, num, logger_fmt_format(num, sizeof(num), "%d", line->ln));
+		_put_key(&o, fmt, "msg", 3);
+		_put_str(&o, fmt, line->msg, strlen(line->msg));
+	}
+
+	if (_put_fields(&o, fmt, buf, len) < 0) {
+		_put_key(&o, fmt, "kv_error", 8);
+		_puts(&o, "true");
+	}
+
+	if (fmt == LOGGER_KV_JSON) {
+		_putc(&o, '}');
+	}
+
+	if (str && size) {
+		str[o.pos < o.room ? o.pos : o.room] = '\0';
+	}
+
+	return o.pos < o.room ? o.pos : o.room;
+}
@@ -0,0 +1,349 @@
+/**
+ * @file logger-mmap.c
+ * @brief  Crash persistent memory mapped driver for logger
+ *
+ * Host counterpart of drivers/logger-mem.c: the ring lives in a MAP_SHARED
+ * file mapping instead of a reserved SRAM region.
+ *
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v0.1
+ * @date 2026-10-16
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "logger.h"
+#include "logger-mmap.h"
+
+/**
+ * @brief  Default memory mapped context
+ */
+static struct logger_mmap_ctxt_t _default_ctxt = {
+	.path		= CFG_LOGGER_MMAP_PATH,
+	.size		= CFG_LOGGER_MMAP_SIZE,
+	.sync		= false,
+	.fd		= -1,
+	.hdr		= NULL,
+	.data		= NULL,
+	.prev		= NULL,
+	.prev_len	= 0,
+	.prev_pos	= 0,
+};
+
+/**
+ * @brief  Size of the complete mapping
+ */
+static inline size_t _map_len(const struct logger_mmap_ctxt_t *ctxt)
+{
+	return sizeof(struct logger_mmap_hdr_t) + ctxt->size;
+}
+
+/**
+ * @brief  Check if the mapped header describes a usable ring of this size
+ */
+static bool _hdr_valid(const struct logger_mmap_ctxt_t *ctxt)
+{
+	const struct logger_mmap_hdr_t *hdr = ctxt->hdr;
+
+	return hdr->magic == LOGGER_MMAP_MAGIC && hdr->version == LOGGER_MMAP_VERSION &&
+	       hdr->size == ctxt->size && hdr->offset <= hdr->reserved &&
+	       hdr->reserved - hdr->offset <= hdr->size;
+}
+
+/**
+ * @brief  Copy the tail of the previous run out of the ring
+ *
+ * @param ctxt Context with a valid header
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _recover(struct logger_mmap_ctxt_t *ctxt)
+{
+	struct logger_mmap_hdr_t *hdr = ctxt->hdr;
+	uint64_t end = hdr->offset;
+	uint64_t start = (hdr->reserved > ctxt->size) ? hdr->reserved - ctxt->size : 0;
+
+	if (start >= end) {
+		return 0;
+	}
+
+	size_t len = end - start;
+	size_t pos = start % ctxt->size;
+	size_t first = (len < ctxt->size - pos) ? len : ctxt->size - pos;
+
+	ctxt->prev = malloc(len);
+	if (!ctxt->prev) {
+		return -1;
+	}
+	memcpy(ctxt->prev, &ctxt->data[pos], first);
+	memcpy(&ctxt->prev[first], ctxt->data, len - first);
+	ctxt->prev_len = len;
+	ctxt->prev_pos = 0;
+
+	if (start) {
+		/* The ring wrapped, the oldest line is incomplete */
+		char *nl = memchr(ctxt->prev, '\n', len);
+		ctxt->prev_pos = nl ? (size_t)(nl + 1 - ctxt->prev) : len;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief  Open and map the ring file, recovering the previous run
+ *
+ * @param drv Driver which will be initialized
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _init_mmap(void *drv)
+{
+	struct logger_driver_t *driver = (struct logger_driver_t *)drv;
+	struct stat st;
+	void *map = NULL;
+
+	if (!driver) {
+		return -1;
+	}
+	if (!driver->priv_data) {
+		driver->priv_data = &_default_ctxt;
+	}
+
+	struct logger_mmap_ctxt_t *ctxt = (struct logger_mmap_ctxt_t *)driver->priv_data;
+
+	if (!ctxt->size) {
+		return -1;
+	}
+
+	ctxt->fd = open(ctxt->path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (ctxt->fd < 0) {
+		fprintf(stderr, "Failed to open %s: %s\n", ctxt->path, strerror(errno));
+		return -1;
+	}
+
+	if (fstat(ctxt->fd, &st) < 0) {
+		goto error;
+	}
+
+	/* A file of another size can't hold a ring of ours */
+	bool existing = (size_t)st.st_size == _map_len(ctxt);
+	if (!existing && ftruncate(ctxt->fd, _map_len(ctxt)) < 0) {
+		goto error;
+	}
+
+	map = mmap(NULL, _map_len(ctxt), PROT_READ | PROT_WRITE, MAP_SHARED, ctxt->fd, 0);
+	if (map == MAP_FAILED) {
+		goto error;
+	}
+	ctxt->hdr = map;
+	ctxt->data = (char *)map + sizeof(struct logger_mmap_hdr_t);
+
+	if (existing && _hdr_valid(ctxt)) {
+		if (_recover(ctxt) < 0) {
+			goto error;
+		}
+	} else {
+		memset(ctxt->hdr, 0, sizeof(struct logger_mmap_hdr_t));
+		ctxt->hdr->version = LOGGER_MMAP_VERSION;
+		ctxt->hdr->size = ctxt->size;
+		atomic_thread_fence(memory_order_release);
+		ctxt->hdr->magic = LOGGER_MMAP_MAGIC;
+	}
+
+	/* Drop a write that was interrupted by the crash */
+	ctxt->hdr->reserved = ctxt->hdr->offset;
+	ctxt->hdr->runs++;
+
+	return 0;
+
+error:
+	fprintf(stderr, "Failed to map %s: %s\n", ctxt->path, strerror(errno));
+	if (map && map != MAP_FAILED) {
+		munmap(map, _map_len(ctxt));
+	}
+	ctxt->hdr = NULL;
+	ctxt->data = NULL;
+	close(ctxt->fd);
+	ctxt->fd = -1;
+	return -1;
+}
+
+/**
+ * @brief  Copy a span into the ring
+ *
+ * Only the last size bytes of a span larger than the ring are kept.
+ *
+ * @param ctxt Memory mapped context
+ * @param src Span that will be written
+ * @param len Length of the span
+ */
+static void _put(struct logger_mmap_ctxt_t *ctxt, const char *src, size_t len)
+{
+	struct logger_mmap_hdr_t *hdr = ctxt->hdr;
+	uint64_t end = hdr->offset + len;
+
+	if (len > ctxt->size) {
+		src += len - ctxt->size;
+		len = ctxt->size;
+	}
+
+	size_t pos = (end - len) % ctxt->size;
+	size_t first = (len < ctxt->size - pos) ? len : ctxt->size - pos;
+
+	hdr->reserved = end;
+	atomic_thread_fence(memory_order_release);
+
+	memcpy(&ctxt->data[pos], src, first);
+	memcpy(ctxt->data, &src[first], len - first);
+
+	atomic_thread_fence(memory_order_release);
+	hdr->offset = end;
+	if (len && src[len - 1] == '\n') {
+		hdr->seq++;
+	}
+}
+
+/**
+ * @brief  Write a single message to the ring
+ *
+ * @param drv Driver which will be written
+ * @param str Message that will be written
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _write_mmap(void *drv, char *str)
+{
+	struct logger_mmap_ctxt_t *ctxt = ((struct logger_driver_t *)drv)->priv_data;
+
+	if (!ctxt || !ctxt->hdr) {
+		return -1;
+	}
+
+	_put(ctxt, str, strlen(str));
+	return 0;
+}
+
+/**
+ * @brief  Write a batch of messages to the ring
+ *
+ * @param drv Driver which will be written
+ * @param iov Messages that will be written
+ * @param cnt Number of messages
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _writev_mmap(void *drv, const struct logger_iovec_t *iov, int cnt)
+{
+	struct logger_mmap_ctxt_t *ctxt = ((struct logger_driver_t *)drv)->priv_data;
+
+	if (!ctxt || !ctxt->hdr) {
+		return -1;
+	}
+
+	for (int i = 0; i < cnt; i++) {
+		_put(ctxt, iov[i].base, iov[i].len);
+	}
+	return 0;
+}
+
+/**
+ * @brief  Read the tail of the previous run
+ *
+ * Every call continues where the previous one stopped.
+ *
+ * @param drv Driver which will be read
+ * @param buffer Output buffer, NUL terminated
+ * @param size Size of the output buffer
+ *
+ * @returns  -1 if failed, otherwise the number of bytes read (0 at the end)
+ */
+static int _read_mmap(void *drv, char *buffer, size_t size)
+{
+	struct logger_mmap_ctxt_t *ctxt = ((struct logger_driver_t *)drv)->priv_data;
+
+	if (!ctxt || !buffer || !size) {
+		return -1;
+	}
+
+	size_t left = ctxt->prev ? ctxt->prev_len - ctxt->prev_pos : 0;
+	size_t n = (left < size - 1) ? left : size - 1;
+
+	if (n) {
+		memcpy(buffer, &ctxt->prev[ctxt->prev_pos], n);
+		ctxt->prev_pos += n;
+	}
+	buffer[n] = '\0';
+
+	return n;
+}
+
+/**
+ * @brief  Write the ring to disk, only if requested by the context
+ *
+ * @param drv Driver which will be flushed
+ *
+ * @returns  -1 if failed otherwise 0
+ */
+static int _flush_mmap(void *drv)
+{
+	struct logger_mmap_ctxt_t *ctxt = ((struct logger_driver_t *)drv)->priv_data;
+
+	if (!ctxt || !ctxt->hdr) {
+		return -1;
+	}
+	if (ctxt->sync) {
+		return msync(ctxt->hdr, _map_len(ctxt), MS_SYNC);
+	}
+	return 0;
+}
+
+/**
+ * @brief  Unmap and close the ring file
+ *
+ * @param drv Driver which will be closed
+ */
+static void _close_mmap(void *drv)
+{
+	struct logger_mmap_ctxt_t *ctxt = ((struct logger_driver_t *)drv)->priv_data;
+
+	if (!ctxt) {
+		return;
+	}
+	if (ctxt->hdr) {
+		munmap(ctxt->hdr, _map_len(ctxt));
+		ctxt->hdr = NULL;
+		ctxt->data = NULL;
+	}
+	if (ctxt->fd >= 0) {
+		close(ctxt->fd);
+		ctxt->fd = -1;
+	}
+	free(ctxt->prev);
+	ctxt->prev = NULL;
+	ctxt->prev_len = 0;
+	ctxt->prev_pos = 0;
+}
+
+static const struct logger_ops_t mmap_ops = {
+	.init	= _init_mmap,
+	.write	= _write_mmap,
+	.read	= _read_mmap,
+	.flush	= _flush_mmap,
+	.close	= _close_mmap,
+	.writev	= _writev_mmap,
+};
+
+struct logger_driver_t mmap_logger = {
+	.enabled	= true,
+	.name		= "mmap",
+	.ops		= &mmap_ops,
+	.priv_data	= NULL,
+};
@@ -25,12 +25,25 @@ static int _printf_wrapper(void *priv, char *str)
 	return 0;
 }
 
+static int _fwrite_wrapper(void *priv, const struct logger_iovec_t *iov, int cnt)
+{
+	(void)priv;
+
+	/* stdout is buffered, the whole batch ends up in a single write */
+	for (int i = 0; i < cnt; i++) {
+		fwrite(iov[i].base, 1, iov[i].len, stdout);
+	}
+
+	return 0;
+}
+
 static const struct logger_ops_t stdio_ops = {
 	.init	= NULL,
 	.write	= _printf_wrapper,
 	.read	= NULL,
 	.flush	= NULL,
 	.close	= NULL,
+	.writev	= _fwrite_wrapper,
 };
 
 struct logger_driver_t stdio_logger = {
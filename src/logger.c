@@ -7,27 +7,57 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <stdatomic.h>
 
-#include "cbuffer.h"
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+#include "rbuffer.h"
 #include "logger.h"
+#include "logger-deferred.h"
+#include "logger-fmt.h"
+#include "logger-kv.h"
 
 #if !defined(CFG_LOGGER_EXTERNAL_DRIVER_CONF)
 #if defined(CFG_LOGGER_SIMPLE_LOGGER) && !defined(CFG_LOGGER_ADV_LOGGER)
 extern struct logger_driver_t stdio_logger;
 #endif /* CFG_LOGGER_SIMPLE_LOGGER && !CFG_LOGGER_ADV_LOGGER */
+#if defined(CFG_LOGGER_FILE_LOGGER)
+extern struct logger_driver_t file_logger;
+#endif /* CFG_LOGGER_FILE_LOGGER */
+#if defined(CFG_LOGGER_MMAP_LOGGER)
+extern struct logger_driver_t mmap_logger;
+#endif /* CFG_LOGGER_MMAP_LOGGER */
+#if defined(CFG_LOGGER_BIN_LOGGER)
+extern struct logger_driver_t bin_logger;
+#endif /* CFG_LOGGER_BIN_LOGGER */
 
 static struct logger_driver_t *adrivers[] = {
 #if defined(CFG_LOGGER_SIMPLE_LOGGER) && !defined(CFG_LOGGER_ADV_LOGGER)
 	&stdio_logger,
 #endif /* CFG_LOGGER_SIMPLE_LOGGER && !CFG_LOGGER_ADV_LOGGER */
+#if defined(CFG_LOGGER_FILE_LOGGER)
+	&file_logger,
+#endif /* CFG_LOGGER_FILE_LOGGER */
+#if defined(CFG_LOGGER_MMAP_LOGGER)
+	&mmap_logger,
+#endif /* CFG_LOGGER_MMAP_LOGGER */
+#if defined(CFG_LOGGER_BIN_LOGGER)
+	&bin_logger,
+#endif /* CFG_LOGGER_BIN_LOGGER */
 	NULL,
 };
 #else /* CFG_LOGGER_EXTERNAL_DRIVER_CONF */
 extern struct logger_driver_t *adrivers[];
 #endif /* CFG_LOGGER_EXTERNAL_DRIVER_CONF */
 
-struct log_level_t _log_levels[] = {
+struct log_level_t _log_levels[LOGGER_NR_LEVELS] = {
 	{ LOG_LVL_DEBUG, "DEBUG", MAGENTA, 0 },
 	{ LOG_LVL_INFO,	 "INFO",  BLUE,	   0 },
 	{ LOG_LVL_OK,	 "OKAY",  GREEN,   0 },
@@ -36,148 +66,590 @@ struct log_level_t _log_levels[] = {
 	{ LOG_LVL_RAW,	 "RAW",	  RESET,   0 },
 };
 
-static int _current_loglvl = LOG_LVL_EXTRA;
+int _current_loglvl = LOG_LVL_EXTRA;
+int _drivers_loglvl = LOG_LVL_EXTRA;
+
+/** Max header length */
+#define MAX_HDR_LEN 128
+
+/** Max length of a formatted line (header, body, CRLF and NUL) */
+#define MAX_LINE_LEN (MAX_HDR_LEN + MAX_STR_LEN + 3)
+
+/** Max length of a rendered time stamp (NUL included) */
+#define MAX_TS_LEN 32
+
+/** Max length of the "messages dropped" body (NUL included) */
+#define MAX_DROPS_LEN 32
+
+/** Max length of a message body (NUL included), at most MAX_STR_LEN */
+static size_t _max_msg_len = MAX_STR_LEN;
+
+/** Kind of data stored in a log record */
+enum logger_rec_type_t {
+	LOGGER_REC_TEXT = 0,    //!< Complete line (header, body and CRLF)
+	LOGGER_REC_BODY,        //!< Formatted body, header is added during flush
+	LOGGER_REC_PACKED,      //!< Packed arguments, formatted during flush
+	LOGGER_REC_KV,          //!< Packed fields (logger-kv), rendered during flush
+};
+
+/**
+ * @brief  Log record, stored as a single record in the ring
+ */
+struct logger_record_t {
+	int					lvl;            //!< Log level
+	int					type;           //!< Record type (::logger_rec_type_t)
+	unsigned				dropped;        //!< Messages dropped right before this one
+	unsigned				hdr_len;        //!< Header length of a TEXT record
+	const struct logger_callsite_t *	cs;             //!< Callsite, NULL for logger_log()
+	uint64_t				ts;             //!< Time stamp, logger_clock_ns()
+	char					data[];         //!< Text or packed arguments
+};
+
+#if CFG_LOGGER_RENDER_SIZE < MAX_DROPS_LEN + 2 * (MAX_TS_LEN + MAX_LINE_LEN)
+#error "CFG_LOGGER_RENDER_SIZE must hold at least two lines"
+#endif /* CFG_LOGGER_RENDER_SIZE */
+
+#if CFG_LOGGER_BATCH_NR < 3
+#error "CFG_LOGGER_BATCH_NR must be at least 3"
+#endif /* CFG_LOGGER_BATCH_NR */
+
+/** Scratch buffer used to render records during flush */
+static char _render_buf[CFG_LOGGER_RENDER_SIZE];
+
+/** Messages of the batch that is being written */
+static struct logger_iovec_t _batch[CFG_LOGGER_BATCH_NR];
+
+/** Level of every span in _batch */
+static int _batch_lvl[CFG_LOGGER_BATCH_NR];
+
+/** Same batch, unrendered, for drivers with a write_entries callback */
+static struct logger_entry_t _entries[CFG_LOGGER_BATCH_NR];
+
+/** Part of the batch wanted by a driver that doesn't take every level */
+static struct logger_iovec_t _batch_sel[CFG_LOGGER_BATCH_NR];
+static struct logger_entry_t _entries_sel[CFG_LOGGER_BATCH_NR];
+
+/** Driver flush policy, protected by the flush lock */
+static struct logger_flush_policy_t _flush_policy = {
+	.bytes		= CFG_LOGGER_FLUSH_BYTES,
+	.msgs		= CFG_LOGGER_FLUSH_MSGS,
+	.interval_ms	= CFG_LOGGER_FLUSH_INTERVAL_MS,
+	.on_error	= CFG_LOGGER_FLUSH_ON_ERROR,
+};
+
+static size_t _pending_bytes;   //!< Bytes written since the last driver flush
+static int _pending_msgs;       //!< Messages written since the last driver flush
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+static struct timespec _last_flush; //!< Time of the last driver flush
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+/** Only one thread at a time can drain the ring */
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+static pthread_mutex_t _flush_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local bool _flush_owner; //!< This thread holds _flush_lock
+#else
+static atomic_flag _flush_lock = ATOMIC_FLAG_INIT;
+static bool _flush_owner;               //!< _flush_lock is held
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+/**
+ * @brief  Take the flush lock, unless the caller already holds it
+ *
+ * Without threads the lock can only be held by the code that was
+ * interrupted, waiting for it would never end.
+ *
+ * @param wait Wait for another thread holding the lock
+ *
+ * @returns  false if the lock wasn't taken
+ */
+static bool _flush_lock_take(bool wait)
+{
+	if (_flush_owner) {
+		/* A driver that logs and flushes */
+		return false;
+	}
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	if (wait) {
+		pthread_mutex_lock(&_flush_lock);
+	} else if (pthread_mutex_trylock(&_flush_lock)) {
+		return false;
+	}
+#else
+	(void)wait;
+	if (atomic_flag_test_and_set_explicit(&_flush_lock, memory_order_acquire)) {
+		return false;
+	}
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+	_flush_owner = true;
+	return true;
+}
+
+/**
+ * @brief  Release the flush lock taken by _flush_lock_take()
+ */
+static void _flush_lock_release(void)
+{
+	_flush_owner = false;
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	pthread_mutex_unlock(&_flush_lock);
+#else
+	atomic_flag_clear_explicit(&_flush_lock, memory_order_release);
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+}
 
 const char *_basename(const char *filename)
 {
-	size_t last_index = 0;
+	const char *slash = strrchr(filename, '/');
 
-	for (size_t i = 0; i < strlen(filename); i++) {
-		if (filename[i] == '/') {
-			last_index = i;
-		}
+	return slash ? slash + 1 : filename;
+}
+
+#if defined(__GNUC__) && !defined(CFG_LOGGER_NO_CALLSITE_SECTION)
+/* Provided by the linker, NULL if no callsite was linked in */
+extern const struct logger_callsite_t __start_logger_callsites[] __attribute__((weak));
+extern const struct logger_callsite_t __stop_logger_callsites[] __attribute__((weak));
+
+size_t logger_callsite_count()
+{
+	if (!__start_logger_callsites) {
+		return 0;
 	}
-	return &filename[last_index + 1];
+	return __stop_logger_callsites - __start_logger_callsites;
 }
 
-int logger_mask2id(int mask)
+const struct logger_callsite_t *logger_callsite_get(size_t id)
 {
-	int n = 1;
-	int i = 0;
+	if (id >= logger_callsite_count()) {
+		return NULL;
+	}
+	return &__start_logger_callsites[id];
+}
 
-	while (!(mask & n)) {
-		n = n << 1;
-		i++;
+int logger_callsite_id(const struct logger_callsite_t *cs)
+{
+	if (!cs || !__start_logger_callsites || cs < __start_logger_callsites ||
+	    cs >= __stop_logger_callsites) {
+		return -1;
 	}
-	return i;
+	return (int)(cs - __start_logger_callsites);
+}
+#else
+size_t logger_callsite_count()
+{
+	return 0;
 }
 
-struct cbuffer_t *_cbuf;
-char *strings[CFG_RING_NR_ELEMS];
+const struct logger_callsite_t *logger_callsite_get(size_t id)
+{
+	(void)id;
+	return NULL;
+}
 
-inline int logger_init()
+int logger_callsite_id(const struct logger_callsite_t *cs)
+{
+	(void)cs;
+	return -1;
+}
+#endif /* __GNUC__ && !CFG_LOGGER_NO_CALLSITE_SECTION */
+
+/** Serialises changes of the callsite active flags */
+static atomic_flag _cs_lock = ATOMIC_FLAG_INIT;
+
+/**
+ * @brief  Recompute the active flag of a callsite, caller holds _cs_lock
+ */
+static void _callsite_update(const struct logger_callsite_t *cs)
 {
-	_cbuf = cbuffer_init_cbuffer(CFG_RING_NR_ELEMS);
-	for (int i = 0; i < CFG_RING_NR_ELEMS; i++) {
-		strings[i] = malloc((MAX_STR_LEN + 1) * sizeof(char));
-		cbuffer_set_element(_cbuf, i, strings[i]);
+	int ctrl = atomic_load_explicit(&cs->state->ctrl, memory_order_relaxed);
+	int active = ctrl != LOGGER_CS_OFF;
+
+	if (logger_callsite_count() && ctrl == LOGGER_CS_DEFAULT) {
+		/* Enumerable, so the level is folded into the flag */
+		active = !!(cs->lvl & _current_loglvl & _drivers_loglvl);
 	}
+	atomic_store_explicit(&cs->state->active, active, memory_order_relaxed);
+}
+
+/**
+ * @brief  Levels written to a driver
+ */
+static inline int _driver_loglvl(const struct logger_driver_t *drv)
+{
+	return drv->loglvl ? drv->loglvl : LOG_LVL_EXTRA;
+}
+
+/**
+ * @brief  Recompute the levels wanted by the enabled drivers
+ */
+static void _drivers_loglvl_update(void)
+{
+	int loglvl = LOG_LVL_NONE;
 
 	for (int i = 0; adrivers[i] != NULL; i++) {
 		if (adrivers[i]->enabled && adrivers[i]->ops) {
-			if (adrivers[i]->ops->init) {
-				int error = adrivers[i]->ops->init(
-						(void *)adrivers[i]);
-				if (error < 0) {
-					return -1;
-				}
-			}
+			loglvl |= _driver_loglvl(adrivers[i]);
 		}
 	}
+	_drivers_loglvl = loglvl;
+}
+
+/**
+ * @brief  Recompute the active flag of every callsite
+ */
+static void _callsite_update_all(void)
+{
+	size_t count = logger_callsite_count();
+
+	while (atomic_flag_test_and_set_explicit(&_cs_lock, memory_order_acquire)) {
+	}
+	for (size_t i = 0; i < count; i++) {
+		_callsite_update(logger_callsite_get(i));
+	}
+	atomic_flag_clear_explicit(&_cs_lock, memory_order_release);
+}
+
+int logger_callsite_set(const struct logger_callsite_t *cs,
+			enum logger_callsite_ctrl_t ctrl)
+{
+	if (!cs || !cs->state) {
+		return -1;
+	}
+
+	while (atomic_flag_test_and_set_explicit(&_cs_lock, memory_order_acquire)) {
+	}
+	atomic_store_explicit(&cs->state->ctrl, ctrl, memory_order_relaxed);
+	_callsite_update(cs);
+	atomic_flag_clear_explicit(&_cs_lock, memory_order_release);
+
 	return 0;
 }
 
-int logger_get_loglvl()
+int logger_callsite_set_file(const char *file, int ln,
+			     enum logger_callsite_ctrl_t ctrl)
 {
-	return _current_loglvl;
+	size_t count = logger_callsite_count();
+	int changed = 0;
+
+	if (!file) {
+		return 0;
+	}
+	file = _basename(file);
+
+	for (size_t i = 0; i < count; i++) {
+		const struct logger_callsite_t *cs = logger_callsite_get(i);
+
+		if ((ln && cs->ln != ln) || strcmp(_basename(cs->file), file)) {
+			continue;
+		}
+		if (logger_callsite_set(cs, ctrl) == 0) {
+			changed++;
+		}
+	}
+
+	return changed;
 }
 
-void logger_set_loglvl(int loglvl)
+int logger_mask2id(int mask)
 {
-	LOG_INFO("Changing log level");
-	_current_loglvl = loglvl;
+	int nr_levels = sizeof(_log_levels) / sizeof(_log_levels[0]);
+
+	/* LOG_LVL_RAW is not next to the other bits, look the mask up */
+	for (int i = 0; i < nr_levels; i++) {
+		if (mask & _log_levels[i].mask) {
+			return i;
+		}
+	}
+	return nr_levels - 1;
 }
 
-void logger_log(const int lvl, const char *file, const char *fn, const int ln,
-		char *fmt, ...)
+struct rbuffer_t *_rbuf;
+
+/** Secondary ring, used by LOGGER_OVERFLOW_SPILL */
+static struct rbuffer_t *_spill;
+static size_t _spill_size;      //!< Size of the spill ring, 0 if the policy has none
+
+static void *_ring_mem;         //!< Caller memory of the shared ring, see logger_set_ring_memory
+static size_t _ring_size;       //!< Length of _ring_mem or the ring size, 0 for CFG_RING_SIZE
+static unsigned _ring_flags;    //!< ::logger_ring_flags_t
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+static void *_ring_map;         //!< Mapping holding the shared ring, if huge pages are used
+static size_t _ring_map_len;    //!< Length of _ring_map
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+static atomic_int _overflow_mode;               //!< ::logger_overflow_t
+static atomic_int _overflow_timeout_ms;         //!< Timeout of LOGGER_OVERFLOW_BLOCK
+
+static atomic_ullong _dropped_msgs;             //!< Total number of dropped messages
+static atomic_ullong _dropped_bytes;            //!< Total output bytes of dropped messages
+static atomic_uint _unreported_drops;           //!< Drops not reported by a marker yet
+
+/** Callsite of the "messages dropped" marker */
+static const struct logger_callsite_t _drop_cs = {
+	.lvl	= LOG_LVL_WARN,
+	.ln	= __LINE__,
+	.file	= LOGGER_FILE_NAME,
+	.fn	= "logger",
+	.fmt	= "%u messages dropped",
+	.state	= NULL,
+};
+
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+#if !defined(CFG_LOGGER_TS_CLOCK)
+#if defined(CLOCK_MONOTONIC_COARSE)
+#define CFG_LOGGER_TS_CLOCK CLOCK_MONOTONIC_COARSE //!< Clock used to stamp messages
+#else /* CLOCK_MONOTONIC_COARSE */
+#define CFG_LOGGER_TS_CLOCK CLOCK_MONOTONIC
+#endif /* CLOCK_MONOTONIC_COARSE */
+#endif /* CFG_LOGGER_TS_CLOCK */
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+static atomic_int _ts_format = CFG_LOGGER_TS_FORMAT;   //!< ::logger_ts_format_t
+static atomic_int _kv_format = CFG_LOGGER_KV_FORMAT;   //!< ::logger_kv_format_t
+static uint64_t _ts_base;               //!< logger_clock_ns() at logger_init()
+static int64_t _ts_realtime;            //!< Epoch time minus logger_clock_ns()
+static uint64_t _ts_sec = UINT64_MAX;   //!< Second of the cached UTC date
+static char _ts_date[24];               //!< "YYYY-MM-DDTHH:MM:SS" of _ts_sec
+
+/** Bytes written per level, protected by the flush lock */
+static unsigned long long _level_bytes[LOGGER_NR_LEVELS];
+static unsigned long long _render_ns;   //!< Time spent building batches, flush lock
+static atomic_ullong _format_ns;        //!< Sampled time spent formatting in _log()
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+static _Thread_local unsigned _stats_calls; //!< _log() calls of this thread
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+/** Thread ring states */
+enum logger_tring_state_t {
+	TRING_ACTIVE = 0,       //!< Owned by a thread, drained by the logger
+	TRING_ORPHANED,         //!< Owner has exited, freed by the logger when empty
+	TRING_DETACHED,         //!< Dropped by logger_close, freed by its owner
+};
+
+/**
+ * @brief  Ring owned by a single producer thread (async mode)
+ */
+struct logger_tring_t {
+	struct rbuffer_t *		rbuf;   //!< SPSC ring of the thread
+	atomic_int			state;  //!< ::logger_tring_state_t
+	struct logger_tring_t *		next;   //!< Next registered ring
+};
+
+static struct logger_tring_t *_trings;                  //!< Registered thread rings
+static size_t _tring_size = CFG_RING_THREAD_SIZE;       //!< Size of new thread rings
+static pthread_mutex_t _async_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _async_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t _async_once = PTHREAD_ONCE_INIT;
+static pthread_key_t _tring_key;
+static pthread_t _drainer;
+static atomic_bool _async_enabled;
+static bool _async_stop;
+
+static _Thread_local struct logger_tring_t *_own_tring;
+
+/**
+ * @brief  Thread exit hook, hands the ring over to the logger
+ */
+static void _tring_orphan(void *arg)
 {
-	va_list va;
+	struct logger_tring_t *tring = (struct logger_tring_t *)arg;
 
-	struct line_info_t linfo = {
-		.lvl	= lvl,
-		.file	= _basename(file),
-		.fn	= fn,
-		.ln	= ln,
-	};
+	if (atomic_exchange(&tring->state, TRING_ORPHANED) == TRING_DETACHED) {
+		/* The logger already let go of it */
+		free(tring);
+	}
+}
 
-	if (!(lvl & _current_loglvl)) {
-		return;
+static void _async_init_once(void)
+{
+	pthread_key_create(&_tring_key, _tring_orphan);
+}
+
+/**
+ * @brief  Retrieve (or create) the ring of the calling thread
+ *
+ * @returns  NULL if failed, otherwise the thread's ring
+ */
+static struct rbuffer_t *_thread_ring(void)
+{
+	if (_own_tring) {
+		if (atomic_load_explicit(&_own_tring->state,
+					 memory_order_acquire) == TRING_ACTIVE) {
+			return _own_tring->rbuf;
+		}
+		/* Detached by logger_close, we are the last user */
+		pthread_setspecific(_tring_key, NULL);
+		free(_own_tring);
+		_own_tring = NULL;
 	}
 
+	struct logger_tring_t *tring = malloc(sizeof(struct logger_tring_t));
+	if (!tring) {
+		return NULL;
+	}
 
-	char *str = NULL;
-	if (lvl != LOG_LVL_RAW) {
-		str = cbuffer_get_write_pointer(_cbuf);
-		memset(str, 0, MAX_STR_LEN + 1);
-		snprintf(str, 128,
-				"[%s%5s%s] (%20s)(%30s @%3d) : ",
-				_log_levels[logger_mask2id(linfo.lvl)].color,
-				_log_levels[logger_mask2id(linfo.lvl)].name,
-				RESET, linfo.file, linfo.fn, linfo.ln);
-		cbuffer_signal_element_written(_cbuf);
+	tring->rbuf = rbuffer_init_rbuffer_mode(_tring_size,
+						RBUFFER_MODE_SPSC);
+	if (!tring->rbuf) {
+		free(tring);
+		return NULL;
 	}
+	atomic_init(&tring->state, TRING_ACTIVE);
 
-	va_start(va, fmt);
-	str = cbuffer_get_write_pointer(_cbuf);
-	if (!str) goto error;
-	memset(str, 0, MAX_STR_LEN + 1);
-	vsnprintf(str, MAX_STR_LEN, fmt, va);
-	cbuffer_signal_element_written(_cbuf);
+	pthread_mutex_lock(&_async_lock);
+	tring->next = _trings;
+	_trings = tring;
+	pthread_mutex_unlock(&_async_lock);
 
-	va_end(va);
+	pthread_setspecific(_tring_key, tring);
+	_own_tring = tring;
 
-	str = cbuffer_get_write_pointer(_cbuf);
-	if (!str) goto error;
+	return tring->rbuf;
+}
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
 
-	memset(str, 0, MAX_STR_LEN + 1);
-	snprintf(str, MAX_STR_LEN, "\r\n");
-	cbuffer_signal_element_written(_cbuf);
-	_log_levels[logger_mask2id(lvl)].counter++;
+/**
+ * @brief  Monotonic time for the statistics, in nanoseconds
+ *
+ * Unlike logger_clock_ns() always precise, 0 when CFG_LOGGER_DEEP_EMBEDDED
+ * is defined.
+ */
+static inline uint64_t _stats_now(void)
+{
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	struct timespec now;
 
-#ifdef UNIT_TEST
-	logger_flush();
-#endif
-error:
-	va_end(va);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+#else /* CFG_LOGGER_DEEP_EMBEDDED */
+	return 0;
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
 }
 
-void logger_flush()
+/**
+ * @brief  Check if the formatting of this _log() call should be timed
+ */
+static inline bool _stats_sample(void)
+{
+#if !defined(CFG_LOGGER_DEEP_EMBEDDED) && CFG_LOGGER_STATS_SAMPLE
+	return ++_stats_calls % CFG_LOGGER_STATS_SAMPLE == 0;
+#else
+	return false;
+#endif /* !CFG_LOGGER_DEEP_EMBEDDED && CFG_LOGGER_STATS_SAMPLE */
+}
+
+/**
+ * @brief  Add a call to a latency histogram
+ *
+ * @param hist Histogram, caller holds the flush lock
+ * @param ns Duration of the call
+ */
+static void _hist_add(struct logger_hist_t *hist, uint64_t ns)
 {
-	char *str = NULL;
-	while ((str = cbuffer_get_read_pointer(_cbuf)) != NULL) {
+	uint64_t us = ns / 1000;
+	int bucket = us ? 64 - __builtin_clzll(us) : 0;
 
-		for (int i = 0; adrivers[i] != NULL; i++) {
-			if (adrivers[i]->enabled && adrivers[i]->ops) {
-				if (adrivers[i]->ops->write) {
-					adrivers[i]->ops->write(
-							(void *)adrivers[i], str);
-				}
-				if (adrivers[i]->ops->flush) {
-					adrivers[i]->ops->flush(
-							(void *)adrivers[i]);
-				}
+	hist->count[bucket < LOGGER_HIST_BUCKETS ? bucket : LOGGER_HIST_BUCKETS - 1]++;
+	hist->total_ns += ns;
+	if (ns > hist->max_ns) {
+		hist->max_ns = ns;
+	}
+}
+
+/**
+ * @brief  Retrieve the ring the calling thread should log into
+ */
+static inline struct rbuffer_t *_producer_ring(void)
+{
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	if (atomic_load_explicit(&_async_enabled, memory_order_relaxed)) {
+		return _thread_ring();
+	}
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+	return _rbuf;
+}
+
+int logger_set_ring_memory(void *mem, size_t size, unsigned flags)
+{
+	if (_rbuf || (mem && !size)) {
+		return -1;
+	}
+
+	_ring_mem = mem;
+	_ring_size = size;
+	_ring_flags = flags;
+	return 0;
+}
+
+/**
+ * @brief  Create the shared ring as set by logger_set_ring_memory()
+ *
+ * @returns  NULL if failed, otherwise the ring
+ */
+static struct rbuffer_t *_create_ring(void)
+{
+	size_t size = _ring_size ? _ring_size : CFG_RING_SIZE;
+
+	if (_ring_mem) {
+		return rbuffer_init_rbuffer_mem(_ring_mem, _ring_size, RBUFFER_MODE_MPSC);
+	}
+
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	if (_ring_flags & LOGGER_RING_HUGE_PAGES) {
+		const size_t huge = 2 * 1024 * 1024;
+		size_t len = (rbuffer_mem_size(size) + huge - 1) & ~(huge - 1);
+		void *map = mmap(NULL, len, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+		if (map == MAP_FAILED) {
+			/* No reserved huge pages, ask for transparent ones */
+			map = mmap(NULL, len, PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (map != MAP_FAILED) {
+				madvise(map, len, MADV_HUGEPAGE);
 			}
 		}
-		cbuffer_signal_element_read(_cbuf);
+		if (map != MAP_FAILED) {
+			_ring_map = map;
+			_ring_map_len = len;
+			return rbuffer_init_rbuffer_mem(map, rbuffer_mem_size(size),
+							RBUFFER_MODE_MPSC);
+		}
 	}
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+	return rbuffer_init_rbuffer_mode(size, RBUFFER_MODE_MPSC);
 }
 
-void logger_close()
+/**
+ * @brief  Release the shared ring and the spill ring
+ */
+static void _destroy_rings(void)
 {
-	if (_cbuf) {
-		cbuffer_destroy_cbuffer(_cbuf);
+	if (_rbuf) {
+		rbuffer_destroy_rbuffer(_rbuf);
+		_rbuf = NULL;
 	}
-	for (int i = 0; adrivers[i] != NULL; i++) {
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	if (_ring_map) {
+		munmap(_ring_map, _ring_map_len);
+		_ring_map = NULL;
+	}
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+	if (_spill) {
+		rbuffer_destroy_rbuffer(_spill);
+		_spill = NULL;
+	}
+}
+
+/**
+ * @brief  Close the enabled drivers
+ *
+ * @param nr Number of drivers to close, -1 for all of them
+ */
+static void _close_drivers(int nr)
+{
+	for (int i = 0; adrivers[i] != NULL && i != nr; i++) {
 		if (adrivers[i]->enabled && adrivers[i]->ops) {
 			if (adrivers[i]->ops->close) {
 				adrivers[i]->ops->close((void *)adrivers[i]);
@@ -185,3 +657,1607 @@ void logger_close()
 		}
 	}
 }
+
+inline int logger_init()
+{
+	_rbuf = _create_ring();
+	if (!_rbuf) {
+		return -1;
+	}
+	if (_spill_size && !_spill) {
+		/* The overflow policy outlives logger_close() */
+		_spill = rbuffer_init_rbuffer_mode(_spill_size, RBUFFER_MODE_MPSC);
+		if (!_spill) {
+			_destroy_rings();
+			return -1;
+		}
+	}
+
+	atomic_store(&_dropped_msgs, 0);
+	atomic_store(&_dropped_bytes, 0);
+	atomic_store(&_unreported_drops, 0);
+
+	_ts_base = logger_clock_ns();
+	_ts_sec = UINT64_MAX;
+
+	for (int i = 0; i < LOGGER_NR_LEVELS; i++) {
+		atomic_store(&_log_levels[i].counter, 0);
+		_level_bytes[i] = 0;
+	}
+	_render_ns = 0;
+	atomic_store(&_format_ns, 0);
+	for (int i = 0; adrivers[i] != NULL; i++) {
+		memset(&adrivers[i]->stats, 0, sizeof(adrivers[i]->stats));
+	}
+
+	logger_fmt_init_levels();
+
+	for (int i = 0; adrivers[i] != NULL; i++) {
+		if (adrivers[i]->enabled && adrivers[i]->ops) {
+			if (adrivers[i]->ops->init) {
+				int error = adrivers[i]->ops->init(
+						(void *)adrivers[i]);
+				if (error < 0) {
+					/* Undo what was set up, logger_close() won't be called */
+					_close_drivers(i);
+					_destroy_rings();
+					return -1;
+				}
+			}
+		}
+	}
+
+	/* Masks may be set in the driver definitions */
+	_drivers_loglvl_update();
+	_callsite_update_all();
+
+	return 0;
+}
+
+/**
+ * @brief  Smallest ring that holds two messages of a given maximum length
+ *
+ * A message is reserved at its maximum length and shrunk to its real length
+ * when it is committed, so the ring needs room for the longest reservation.
+ */
+static size_t _min_ring_size(size_t max_msg_len)
+{
+	return 2 * (sizeof(struct rbuffer_hdr_t) + sizeof(struct logger_record_t) +
+		    MAX_HDR_LEN + max_msg_len + 3);
+}
+
+int logger_init_ex(const struct logger_config_t *cfg)
+{
+	size_t max_msg_len = 0;
+
+	if (!cfg) {
+		return logger_init();
+	}
+
+	max_msg_len = cfg->max_msg_len ? cfg->max_msg_len : MAX_STR_LEN;
+	if (max_msg_len < LOGGER_MIN_MSG_LEN || max_msg_len > MAX_STR_LEN) {
+		return -1;
+	}
+	if ((!cfg->ring_mem && cfg->ring_size &&
+	     cfg->ring_size < _min_ring_size(max_msg_len)) ||
+	    (cfg->ring_mem && cfg->ring_size < rbuffer_mem_size(_min_ring_size(max_msg_len))) ||
+	    (cfg->thread_ring_size && cfg->thread_ring_size < _min_ring_size(max_msg_len))) {
+		return -1;
+	}
+
+	if (logger_set_ring_memory(cfg->ring_mem, cfg->ring_size, cfg->ring_flags) < 0 ||
+	    logger_set_overflow_policy(&cfg->overflow) < 0) {
+		return -1;
+	}
+	_max_msg_len = max_msg_len;
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	_tring_size = cfg->thread_ring_size ? cfg->thread_ring_size : CFG_RING_THREAD_SIZE;
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+	return logger_init();
+}
+
+int logger_get_loglvl()
+{
+	return _current_loglvl;
+}
+
+void logger_set_loglvl(int loglvl)
+{
+	LOG_INFO("Changing log level");
+	_current_loglvl = loglvl;
+	_callsite_update_all();
+}
+
+/**
+ * @brief  Format the message header ("[LEVEL] (file)(function @line) : ")
+ *
+ * @param str Output buffer of at least MAX_HDR_LEN bytes
+ * @param cs Callsite of the message
+ *
+ * @returns  Length of the header
+ */
+static size_t _format_header(char *str, const struct logger_callsite_t *cs)
+{
+	return logger_fmt_header(str, MAX_HDR_LEN, cs->lvl, _basename(cs->file),
+				 cs->fn, cs->ln);
+}
+
+/**
+ * @brief  Format a message body, vsnprintf(str, _max_msg_len, ...) semantics
+ *
+ * @returns  Length of the body
+ */
+static size_t _format_body(char *str, const char *fmt, va_list va)
+{
+	int len = logger_fmt_vformat(str, _max_msg_len, fmt, va);
+
+	if (len < 0) {
+		str[0] = '\0';
+		return 0;
+	}
+	return (size_t)len < _max_msg_len ? (size_t)len : _max_msg_len - 1;
+}
+
+static int _try_drain_all(void);
+static size_t _render_record(char *str, struct logger_record_t *rec, size_t len);
+
+/**
+ * @brief  Account dropped messages
+ *
+ * @param cs Callsite of the dropped message, NULL if unknown
+ * @param msgs Number of dropped messages
+ * @param bytes Output bytes of the dropped messages
+ */
+static void _account_drops(const struct logger_callsite_t *cs, unsigned msgs,
+			   size_t bytes)
+{
+	atomic_fetch_add_explicit(&_dropped_msgs, msgs, memory_order_relaxed);
+	atomic_fetch_add_explicit(&_dropped_bytes, bytes, memory_order_relaxed);
+	if (cs && cs->state) {
+		atomic_fetch_add_explicit(&cs->state->drops, msgs, memory_order_relaxed);
+	}
+}
+
+/**
+ * @brief  Estimate the length of the line a dropped message would have produced
+ *
+ * The body isn't formatted, a drop has to stay cheaper than a log call. The
+ * format string stands in for it.
+ *
+ * @param cs Callsite of the message
+ *
+ * @returns  Estimated length of the line (CRLF included)
+ */
+static size_t _line_len(const struct logger_callsite_t *cs)
+{
+	char hdr[MAX_HDR_LEN];
+	size_t body = strnlen(cs->fmt, _max_msg_len - 1);
+	size_t len = 0;
+
+	if (cs->lvl != LOG_LVL_RAW) {
+		len = _format_header(hdr, cs);
+	}
+
+	return len + body + 2;
+}
+
+/**
+ * @brief  Drop the oldest records of a ring until a new record fits
+ *
+ * Only possible when no other thread is draining the rings.
+ *
+ * @param rbuf Ring that is full
+ * @param size Size of the record that needs to fit
+ *
+ * @returns  NULL if failed, otherwise the reserved record
+ */
+static void *_overwrite_oldest(struct rbuffer_t *rbuf, size_t size)
+{
+	struct logger_record_t *old = NULL;
+	unsigned dropped = 0;
+	void *rec = NULL;
+	size_t len = 0;
+
+	if (!_flush_lock_take(false)) {
+		return NULL;
+	}
+
+	while (!rec && (old = rbuffer_get_read_pointer(rbuf, &len)) != NULL) {
+		char line[MAX_TS_LEN + MAX_LINE_LEN];
+		size_t bytes = (old->type == LOGGER_REC_TEXT) ?
+			       len - sizeof(struct logger_record_t) - 1 :
+			       _render_record(line, old, len);
+
+		dropped += old->dropped + 1;
+		_account_drops(old->cs, 1, bytes);
+		rbuffer_signal_element_read(rbuf);
+
+		rec = rbuffer_get_write_pointer(rbuf, size);
+	}
+
+	/* Report the drops in front of the oldest remaining message */
+	old = rbuffer_get_read_pointer(rbuf, NULL);
+	if (old) {
+		old->dropped += dropped;
+	} else {
+		atomic_fetch_add_explicit(&_unreported_drops, dropped,
+					  memory_order_relaxed);
+	}
+
+	_flush_lock_release();
+
+	return rec;
+}
+
+/**
+ * @brief  Wait until a record fits in a full ring
+ *
+ * @param rbuf Ring that is full
+ * @param size Size of the record that needs to fit
+ *
+ * @returns  NULL if timed out, otherwise the reserved record
+ */
+static void *_block(struct rbuffer_t *rbuf, size_t size)
+{
+	void *rec = NULL;
+
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	int timeout_ms = atomic_load_explicit(&_overflow_timeout_ms,
+					      memory_order_relaxed);
+	struct timespec start, now;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		if (atomic_load_explicit(&_async_enabled, memory_order_relaxed)) {
+			struct timespec ts = { 0, 100000 };
+
+			pthread_cond_signal(&_async_cond);
+			nanosleep(&ts, NULL);
+		} else if (_try_drain_all() < 0) {
+			/* Drained by another thread (or by us, from a driver) */
+			sched_yield();
+		}
+
+		rec = rbuffer_get_write_pointer(rbuf, size);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while (!rec && (now.tv_sec - start.tv_sec) * 1000LL +
+		 (now.tv_nsec - start.tv_nsec) / 1000000L < timeout_ms);
+#else
+	/* No clock, drain once and try again */
+	if (_try_drain_all() >= 0) {
+		rec = rbuffer_get_write_pointer(rbuf, size);
+	}
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+	return rec;
+}
+
+/**
+ * @brief  Reserve a record, applying the overflow policy when the ring is full
+ *
+ * @param rbuf Ring of the producer, updated when the record ends up elsewhere
+ * @param size Size of the record
+ *
+ * @returns  NULL if the message has to be dropped, otherwise the record
+ */
+static void *_reserve(struct rbuffer_t **rbuf, size_t size)
+{
+	int mode = atomic_load_explicit(&_overflow_mode, memory_order_relaxed);
+	void *rec = NULL;
+
+	if (mode == LOGGER_OVERFLOW_SPILL && _spill && rbuffer_get_used(_spill)) {
+		/* Keep the order, until the spill ring is drained */
+		*rbuf = _spill;
+		return rbuffer_get_write_pointer(_spill, size);
+	}
+
+	rec = rbuffer_get_write_pointer(*rbuf, size);
+	if (rec) {
+		return rec;
+	}
+
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	/* Full, kick the drainer (if any) */
+	pthread_cond_signal(&_async_cond);
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+	switch (mode) {
+	case LOGGER_OVERFLOW_OVERWRITE_OLDEST:
+		rec = _overwrite_oldest(*rbuf, size);
+		break;
+	case LOGGER_OVERFLOW_BLOCK:
+		rec = _block(*rbuf, size);
+		break;
+	case LOGGER_OVERFLOW_SPILL:
+		if (_spill) {
+			*rbuf = _spill;
+			rec = rbuffer_get_write_pointer(_spill, size);
+		}
+		break;
+	default:
+		break;
+	}
+
+	return rec;
+}
+
+/**
+ * @brief  Count a message that was stored in the ring
+ *
+ * @param lvl Log level of the message
+ * @param state Runtime state of the callsite, NULL if none
+ */
+static void _count_msg(int lvl, struct logger_callsite_state_t *state)
+{
+	atomic_fetch_add_explicit(&_log_levels[logger_mask2id(lvl)].counter, 1,
+				  memory_order_relaxed);
+	if (state) {
+		atomic_fetch_add_explicit(&state->hits, 1, memory_order_relaxed);
+	}
+
+#ifdef UNIT_TEST
+	logger_flush();
+#endif
+}
+
+/**
+ * @brief  Store a message in the ring
+ *
+ * @param cs Callsite of the message
+ * @param is_static The callsite is static, the record may refer to it
+ * @param va Arguments for cs->fmt
+ */
+static void _log(const struct logger_callsite_t *cs, bool is_static, va_list va)
+{
+	struct logger_record_t *rec = NULL;
+	struct rbuffer_t *rbuf = NULL;
+	uint64_t ts = logger_clock_ns();
+	size_t len = 0;
+	bool defer = is_static;
+
+#if !defined(CFG_LOGGER_DEFERRED_FMT)
+	defer = false;
+#endif /* CFG_LOGGER_DEFERRED_FMT */
+	size_t max = defer ? _max_msg_len : MAX_HDR_LEN + _max_msg_len + 3;
+
+	rbuf = _producer_ring();
+	rec = _reserve(&rbuf, sizeof(struct logger_record_t) + max);
+	if (!rec) {
+		_account_drops(cs, 1, _line_len(cs));
+		atomic_fetch_add_explicit(&_unreported_drops, 1, memory_order_relaxed);
+		return;
+	}
+
+	rec->lvl = cs->lvl;
+	rec->cs = is_static ? cs : NULL;
+	rec->ts = ts;
+	rec->hdr_len = 0;
+	rec->dropped = 0;
+	if (atomic_load_explicit(&_unreported_drops, memory_order_relaxed)) {
+		/* This message reports the drops that happened before it */
+		rec->dropped = atomic_exchange_explicit(&_unreported_drops, 0,
+							memory_order_relaxed);
+	}
+
+	bool timed = _stats_sample();
+	uint64_t start = timed ? _stats_now() : 0;
+
+	if (defer) {
+		va_list cp;
+
+		va_copy(cp, va);
+		int packed = logger_deferred_pack(cs->fmt, rec->data, _max_msg_len, cp);
+		va_end(cp);
+
+		if (packed >= 0) {
+			rec->type = LOGGER_REC_PACKED;
+			len = packed;
+		} else {
+			/* Can't be deferred, format the body right away */
+			len = _format_body(rec->data, cs->fmt, va) + 1;
+			rec->type = LOGGER_REC_BODY;
+		}
+	} else {
+		if (cs->lvl != LOG_LVL_RAW) {
+			len = _format_header(rec->data, cs);
+		}
+		rec->hdr_len = len;
+		len += _format_body(&rec->data[len], cs->fmt, va);
+
+		memcpy(&rec->data[len], "\r\n", 3);
+		len += 3;
+		rec->type = LOGGER_REC_TEXT;
+	}
+
+	if (timed) {
+		atomic_fetch_add_explicit(&_format_ns,
+					  (_stats_now() - start) * CFG_LOGGER_STATS_SAMPLE,
+					  memory_order_relaxed);
+	}
+
+	rbuffer_signal_element_written(rbuf, rec, sizeof(struct logger_record_t) + len);
+	_count_msg(cs->lvl, cs->state);
+}
+
+void logger_log_cs(const struct logger_callsite_t *cs, ...)
+{
+	va_list va;
+
+	if (cs->state ? !LOGGER_CALLSITE_ACTIVE(cs->lvl, *cs->state) :
+	    !(cs->lvl & _current_loglvl & _drivers_loglvl)) {
+		return;
+	}
+
+	va_start(va, cs);
+	_log(cs, true, va);
+	va_end(va);
+}
+
+void logger_log(const int lvl, const char *file, const char *fn, const int ln,
+		char *fmt, ...)
+{
+	va_list va;
+	const struct logger_callsite_t cs = {
+		.lvl	= lvl,
+		.ln	= ln,
+		.file	= file,
+		.fn	= fn,
+		.fmt	= fmt,
+	};
+
+	if (!(lvl & _current_loglvl & _drivers_loglvl)) {
+		return;
+	}
+
+	/* The callsite only lives on the stack, format right away */
+	va_start(va, fmt);
+	_log(&cs, false, va);
+	va_end(va);
+}
+
+/**
+ * @brief  Estimate the length of the line a dropped structured message would have produced
+ *
+ * Like _line_len(), the fields count with their key and separators only.
+ *
+ * @param cs Callsite of the message
+ * @param kv Fields
+ * @param cnt Number of fields
+ *
+ * @returns  Estimated length of the line (CRLF included)
+ */
+static size_t _kv_line_len(const struct logger_callsite_t *cs,
+			   const struct logger_kv_t *kv, int cnt)
+{
+	size_t len = _line_len(cs);
+
+	for (int i = 0; i < cnt; i++) {
+		len += strlen(kv[i].key) + 2;
+	}
+
+	return len;
+}
+
+void logger_log_kv(const struct logger_callsite_t *cs,
+		   const struct logger_kv_t *kv, int cnt)
+{
+	struct logger_record_t *rec = NULL;
+	struct rbuffer_t *rbuf = NULL;
+	uint64_t ts = logger_clock_ns();
+
+	if (cs->state ? !LOGGER_CALLSITE_ACTIVE(cs->lvl, *cs->state) :
+	    !(cs->lvl & _current_loglvl & _drivers_loglvl)) {
+		return;
+	}
+
+	rbuf = _producer_ring();
+	rec = _reserve(&rbuf, sizeof(struct logger_record_t) + _max_msg_len);
+	if (!rec) {
+		_account_drops(cs, 1, _kv_line_len(cs, kv, cnt));
+		atomic_fetch_add_explicit(&_unreported_drops, 1, memory_order_relaxed);
+		return;
+	}
+
+	rec->lvl = cs->lvl;
+	rec->type = LOGGER_REC_KV;
+	rec->cs = cs;
+	rec->ts = ts;
+	rec->hdr_len = 0;
+	rec->dropped = 0;
+	if (atomic_load_explicit(&_unreported_drops, memory_order_relaxed)) {
+		/* This message reports the drops that happened before it */
+		rec->dropped = atomic_exchange_explicit(&_unreported_drops, 0,
+							memory_order_relaxed);
+	}
+
+	size_t len = logger_kv_pack(rec->data, _max_msg_len, kv, cnt);
+
+	rbuffer_signal_element_written(rbuf, rec, sizeof(struct logger_record_t) + len);
+	_count_msg(cs->lvl, cs->state);
+}
+
+/**
+ * @brief  Record handed out by logger_reserve(), waiting for logger_commit()
+ */
+struct logger_pending_t {
+	struct rbuffer_t *			rbuf;   //!< Ring holding the record
+	struct logger_record_t *		rec;    //!< The record, NULL if none
+	struct logger_callsite_state_t *	state;  //!< Callsite state, NULL if none
+	size_t					max;    //!< Reserved body length
+};
+
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+static _Thread_local struct logger_pending_t _pending;
+#else
+static struct logger_pending_t _pending;
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+/**
+ * @brief  Reserve a record for a body of len bytes
+ *
+ * @param cs Callsite of the message
+ * @param is_static The callsite is static, the header is added during flush
+ * @param len Maximum body length
+ *
+ * @returns  NULL if failed, otherwise the body of the record
+ */
+static char *_reserve_body(const struct logger_callsite_t *cs, bool is_static,
+			   size_t len)
+{
+	struct logger_record_t *rec = NULL;
+	struct rbuffer_t *rbuf = NULL;
+	uint64_t ts = logger_clock_ns();
+	size_t hdr_len = 0;
+
+	if (_pending.rec || len >= _max_msg_len) {
+		/* One reservation per thread, the body has to fit a message */
+		return NULL;
+	}
+
+	size_t max = is_static ? len + 1 : MAX_HDR_LEN + len + 3;
+
+	rbuf = _producer_ring();
+	rec = _reserve(&rbuf, sizeof(struct logger_record_t) + max);
+	if (!rec) {
+		char hdr[MAX_HDR_LEN];
+
+		hdr_len = cs->lvl != LOG_LVL_RAW ? _format_header(hdr, cs) : 0;
+		_account_drops(cs, 1, hdr_len + len + 2);
+		atomic_fetch_add_explicit(&_unreported_drops, 1, memory_order_relaxed);
+		return NULL;
+	}
+
+	rec->lvl = cs->lvl;
+	rec->cs = is_static ? cs : NULL;
+	rec->ts = ts;
+	rec->dropped = 0;
+	if (atomic_load_explicit(&_unreported_drops, memory_order_relaxed)) {
+		/* This message reports the drops that happened before it */
+		rec->dropped = atomic_exchange_explicit(&_unreported_drops, 0,
+							memory_order_relaxed);
+	}
+
+	if (is_static) {
+		rec->type = LOGGER_REC_BODY;
+	} else {
+		if (cs->lvl != LOG_LVL_RAW) {
+			hdr_len = _format_header(rec->data, cs);
+		}
+		rec->type = LOGGER_REC_TEXT;
+	}
+	rec->hdr_len = hdr_len;
+
+	_pending.rbuf = rbuf;
+	_pending.rec = rec;
+	_pending.state = is_static ? cs->state : NULL;
+	_pending.max = len;
+
+	return &rec->data[hdr_len];
+}
+
+char *logger_reserve_cs(const struct logger_callsite_t *cs, size_t len)
+{
+	if (cs->state ? !LOGGER_CALLSITE_ACTIVE(cs->lvl, *cs->state) :
+	    !(cs->lvl & _current_loglvl & _drivers_loglvl)) {
+		return NULL;
+	}
+
+	return _reserve_body(cs, true, len);
+}
+
+char *logger_reserve_at(const int lvl, const char *file, const char *fn,
+			const int ln, size_t len)
+{
+	const struct logger_callsite_t cs = {
+		.lvl	= lvl,
+		.ln	= ln,
+		.file	= file,
+		.fn	= fn,
+		.fmt	= "%s",
+	};
+
+	if (!(lvl & _current_loglvl & _drivers_loglvl)) {
+		return NULL;
+	}
+
+	/* The callsite only lives on the stack, the header goes in right away */
+	return _reserve_body(&cs, false, len);
+}
+
+int logger_commit(size_t len)
+{
+	struct logger_record_t *rec = _pending.rec;
+
+	if (!rec) {
+		return -1;
+	}
+
+	if (len > _pending.max) {
+		len = _pending.max;
+	}
+
+	len += rec->hdr_len;
+	if (rec->type == LOGGER_REC_TEXT) {
+		memcpy(&rec->data[len], "\r\n", 3);
+		len += 3;
+	} else {
+		rec->data[len++] = '\0';
+	}
+
+	/* The record may be drained as soon as it is written */
+	int lvl = rec->lvl;
+
+	_pending.rec = NULL;
+	rbuffer_signal_element_written(_pending.rbuf, rec,
+				       sizeof(struct logger_record_t) + len);
+	_count_msg(lvl, _pending.state);
+
+	return 0;
+}
+
+/**
+ * @brief  Get the levels wanted by the enabled drivers
+ *
+ * @param text Will hold the levels wanted as text, by drivers without a
+ *             write_entries callback
+ *
+ * @returns  Levels wanted by any enabled driver
+ */
+static int _enabled_loglvl(int *text)
+{
+	int loglvl = LOG_LVL_NONE;
+
+	*text = LOG_LVL_NONE;
+	for (int i = 0; adrivers[i] != NULL; i++) {
+		if (!adrivers[i]->enabled || !adrivers[i]->ops) {
+			continue;
+		}
+		loglvl |= _driver_loglvl(adrivers[i]);
+		if (!adrivers[i]->ops->write_entries) {
+			*text |= _driver_loglvl(adrivers[i]);
+		}
+	}
+	return loglvl;
+}
+
+/**
+ * @brief  Write a batch of messages to all enabled drivers
+ *
+ * Drivers with a write_entries callback get the unrendered messages, drivers
+ * without a writev callback get every message separately. A driver that
+ * doesn't take every level of the batch gets a copy holding its levels only.
+ *
+ * @param iov Messages that will be written
+ * @param iov_lvl Level of every message in iov
+ * @param cnt Number of messages
+ * @param ent Unrendered messages
+ * @param nr_ent Number of unrendered messages
+ * @param loglvl Levels in the batch
+ */
+static void _write_drivers(const struct logger_iovec_t *iov, const int *iov_lvl,
+			   int cnt, const struct logger_entry_t *ent, int nr_ent,
+			   int loglvl)
+{
+	for (int i = 0; adrivers[i] != NULL; i++) {
+		const struct logger_iovec_t *drv_iov = iov;
+		const struct logger_entry_t *drv_ent = ent;
+		int drv_cnt = cnt;
+		int drv_nr_ent = nr_ent;
+		int drv_lvl = _driver_loglvl(adrivers[i]);
+
+		if (!adrivers[i]->enabled || !adrivers[i]->ops ||
+		    !(loglvl & drv_lvl)) {
+			continue;
+		}
+
+		if (loglvl & ~drv_lvl) {
+			drv_cnt = 0;
+			drv_nr_ent = 0;
+			for (int j = 0; j < cnt; j++) {
+				if (iov_lvl[j] & drv_lvl) {
+					_batch_sel[drv_cnt++] = iov[j];
+				}
+			}
+			for (int j = 0; j < nr_ent; j++) {
+				if (ent[j].lvl & drv_lvl) {
+					_entries_sel[drv_nr_ent++] = ent[j];
+				}
+			}
+			drv_iov = _batch_sel;
+			drv_ent = _entries_sel;
+		}
+
+		/* Nothing of the levels of this driver in its form */
+		if (adrivers[i]->ops->write_entries ? !drv_nr_ent : !drv_cnt) {
+			continue;
+		}
+
+		uint64_t start = _stats_now();
+
+		if (adrivers[i]->ops->write_entries) {
+			adrivers[i]->ops->write_entries((void *)adrivers[i], drv_ent,
+							drv_nr_ent);
+		} else if (adrivers[i]->ops->writev) {
+			adrivers[i]->ops->writev((void *)adrivers[i], drv_iov, drv_cnt);
+		} else {
+			for (int j = 0; j < drv_cnt && adrivers[i]->ops->write; j++) {
+				adrivers[i]->ops->write((void *)adrivers[i],
+							(char *)drv_iov[j].base);
+			}
+		}
+
+		_hist_add(&adrivers[i]->stats.write, _stats_now() - start);
+	}
+}
+
+/**
+ * @brief  Flush all enabled drivers, caller holds the flush lock
+ */
+static void _flush_drivers(void)
+{
+	for (int i = 0; adrivers[i] != NULL; i++) {
+		if (adrivers[i]->enabled && adrivers[i]->ops &&
+		    adrivers[i]->ops->flush) {
+			uint64_t start = _stats_now();
+
+			adrivers[i]->ops->flush((void *)adrivers[i]);
+			_hist_add(&adrivers[i]->stats.flush, _stats_now() - start);
+		}
+	}
+
+	_pending_bytes = 0;
+	_pending_msgs = 0;
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	clock_gettime(CLOCK_MONOTONIC, &_last_flush);
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+}
+
+/**
+ * @brief  Check if the flush interval of the policy has passed
+ */
+static bool _flush_interval_passed(void)
+{
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	struct timespec now;
+
+	if (!_flush_policy.interval_ms) {
+		return false;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long long ms = (now.tv_sec - _last_flush.tv_sec) * 1000LL +
+		       (now.tv_nsec - _last_flush.tv_nsec) / 1000000L;
+
+	return ms >= _flush_policy.interval_ms;
+#else
+	return false;
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+}
+
+/**
+ * @brief  Account a written batch and flush the drivers if the policy says so
+ *
+ * @param bytes Number of bytes in the batch
+ * @param cnt Number of messages in the batch
+ * @param error The batch holds an ERROR message
+ */
+static void _flush_check(size_t bytes, int cnt, bool error)
+{
+	_pending_bytes += bytes;
+	_pending_msgs += cnt;
+
+	if (!_pending_msgs) {
+		return;
+	}
+
+	if ((error && _flush_policy.on_error) ||
+	    (_flush_policy.bytes && _pending_bytes >= _flush_policy.bytes) ||
+	    (_flush_policy.msgs && _pending_msgs >= _flush_policy.msgs) ||
+	    _flush_interval_passed()) {
+		_flush_drivers();
+	}
+}
+
+/**
+ * @brief  Write "YYYY-MM-DDTHH:MM:SS" of a UTC time
+ *
+ * @param str Output buffer of at least 20 bytes
+ * @param sec Seconds since the epoch
+ */
+static void _format_date(char *str, uint64_t sec)
+{
+	/* Days to civil date, proleptic Gregorian calendar */
+	uint64_t z = sec / 86400 + 719468;
+	uint64_t era = z / 146097;
+	unsigned doe = z - era * 146097;
+	unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	unsigned mp = (5 * doy + 2) / 153;
+	unsigned day = doy - (153 * mp + 2) / 5 + 1;
+	unsigned month = mp < 10 ? mp + 3 : mp - 9;
+	unsigned year = yoe + era * 400 + (month <= 2);
+	unsigned tod = sec % 86400;
+
+	logger_fmt_format(str, 20, "%04u-%02u-%02uT%02u:%02u:%02u", year, month,
+			  day, tod / 3600, tod / 60 % 60, tod % 60);
+}
+
+/**
+ * @brief  Render the time stamp of a message in the current format
+ *
+ * @param str Output buffer of at least MAX_TS_LEN bytes
+ * @param ts Time stamp, logger_clock_ns()
+ *
+ * @returns  Length of the time stamp (NUL excluded), 0 for LOGGER_TS_NONE
+ */
+static size_t _render_ts(char *str, uint64_t ts)
+{
+	uint64_t us = 0;
+	int len = 0;
+
+	switch (atomic_load_explicit(&_ts_format, memory_order_relaxed)) {
+	case LOGGER_TS_UPTIME:
+		us = (ts > _ts_base ? ts - _ts_base : 0) / 1000;
+		len = logger_fmt_format(str, MAX_TS_LEN, "[%5llu.%06u] ",
+					(unsigned long long)(us / 1000000),
+					(unsigned)(us % 1000000));
+		break;
+	case LOGGER_TS_EPOCH:
+		us = (ts + _ts_realtime) / 1000;
+		len = logger_fmt_format(str, MAX_TS_LEN, "%llu.%06u ",
+					(unsigned long long)(us / 1000000),
+					(unsigned)(us % 1000000));
+		break;
+	case LOGGER_TS_UTC:
+		us = (ts + _ts_realtime) / 1000;
+		if (us / 1000000 != _ts_sec) {
+			/* Only redone once per second */
+			_ts_sec = us / 1000000;
+			_format_date(_ts_date, _ts_sec);
+		}
+		len = logger_fmt_format(str, MAX_TS_LEN, "%s.%06uZ ", _ts_date,
+					(unsigned)(us % 1000000));
+		break;
+	default:
+		str[0] = '\0';
+		break;
+	}
+
+	return len < MAX_TS_LEN ? (size_t)len : MAX_TS_LEN - 1;
+}
+
+/**
+ * @brief  Take the offset between logger_clock_ns() and the epoch
+ *
+ * Done once per drain, so the wall clock time of the messages follows
+ * adjustments of the system clock.
+ */
+static void _ts_sync(void)
+{
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	int fmt = atomic_load_explicit(&_ts_format, memory_order_relaxed);
+	struct timespec now;
+
+	if (fmt != LOGGER_TS_EPOCH && fmt != LOGGER_TS_UTC) {
+		return;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	_ts_realtime = (int64_t)((uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec) -
+		       (int64_t)logger_clock_ns();
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+}
+
+/**
+ * @brief  Check if a record gets a time stamp
+ */
+static inline bool _has_ts(const struct logger_record_t *rec)
+{
+	return rec->lvl != LOG_LVL_RAW &&
+	       atomic_load_explicit(&_ts_format, memory_order_relaxed) != LOGGER_TS_NONE;
+}
+
+/**
+ * @brief  Render a structured record in the current layout
+ *
+ * @param str Output buffer of at least MAX_TS_LEN + MAX_LINE_LEN bytes
+ * @param rec Record that will be rendered
+ * @param len Payload length of the record
+ *
+ * @returns  Length of the line (NUL excluded)
+ */
+static size_t _render_kv(char *str, struct logger_record_t *rec, size_t len)
+{
+	char ts[MAX_TS_LEN];
+	struct logger_kv_line_t line = {
+		.time	= NULL,
+		.lvl	= rec->lvl,
+		.file	= _basename(rec->cs->file),
+		.fn	= rec->cs->fn,
+		.ln	= rec->cs->ln,
+		.msg	= rec->cs->fmt,
+	};
+
+	if (rec->lvl != LOG_LVL_RAW && _render_ts(ts, rec->ts)) {
+		line.time = ts;
+	}
+
+	/* Room for the CRLF */
+	size_t pos = logger_kv_render(str, MAX_TS_LEN + MAX_LINE_LEN - 2,
+				      atomic_load_explicit(&_kv_format, memory_order_relaxed),
+				      &line, rec->data, len - sizeof(struct logger_record_t));
+	memcpy(&str[pos], "\r\n", 3);
+
+	return pos + 2;
+}
+
+/**
+ * @brief  Render a BODY or PACKED record
+ *
+ * @param str Output buffer of at least MAX_TS_LEN + MAX_LINE_LEN bytes
+ * @param rec Record that will be rendered
+ * @param len Payload length of the record
+ *
+ * @returns  Length of the line (NUL excluded)
+ */
+static size_t _render_record(char *str, struct logger_record_t *rec, size_t len)
+{
+	size_t pos = 0;
+
+	if (rec->type == LOGGER_REC_KV) {
+		return _render_kv(str, rec, len);
+	}
+
+	if (rec->lvl != LOG_LVL_RAW) {
+		pos = _render_ts(str, rec->ts);
+		pos += _format_header(&str[pos], rec->cs);
+	}
+
+	if (rec->type == LOGGER_REC_PACKED) {
+		pos += logger_deferred_render(&str[pos], _max_msg_len,
+					      rec->cs->fmt, rec->data,
+					      len - sizeof(struct logger_record_t));
+	} else {
+		size_t body = strnlen(rec->data, _max_msg_len - 1);
+		memcpy(&str[pos], rec->data, body);
+		pos += body;
+	}
+
+	memcpy(&str[pos], "\r\n", 3);
+
+	return pos + 2;
+}
+
+/**
+ * @brief  Render the "messages dropped" marker
+ *
+ * @param str Output buffer of at least MAX_TS_LEN + MAX_LINE_LEN bytes
+ * @param dropped Number of dropped messages
+ * @param ts Time stamp of the message that reports the drops
+ *
+ * @returns  Length of the line (NUL excluded)
+ */
+static size_t _render_drops(char *str, unsigned dropped, uint64_t ts)
+{
+	size_t pos = _render_ts(str, ts);
+
+	pos += _format_header(&str[pos], &_drop_cs);
+
+	pos += logger_fmt_format(&str[pos], MAX_STR_LEN, _drop_cs.fmt, dropped);
+	memcpy(&str[pos], "\r\n", 3);
+
+	return pos + 2;
+}
+
+/**
+ * @brief  Describe a record as an unrendered entry
+ *
+ * @param ent Entry that will be filled in
+ * @param rec Record
+ * @param len Payload length of the record
+ */
+static void _record_entry(struct logger_entry_t *ent, struct logger_record_t *rec,
+			  size_t len)
+{
+	size_t payload = len - sizeof(struct logger_record_t);
+
+	ent->cs = rec->cs;
+	ent->ts = rec->ts;
+	ent->lvl = rec->lvl;
+
+	switch (rec->type) {
+	case LOGGER_REC_PACKED:
+		ent->type = LOGGER_ENTRY_ARGS;
+		ent->data = rec->data;
+		ent->len = payload;
+		break;
+	case LOGGER_REC_KV:
+		ent->type = LOGGER_ENTRY_KV;
+		ent->data = rec->data;
+		ent->len = payload;
+		break;
+	case LOGGER_REC_BODY:
+		ent->type = LOGGER_ENTRY_BODY;
+		ent->data = rec->data;
+		ent->len = strnlen(rec->data, payload);
+		break;
+	default:
+		/* Complete line, CRLF and NUL stripped */
+		ent->type = rec->cs ? LOGGER_ENTRY_BODY : LOGGER_ENTRY_LINE;
+		ent->data = rec->cs ? &rec->data[rec->hdr_len] : rec->data;
+		ent->len = payload - 3 - (rec->cs ? rec->hdr_len : 0);
+		break;
+	}
+}
+
+/**
+ * @brief  Write all records of a ring to the drivers
+ *
+ * Records are collected in batches of up to CFG_LOGGER_BATCH_NR messages.
+ * TEXT records are handed to the drivers straight from the ring, they are
+ * only released once the whole batch was written. Nothing is rendered when
+ * all drivers take unrendered entries.
+ *
+ * @param rbuf Ring that will be drained, caller holds the flush lock
+ *
+ * @returns  Number of records written
+ */
+static int _drain_ring(struct rbuffer_t *rbuf)
+{
+	struct logger_record_t *rec = NULL;
+	int text_lvl = LOG_LVL_NONE;
+	int wanted = _enabled_loglvl(&text_lvl);
+	bool drops_text = _drop_cs.lvl & text_lvl;
+	size_t len = 0;
+	int count = 0;
+
+	do {
+		size_t used = 0;
+		size_t bytes = 0;
+		bool error = false;
+		int loglvl = LOG_LVL_NONE;
+		int nr_iov = 0;
+		int nr_ent = 0;
+		int cnt = 0;
+		uint64_t start = _stats_now();
+
+		rec = NULL;
+		while (nr_iov < CFG_LOGGER_BATCH_NR && nr_ent < CFG_LOGGER_BATCH_NR) {
+			struct logger_record_t *next =
+				rbuffer_get_next_read_pointer(rbuf, rec, &len);
+			struct logger_entry_t *ent = NULL;
+			bool ts_span = false;
+			bool text = false;
+			bool drops = false;
+			size_t need = 0;
+			int spans = 1;
+
+			if (!next) {
+				break;
+			}
+
+			/* Only rendered for the drivers that take its level */
+			text = next->lvl & text_lvl;
+			drops = next->dropped && (_drop_cs.lvl & wanted);
+
+			/* A TEXT record gets its time stamp as a separate span */
+			ts_span = text && next->type == LOGGER_REC_TEXT && _has_ts(next);
+			spans += (drops ? 1 : 0) + (ts_span ? 1 : 0);
+			need += drops ? MAX_DROPS_LEN : 0;
+			need += drops && drops_text ? MAX_TS_LEN + MAX_LINE_LEN : 0;
+			need += text && next->type != LOGGER_REC_TEXT ? MAX_TS_LEN + MAX_LINE_LEN : 0;
+			need += ts_span ? MAX_TS_LEN : 0;
+			if (nr_iov + spans > CFG_LOGGER_BATCH_NR ||
+			    nr_ent + spans > CFG_LOGGER_BATCH_NR ||
+			    used + need > CFG_LOGGER_RENDER_SIZE) {
+				/* Batch or scratch space is full, write this batch first */
+				break;
+			}
+
+			size_t rec_bytes = bytes;
+
+			if (drops) {
+				ent = &_entries[nr_ent++];
+				ent->cs = &_drop_cs;
+				ent->ts = next->ts;
+				ent->lvl = _drop_cs.lvl;
+				ent->type = LOGGER_ENTRY_BODY;
+				ent->data = &_render_buf[used];
+				ent->len = logger_fmt_format(&_render_buf[used], MAX_DROPS_LEN,
+							     _drop_cs.fmt, next->dropped);
+				used += ent->len + 1;
+				bytes += drops_text ? 0 : ent->len;
+				loglvl |= _drop_cs.lvl;
+			}
+
+			if (drops && drops_text) {
+				_batch[nr_iov].base = &_render_buf[used];
+				_batch[nr_iov].len = _render_drops(&_render_buf[used],
+								   next->dropped, next->ts);
+				used += _batch[nr_iov].len + 1;
+				_batch_lvl[nr_iov] = _drop_cs.lvl;
+				bytes += _batch[nr_iov++].len;
+			}
+
+			if (drops) {
+				_level_bytes[logger_mask2id(_drop_cs.lvl)] += bytes - rec_bytes;
+				rec_bytes = bytes;
+			}
+
+			if (!(next->lvl & wanted)) {
+				/* No enabled driver takes this level, release it unrendered */
+				rec = next;
+				cnt++;
+				continue;
+			}
+
+			if (ts_span) {
+				_batch[nr_iov].base = &_render_buf[used];
+				_batch[nr_iov].len = _render_ts(&_render_buf[used], next->ts);
+				used += _batch[nr_iov].len + 1;
+				_batch_lvl[nr_iov] = next->lvl;
+				bytes += _batch[nr_iov++].len;
+			}
+
+			ent = &_entries[nr_ent++];
+			_record_entry(ent, next, len);
+			if (!text) {
+				bytes += ent->len;
+			} else if (next->type == LOGGER_REC_TEXT) {
+				_batch[nr_iov].base = next->data;
+				_batch[nr_iov].len = len - sizeof(struct logger_record_t) - 1;
+				_batch_lvl[nr_iov] = next->lvl;
+				bytes += _batch[nr_iov++].len;
+			} else {
+				_batch[nr_iov].base = &_render_buf[used];
+				_batch[nr_iov].len = _render_record(&_render_buf[used],
+								    next, len);
+				used += _batch[nr_iov].len + 1;
+				_batch_lvl[nr_iov] = next->lvl;
+				bytes += _batch[nr_iov++].len;
+			}
+			_level_bytes[logger_mask2id(next->lvl)] += bytes - rec_bytes;
+			error |= next->lvl == LOG_LVL_ERROR;
+			loglvl |= next->lvl;
+			rec = next;
+			cnt++;
+		}
+
+		_render_ns += _stats_now() - start;
+		if (!cnt) {
+			break;
+		}
+
+		if (loglvl) {
+			_write_drivers(_batch, _batch_lvl, nr_iov, _entries, nr_ent,
+				       loglvl);
+		}
+		for (int i = 0; i < cnt; i++) {
+			rbuffer_signal_element_read(rbuf);
+		}
+		_flush_check(bytes, nr_ent, error);
+		count += cnt;
+	} while (rec);
+
+	return count;
+}
+
+/**
+ * @brief  Drain the shared ring, the spill ring and all thread rings
+ *
+ * @param force Flush the drivers regardless of the flush policy
+ *
+ * @returns  Number of records written
+ */
+static int _drain_locked(bool force)
+{
+	int count = 0;
+
+	_ts_sync();
+
+	if (_rbuf) {
+		count += _drain_ring(_rbuf);
+	}
+	if (_spill) {
+		count += _drain_ring(_spill);
+	}
+
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	pthread_mutex_lock(&_async_lock);
+	for (struct logger_tring_t **it = &_trings; *it;) {
+		struct logger_tring_t *tring = *it;
+		bool orphaned = atomic_load_explicit(&tring->state,
+						     memory_order_acquire) == TRING_ORPHANED;
+
+		count += _drain_ring(tring->rbuf);
+		if (orphaned) {
+			/* Owner is gone and everything it wrote was drained */
+			*it = tring->next;
+			rbuffer_destroy_rbuffer(tring->rbuf);
+			free(tring);
+		} else {
+			it = &tring->next;
+		}
+	}
+	pthread_mutex_unlock(&_async_lock);
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+	bool per_drain = !_flush_policy.bytes && !_flush_policy.msgs &&
+			 !_flush_policy.interval_ms;
+	if (_pending_msgs && (force || per_drain)) {
+		_flush_drivers();
+	} else {
+		/* Nothing new, the interval may have passed nonetheless */
+		_flush_check(0, 0, false);
+	}
+
+	return count;
+}
+
+/**
+ * @brief  Drain all rings, waiting for other threads draining them
+ *
+ * @param force Flush the drivers regardless of the flush policy
+ *
+ * @returns  Number of records written
+ */
+static int _drain_all(bool force)
+{
+	int count = 0;
+
+	if (!_flush_lock_take(true)) {
+		/* Called from a driver, the ongoing drain picks up the rest */
+		return 0;
+	}
+	count = _drain_locked(force);
+	_flush_lock_release();
+
+	return count;
+}
+
+/**
+ * @brief  Drain all rings, unless another thread is draining them
+ *
+ * @returns  -1 if the rings are being drained, otherwise the number of records
+ */
+static int _try_drain_all(void)
+{
+	int count = 0;
+
+	if (!_flush_lock_take(false)) {
+		return -1;
+	}
+	count = _drain_locked(false);
+	_flush_lock_release();
+
+	return count;
+}
+
+void logger_flush()
+{
+	_drain_all(false);
+}
+
+int logger_set_flush_policy(const struct logger_flush_policy_t *policy)
+{
+	if (!policy || policy->msgs < 0 || policy->interval_ms < 0) {
+		return -1;
+	}
+
+	bool locked = _flush_lock_take(true);
+
+	_flush_policy = *policy;
+	if (locked) {
+		_flush_lock_release();
+	}
+
+	return 0;
+}
+
+void logger_get_flush_policy(struct logger_flush_policy_t *policy)
+{
+	if (policy) {
+		*policy = _flush_policy;
+	}
+}
+
+int logger_set_overflow_policy(const struct logger_overflow_policy_t *policy)
+{
+	if (!policy || policy->mode < LOGGER_OVERFLOW_DROP_NEWEST ||
+	    policy->mode > LOGGER_OVERFLOW_SPILL || policy->timeout_ms < 0) {
+		return -1;
+	}
+
+	if (policy->mode == LOGGER_OVERFLOW_SPILL && !_spill) {
+		size_t size = policy->spill_size ? policy->spill_size : CFG_RING_SPILL_SIZE;
+
+		_spill = rbuffer_init_rbuffer_mode(size, RBUFFER_MODE_MPSC);
+		if (!_spill) {
+			return -1;
+		}
+	}
+	/* Re-created by logger_init() after logger_close() */
+	_spill_size = policy->mode == LOGGER_OVERFLOW_SPILL ? rbuffer_get_size(_spill) : 0;
+
+	atomic_store(&_overflow_timeout_ms, policy->timeout_ms);
+	atomic_store(&_overflow_mode, policy->mode);
+
+	return 0;
+}
+
+void logger_get_drops(struct logger_drops_t *drops)
+{
+	if (drops) {
+		drops->msgs = atomic_load(&_dropped_msgs);
+		drops->bytes = atomic_load(&_dropped_bytes);
+	}
+}
+
+/**
+ * @brief  Describe the occupancy of a ring
+ */
+static void _ring_stats(struct logger_ring_stats_t *stats, struct rbuffer_t *rbuf)
+{
+	stats->size = rbuffer_get_size(rbuf);
+	stats->used = rbuffer_get_used(rbuf);
+	stats->peak = rbuffer_get_peak(rbuf);
+}
+
+void logger_get_stats(struct logger_stats_t *stats)
+{
+	if (!stats) {
+		return;
+	}
+
+	memset(stats, 0, sizeof(struct logger_stats_t));
+	for (int i = 0; i < LOGGER_NR_LEVELS; i++) {
+		stats->levels[i].msgs = atomic_load_explicit(&_log_levels[i].counter,
+							     memory_order_relaxed);
+	}
+	logger_get_drops(&stats->drops);
+	stats->format_ns = atomic_load_explicit(&_format_ns, memory_order_relaxed);
+
+	bool locked = _flush_lock_take(true);
+
+	for (int i = 0; i < LOGGER_NR_LEVELS; i++) {
+		stats->levels[i].bytes = _level_bytes[i];
+	}
+	stats->render_ns = _render_ns;
+	_ring_stats(&stats->ring, _rbuf);
+	_ring_stats(&stats->spill, _spill);
+	if (locked) {
+		_flush_lock_release();
+	}
+
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	pthread_mutex_lock(&_async_lock);
+	for (struct logger_tring_t *tring = _trings; tring; tring = tring->next) {
+		struct logger_ring_stats_t ring;
+
+		_ring_stats(&ring, tring->rbuf);
+		stats->threads.size += ring.size;
+		stats->threads.used += ring.used;
+		if (ring.peak > stats->threads.peak) {
+			stats->threads.peak = ring.peak;
+		}
+		stats->nr_threads++;
+	}
+	pthread_mutex_unlock(&_async_lock);
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+}
+
+int logger_get_driver_stats(const struct logger_driver_t *drv,
+			    struct logger_driver_stats_t *stats)
+{
+	if (!drv || !stats) {
+		return -1;
+	}
+
+	bool locked = _flush_lock_take(true);
+
+	*stats = drv->stats;
+	if (locked) {
+		_flush_lock_release();
+	}
+
+	return 0;
+}
+
+int logger_set_driver_loglvl(struct logger_driver_t *drv, int loglvl)
+{
+	if (!drv || (loglvl & ~LOG_LVL_EXTRA)) {
+		return -1;
+	}
+
+	bool locked = _flush_lock_take(true);
+
+	drv->loglvl = loglvl;
+	_drivers_loglvl_update();
+	if (locked) {
+		_flush_lock_release();
+	}
+
+	_callsite_update_all();
+
+	return 0;
+}
+
+int logger_get_driver_loglvl(const struct logger_driver_t *drv)
+{
+	return drv ? _driver_loglvl(drv) : LOG_LVL_NONE;
+}
+
+int logger_set_driver_enabled(struct logger_driver_t *drv, bool enabled)
+{
+	if (!drv) {
+		return -1;
+	}
+
+	bool locked = _flush_lock_take(true);
+
+	drv->enabled = enabled;
+	_drivers_loglvl_update();
+	if (locked) {
+		_flush_lock_release();
+	}
+
+	_callsite_update_all();
+
+	return 0;
+}
+
+int logger_set_ts_format(enum logger_ts_format_t fmt)
+{
+	if (fmt < LOGGER_TS_NONE || fmt > LOGGER_TS_UTC) {
+		return -1;
+	}
+
+	atomic_store(&_ts_format, fmt);
+	return 0;
+}
+
+enum logger_ts_format_t logger_get_ts_format()
+{
+	return atomic_load(&_ts_format);
+}
+
+int logger_set_kv_format(enum logger_kv_format_t fmt)
+{
+	if (fmt < LOGGER_KV_TEXT || fmt > LOGGER_KV_JSON) {
+		return -1;
+	}
+
+	atomic_store(&_kv_format, fmt);
+	return 0;
+}
+
+enum logger_kv_format_t logger_get_kv_format()
+{
+	return atomic_load(&_kv_format);
+}
+
+__attribute__((weak)) uint64_t logger_clock_ns()
+{
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	struct timespec now;
+
+	clock_gettime(CFG_LOGGER_TS_CLOCK, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+#else /* CFG_LOGGER_DEEP_EMBEDDED */
+	return 0;
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+}
+
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+/**
+ * @brief  Drainer thread, moves records from the rings to the drivers
+ */
+static void *_drainer_thread(void *arg)
+{
+	(void)arg;
+
+	pthread_mutex_lock(&_async_lock);
+	while (!_async_stop) {
+		pthread_mutex_unlock(&_async_lock);
+		int count = _drain_all(false);
+		pthread_mutex_lock(&_async_lock);
+
+		if (!count && !_async_stop) {
+			struct timespec ts;
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += CFG_LOGGER_ASYNC_INTERVAL_MS * 1000000L;
+			ts.tv_sec += ts.tv_nsec / 1000000000L;
+			ts.tv_nsec %= 1000000000L;
+			pthread_cond_timedwait(&_async_cond, &_async_lock, &ts);
+		}
+	}
+	pthread_mutex_unlock(&_async_lock);
+
+	_drain_all(true);
+
+	return NULL;
+}
+
+int logger_start_async()
+{
+	if (atomic_load(&_async_enabled)) {
+		return 0;
+	}
+
+	pthread_once(&_async_once, _async_init_once);
+
+	_async_stop = false;
+	if (pthread_create(&_drainer, NULL, _drainer_thread, NULL) != 0) {
+		return -1;
+	}
+	atomic_store(&_async_enabled, true);
+
+	return 0;
+}
+
+void logger_stop_async()
+{
+	if (!atomic_load(&_async_enabled)) {
+		return;
+	}
+
+	/* New messages go to the shared ring again */
+	atomic_store(&_async_enabled, false);
+
+	pthread_mutex_lock(&_async_lock);
+	_async_stop = true;
+	pthread_cond_signal(&_async_cond);
+	pthread_mutex_unlock(&_async_lock);
+
+	pthread_join(_drainer, NULL);
+}
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+void logger_close()
+{
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	logger_stop_async();
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+	/* Write out what is left and flush the drivers before closing them */
+	_drain_all(true);
+
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	pthread_mutex_lock(&_async_lock);
+	while (_trings) {
+		struct logger_tring_t *tring = _trings;
+		_trings = tring->next;
+		rbuffer_destroy_rbuffer(tring->rbuf);
+		tring->rbuf = NULL;
+		if (atomic_exchange(&tring->state, TRING_DETACHED) ==
+		    TRING_ORPHANED) {
+			free(tring);
+		}
+	}
+	pthread_mutex_unlock(&_async_lock);
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+	_destroy_rings();
+	_close_drivers(-1);
+}
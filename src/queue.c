@@ -1,120 +1,415 @@
 #include "queue.h"
 
-struct queue_t *queue_create(queue_destroy_t destroy)
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+#define QUEUE_LOCK(l) pthread_mutex_lock(l)
+#define QUEUE_UNLOCK(l) pthread_mutex_unlock(l)
+#else
+#define QUEUE_LOCK(l) do {} while (0)
+#define QUEUE_UNLOCK(l) do {} while (0)
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+/**
+ * @brief  Allocate a chunk and add its elements to the free list
+ *
+ * Called by a producer (tail lock held) or at creation.
+ *
+ * @param q Queue
+ * @param nr Number of elements, limited by max_nodes
+ *
+ * @return -1 if failed otherwise 0
+ */
+static int _grow(struct queue_t *q, size_t nr)
+{
+	struct queue_chunk_t *chunk = NULL;
+
+	if (q->max_nodes) {
+		if (q->nr_nodes >= q->max_nodes) {
+			return -1;
+		}
+		if (nr > q->max_nodes - q->nr_nodes) {
+			nr = q->max_nodes - q->nr_nodes;
+		}
+	}
+	if (nr == 0) {
+		return -1;
+	}
+
+	chunk = malloc(sizeof(struct queue_chunk_t) + nr * sizeof(struct queue_elm_t));
+	if (!chunk) {
+		return -1;
+	}
+	chunk->nr = nr;
+	chunk->next = q->chunks;
+	q->chunks = chunk;
+
+	for (size_t i = 0; i < nr; i++) {
+		atomic_init(&chunk->elms[i].next, i + 1 < nr ? &chunk->elms[i + 1] : q->free);
+		chunk->elms[i].data = NULL;
+	}
+	q->free = &chunk->elms[0];
+	q->nr_nodes += nr;
+
+	return 0;
+}
+
+/**
+ * @brief  Take a free element, producer side (tail lock held)
+ *
+ * @param q Queue
+ *
+ * @return NULL if the pool is exhausted otherwise the element
+ */
+static struct queue_elm_t *_alloc_elm(struct queue_t *q)
+{
+	struct queue_elm_t *elm = NULL;
+
+	if (!q->free) {
+		/* Take every element the consumers gave back at once */
+		q->free = atomic_exchange(&q->recycled, NULL);
+	}
+	if (!q->free && _grow(q, q->nr_nodes) < 0) {
+		return NULL;
+	}
+
+	elm = q->free;
+	q->free = atomic_load_explicit(&elm->next, memory_order_relaxed);
+	return elm;
+}
+
+/**
+ * @brief  Give a chain of elements back to the producers, consumer side
+ *
+ * @param q Queue
+ * @param first First element of the chain
+ * @param last Last element, reached from first through next
+ */
+static void _free_elms(struct queue_t *q, struct queue_elm_t *first,
+		       struct queue_elm_t *last)
+{
+	struct queue_elm_t *top = atomic_load_explicit(&q->recycled, memory_order_relaxed);
+
+	/* Only pushed here and taken as a whole, so no ABA */
+	do {
+		atomic_store_explicit(&last->next, top, memory_order_relaxed);
+	} while (!atomic_compare_exchange_weak(&q->recycled, &top, first));
+}
+
+/**
+ * @brief  Unlink up to max elements, consumer side (head lock held)
+ *
+ * @param q Queue
+ * @param out Receives the data
+ * @param max Size of out
+ * @param first Receives the first element that can be recycled (the old head)
+ * @param last Receives the last element that can be recycled
+ *
+ * @return Number of elements unlinked
+ */
+static int _take(struct queue_t *q, void **out, int max, struct queue_elm_t **first,
+		 struct queue_elm_t **last)
+{
+	struct queue_elm_t *elm = q->head;
+	struct queue_elm_t *next = NULL;
+	int n = 0;
+
+	*first = elm;
+	while (n < max && (next = atomic_load_explicit(&elm->next, memory_order_acquire))) {
+		out[n++] = next->data;
+		*last = elm;
+		elm = next;
+	}
+
+	/* The last element taken becomes the new dummy */
+	if (n) {
+		q->head = elm;
+		atomic_fetch_sub(&q->n_elements, n);
+	}
+	return n;
+}
+
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+/**
+ * @brief  Convert a timeout into an absolute CLOCK_MONOTONIC deadline
+ */
+static void _deadline(struct timespec *deadline, int timeout_ms)
+{
+	clock_gettime(CLOCK_MONOTONIC, deadline);
+	deadline->tv_sec += timeout_ms / 1000;
+	deadline->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+	if (deadline->tv_nsec >= 1000000000L) {
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
+/**
+ * @brief  Sleep on a condition until signaled or the deadline has passed
+ *
+ * @return -1 if the deadline has passed otherwise 0
+ */
+static int _wait(pthread_cond_t *cond, pthread_mutex_t *lock, int timeout_ms,
+		 const struct timespec *deadline)
 {
-	struct queue_t *q = malloc(sizeof(struct queue_t));
+	if (timeout_ms < 0) {
+		return pthread_cond_wait(cond, lock) ? -1 : 0;
+	}
+	return pthread_cond_timedwait(cond, lock, deadline) ? -1 : 0;
+}
 
+/**
+ * @brief  Wake a thread sleeping on the other side of the queue
+ *
+ * Called after a sequentially consistent update of the state the other side
+ * waits for, a waiter checks that state again after announcing itself. So
+ * either the waiter sees the update or this sees the waiter, a wakeup is never
+ * lost. The lock is only taken when somebody sleeps.
+ */
+static void _wake(atomic_int *waiters, pthread_cond_t *cond, pthread_mutex_t *lock,
+		  bool all)
+{
+	if (!atomic_load(waiters)) {
+		return;
+	}
+
+	pthread_mutex_lock(lock);
+	if (all) {
+		pthread_cond_broadcast(cond);
+	} else {
+		pthread_cond_signal(cond);
+	}
+	pthread_mutex_unlock(lock);
+}
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
+struct queue_t *queue_create_pool(queue_destroy_t destroy, size_t nodes,
+				  size_t max_nodes)
+{
+	struct queue_t *q = NULL;
+
+	/* One more for the dummy */
+	nodes += 1;
+	if (max_nodes) {
+		max_nodes += 1;
+		if (nodes > max_nodes) {
+			nodes = max_nodes;
+		}
+	}
+
+	q = aligned_alloc(QUEUE_CACHE_LINE, sizeof(struct queue_t));
 	if (!q) {
 		return NULL;
 	}
 	memset(q, 0, sizeof(struct queue_t));
 	q->destroy = destroy;
+	q->max_nodes = max_nodes;
+	atomic_init(&q->recycled, NULL);
+	atomic_init(&q->n_elements, 0);
+	atomic_init(&q->pop_waiters, 0);
+	atomic_init(&q->push_waiters, 0);
+
+	if (_grow(q, nodes) < 0) {
+		free(q);
+		return NULL;
+	}
+	q->head = q->tail = _alloc_elm(q);
+	atomic_init(&q->head->next, NULL);
+
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	pthread_condattr_t attr;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_mutex_init(&q->head_lock, NULL);
+	pthread_mutex_init(&q->tail_lock, NULL);
+	pthread_cond_init(&q->not_empty, &attr);
+	pthread_cond_init(&q->not_full, &attr);
+	pthread_condattr_destroy(&attr);
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
 
 	LOG_INFO("Queue created");
 
 	return q;
 }
 
-int queue_push(struct queue_t *q, void *data)
+struct queue_t *queue_create(queue_destroy_t destroy)
+{
+	return queue_create_pool(destroy, CFG_QUEUE_POOL_NODES, 0);
+}
+
+int queue_push_timed(struct queue_t *q, void *data, int timeout_ms)
 {
+	struct queue_elm_t *new = NULL;
+
 	if (!q) {
 		return -1;
 	}
 
-	struct queue_elm_t *new = malloc(sizeof(struct queue_elm_t));
+	QUEUE_LOCK(&q->tail_lock);
+
+	new = _alloc_elm(q);
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	if (!new && timeout_ms) {
+		struct timespec deadline;
 
+		_deadline(&deadline, timeout_ms);
+		/* _alloc_elm() takes the recycled elements with a seq_cst exchange */
+		atomic_fetch_add(&q->push_waiters, 1);
+		while (!(new = _alloc_elm(q))) {
+			if (_wait(&q->not_full, &q->tail_lock, timeout_ms, &deadline) < 0) {
+				new = _alloc_elm(q);
+				break;
+			}
+		}
+		atomic_fetch_sub(&q->push_waiters, 1);
+	}
+#else
+	(void)timeout_ms;
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
 	if (!new) {
+		QUEUE_UNLOCK(&q->tail_lock);
 		return -1;
 	}
-	memset(new, 0, sizeof(struct queue_elm_t));
+	new->data = data;
+	atomic_store_explicit(&new->next, NULL, memory_order_relaxed);
+
+	/* Publishes the data to the consumers */
+	atomic_store_explicit(&q->tail->next, new, memory_order_release);
+	q->tail = new;
+	atomic_fetch_add(&q->n_elements, 1);
 
 #ifndef CFG_LOGGER_DEEP_EMBEDDED
-	pthread_mutex_lock(&q->mutex);
+	/* Pass the wakeup on when this thread took one of several free elements */
+	if ((q->free || atomic_load_explicit(&q->recycled, memory_order_relaxed)) &&
+	    atomic_load(&q->push_waiters)) {
+		pthread_cond_signal(&q->not_full);
+	}
 #endif /* CFG_LOGGER_DEEP_EMBEDDED */
 
-	new->data = data;
-
-	if (q->n_elements == 0) {
-		new->id = 0;
-		q->head = new;
-		q->tail = new;
-	} else {
-		new->id = q->tail->id++;
-		q->tail->next = new;
-		new->prev = q->tail;
-		q->tail = new;
-	}
-	q->n_elements++;
+	QUEUE_UNLOCK(&q->tail_lock);
 
 #ifndef CFG_LOGGER_DEEP_EMBEDDED
-	pthread_mutex_unlock(&q->mutex);
+	_wake(&q->pop_waiters, &q->not_empty, &q->head_lock, false);
 #endif /* CFG_LOGGER_DEEP_EMBEDDED */
 
 	return 0;
 }
 
-int queue_pop(struct queue_t *q, void **data)
+int queue_push(struct queue_t *q, void *data)
 {
-	struct queue_elm_t *tmp, *new_head;
+	return queue_push_timed(q, data, 0);
+}
 
-	if (!q) {
+int queue_pop_batch_timed(struct queue_t *q, void **out, int max, int timeout_ms)
+{
+	struct queue_elm_t *first = NULL;
+	struct queue_elm_t *last = NULL;
+	int n = 0;
+
+	if (!q || !out || max <= 0) {
 		return -1;
 	}
 
+	QUEUE_LOCK(&q->head_lock);
+
+	n = _take(q, out, max, &first, &last);
 #ifndef CFG_LOGGER_DEEP_EMBEDDED
-	pthread_mutex_lock(&q->mutex);
+	if (!n && timeout_ms) {
+		struct timespec deadline;
+
+		_deadline(&deadline, timeout_ms);
+		atomic_fetch_add(&q->pop_waiters, 1);
+		while (!(n = _take(q, out, max, &first, &last))) {
+			/* Pairs with the seq_cst increment of a producer */
+			if (atomic_load(&q->n_elements)) {
+				continue;
+			}
+			if (_wait(&q->not_empty, &q->head_lock, timeout_ms, &deadline) < 0) {
+				n = _take(q, out, max, &first, &last);
+				break;
+			}
+		}
+		atomic_fetch_sub(&q->pop_waiters, 1);
+	}
+
+	/* Pass the wakeup on when there's more than this thread took */
+	if (n && atomic_load_explicit(&q->head->next, memory_order_relaxed) &&
+	    atomic_load(&q->pop_waiters)) {
+		pthread_cond_signal(&q->not_empty);
+	}
+#else
+	(void)timeout_ms;
 #endif /* CFG_LOGGER_DEEP_EMBEDDED */
 
-	if (q->n_elements == 0) {
+	QUEUE_UNLOCK(&q->head_lock);
+
+	if (n) {
+		_free_elms(q, first, last);
 #ifndef CFG_LOGGER_DEEP_EMBEDDED
-		pthread_mutex_unlock(&q->mutex);
+		_wake(&q->push_waiters, &q->not_full, &q->tail_lock, n > 1);
 #endif /* CFG_LOGGER_DEEP_EMBEDDED */
-		return -1;
 	}
 
-	tmp = q->head;
-	if (!tmp) {
-		LOG_DEBUG("%d TMP is NULL!!", q->n_elements);
-	}
+	return n;
+}
 
-	if (q->n_elements > 1) {
-		new_head = tmp->next;
-		new_head->prev = NULL;
-		q->head = new_head;
-	} else {
-		q->head = NULL;
-		q->tail = NULL;
-	}
+int queue_pop_batch(struct queue_t *q, void **out, int max)
+{
+	return queue_pop_batch_timed(q, out, max, 0);
+}
+
+int queue_pop_timed(struct queue_t *q, void **data, int timeout_ms)
+{
+	return queue_pop_batch_timed(q, data, 1, timeout_ms) == 1 ? 0 : -1;
+}
 
-	q->n_elements--;
+int queue_pop(struct queue_t *q, void **data)
+{
+	return queue_pop_timed(q, data, 0);
+}
 
-	// LOG_DEBUG("Dequeued buffer %d",tmp->id);
+size_t queue_capacity(struct queue_t *q)
+{
+	size_t nr = 0;
 
-	*data = tmp->data;
-	free(tmp);
+	if (!q) {
+		return 0;
+	}
 
-#ifndef CFG_LOGGER_DEEP_EMBEDDED
-	pthread_mutex_unlock(&q->mutex);
-#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+	QUEUE_LOCK(&q->tail_lock);
+	nr = q->nr_nodes - 1;
+	QUEUE_UNLOCK(&q->tail_lock);
 
-	return 0;
+	return nr;
 }
 
 void queue_destroy(struct queue_t *q)
 {
+	struct queue_chunk_t *chunk = NULL;
 	void *data;
 
 	if (!q) {
 		return;
 	}
 
-	while (QUEUE_SIZE(q)) {
-		queue_pop(q, &data);
+	while (queue_pop(q, &data) == 0) {
 		if (q->destroy) {
 			q->destroy(data);
 		}
 	}
+
+	while (q->chunks) {
+		chunk = q->chunks;
+		q->chunks = chunk->next;
+		free(chunk);
+	}
+
+#ifndef CFG_LOGGER_DEEP_EMBEDDED
+	pthread_cond_destroy(&q->not_empty);
+	pthread_cond_destroy(&q->not_full);
+	pthread_mutex_destroy(&q->head_lock);
+	pthread_mutex_destroy(&q->tail_lock);
+#endif /* CFG_LOGGER_DEEP_EMBEDDED */
+
 	free(q);
-	q = NULL;
 	return;
 }
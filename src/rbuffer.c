@@ -0,0 +1,391 @@
+/**
+ * @file rbuffer.c
+ * @brief Record (byte oriented) ring buffer implementation
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v1.3
+ * @date 2026-10-16
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rbuffer.h"
+
+#define RBUFFER_HDR_LEN sizeof(struct rbuffer_hdr_t)
+
+_Static_assert(RBUFFER_ALIGN >= sizeof(struct rbuffer_hdr_t),
+	       "RBUFFER_ALIGN must hold a record header");
+_Static_assert((RBUFFER_ALIGN & (RBUFFER_ALIGN - 1)) == 0,
+	       "RBUFFER_ALIGN must be a power of 2");
+
+/** Round up to the record alignment */
+#define RBUFFER_ALIGN_UP(x) (((x) + RBUFFER_ALIGN - 1) & ~(size_t)(RBUFFER_ALIGN - 1))
+
+/** Offset of the data area from the rbuffer structure */
+#define RBUFFER_DATA_OFFSET \
+	((sizeof(struct rbuffer_t) + RBUFFER_CACHE_LINE - 1) & ~(size_t)(RBUFFER_CACHE_LINE - 1))
+
+/** Smallest data area, room for two headers */
+#define RBUFFER_MIN_SIZE (RBUFFER_ALIGN_UP(RBUFFER_HDR_LEN) * 2)
+
+static inline struct rbuffer_hdr_t *_hdr_at(struct rbuffer_t *rbuf, size_t off)
+{
+	return (struct rbuffer_hdr_t *)&rbuf->data[off & (rbuf->size - 1)];
+}
+
+/**
+ * @brief  Round a size up to the power of 2 used for the data area
+ */
+static size_t _real_size(size_t size)
+{
+	size_t real_size = RBUFFER_MIN_SIZE;
+
+	while (real_size < size) {
+		real_size <<= 1;
+	}
+	return real_size;
+}
+
+size_t rbuffer_mem_size(size_t size)
+{
+	return RBUFFER_CACHE_LINE - 1 + RBUFFER_DATA_OFFSET + _real_size(size);
+}
+
+struct rbuffer_t *rbuffer_init_rbuffer_mem(void *mem, size_t len, enum rbuffer_mode_t mode)
+{
+	uintptr_t start = ((uintptr_t)mem + RBUFFER_CACHE_LINE - 1) &
+			  ~(uintptr_t)(RBUFFER_CACHE_LINE - 1);
+	struct rbuffer_t *rbuf = (struct rbuffer_t *)start;
+	size_t real_size = RBUFFER_MIN_SIZE;
+
+	if (!mem || start - (uintptr_t)mem + RBUFFER_DATA_OFFSET + RBUFFER_MIN_SIZE > len) {
+		RBUF_ERR("Invalid argument, mem == NULL or len too small");
+		return NULL;
+	}
+
+	len -= start - (uintptr_t)mem + RBUFFER_DATA_OFFSET;
+	while (real_size <= len / 2) {
+		real_size <<= 1;
+	}
+
+	memset(rbuf, 0, sizeof(struct rbuffer_t));
+	rbuf->data = (uint8_t *)start + RBUFFER_DATA_OFFSET;
+	/* MPSC mode relies on free space being zeroed */
+	memset(rbuf->data, 0, real_size);
+
+	rbuf->size = real_size;
+	rbuf->mode = mode;
+	rbuf->external = true;
+	atomic_init(&rbuf->head, 0);
+	atomic_init(&rbuf->tail_cache, 0);
+	atomic_init(&rbuf->tail, 0);
+	rbuf->head_cache = 0;
+	atomic_init(&rbuf->peak, 0);
+
+	return rbuf;
+}
+
+struct rbuffer_t *rbuffer_init_rbuffer_mode(size_t size, enum rbuffer_mode_t mode)
+{
+	struct rbuffer_t *rbuf = NULL;
+	size_t len = RBUFFER_DATA_OFFSET + _real_size(size);
+
+	/* One block: the structure, then the data area on the next cache line */
+	void *mem = aligned_alloc(RBUFFER_CACHE_LINE, len);
+
+	if (!mem) {
+		RBUF_ERR("Failed to allocate the rbuffer");
+		return NULL;
+	}
+
+	rbuf = rbuffer_init_rbuffer_mem(mem, len, mode);
+	rbuf->external = false;
+
+	return rbuf;
+}
+
+struct rbuffer_t *rbuffer_init_rbuffer(size_t size)
+{
+	return rbuffer_init_rbuffer_mode(size, RBUFFER_MODE_SPSC);
+}
+
+/**
+ * @brief  Compute the padding needed to keep a record contiguous
+ *
+ * @returns  Number of padding bytes, 0 if the record fits before the end
+ */
+static inline size_t _padding(struct rbuffer_t *rbuf, size_t head, size_t need)
+{
+	size_t idx = head & (rbuf->size - 1);
+
+	return (idx + need > rbuf->size) ? rbuf->size - idx : 0;
+}
+
+void *rbuffer_get_write_pointer(struct rbuffer_t *rbuf, size_t len)
+{
+	struct rbuffer_hdr_t *hdr = NULL;
+	size_t pad = 0;
+
+	if (!rbuf || !rbuf->data) {
+		RBUF_ERR("Invalid argument, rbuf || rbuf->data == NULL");
+		return NULL;
+	}
+
+	if (len >= RBUFFER_PAD) {
+		return NULL;
+	}
+
+	size_t need = RBUFFER_ALIGN_UP(RBUFFER_HDR_LEN + len);
+	size_t head = atomic_load_explicit(&rbuf->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&rbuf->tail_cache, memory_order_acquire);
+
+	do {
+		pad = _padding(rbuf, head, need);
+		if ((head - tail) + pad + need > rbuf->size) {
+			/* Looks full, only now look at the consumer side */
+			tail = atomic_load_explicit(&rbuf->tail, memory_order_acquire);
+			atomic_store_explicit(&rbuf->tail_cache, tail,
+					      memory_order_release);
+			if ((head - tail) + pad + need > rbuf->size) {
+				return NULL;
+			}
+		}
+		if (rbuf->mode == RBUFFER_MODE_SPSC) {
+			/* head is only moved on commit */
+			break;
+		}
+	} while (!atomic_compare_exchange_weak_explicit(&rbuf->head, &head,
+							head + pad + need,
+							memory_order_acquire,
+							memory_order_relaxed));
+
+	if (pad) {
+		/* Not enough room before the end, skip to the start */
+		hdr = _hdr_at(rbuf, head);
+		hdr->size = pad;
+		hdr->len = RBUFFER_PAD;
+		atomic_store_explicit(&hdr->seq, head + 1, memory_order_release);
+		head += pad;
+	}
+
+	hdr = _hdr_at(rbuf, head);
+	hdr->size = need;
+	hdr->len = len;
+	atomic_store_explicit(&hdr->seq, head, memory_order_relaxed);
+
+	return hdr + 1;
+}
+
+int rbuffer_signal_element_written(struct rbuffer_t *rbuf, void *ptr, size_t len)
+{
+	if (!rbuf || !rbuf->data || !ptr) {
+		RBUF_ERR("WP: rbuffer, rbuffer->data or ptr cannot be NULL!");
+		return -1;
+	}
+
+	struct rbuffer_hdr_t *hdr = (struct rbuffer_hdr_t *)ptr - 1;
+	size_t pos = atomic_load_explicit(&hdr->seq, memory_order_relaxed);
+
+	if (len > hdr->len) {
+		RBUF_ERR("WP: Written more than reserved!");
+		return -1;
+	}
+	hdr->len = len;
+
+	size_t size = RBUFFER_ALIGN_UP(RBUFFER_HDR_LEN + len);
+
+	if (rbuf->mode == RBUFFER_MODE_SPSC) {
+		hdr->size = size;
+		atomic_store_explicit(&hdr->seq, pos + 1, memory_order_relaxed);
+		atomic_store_explicit(&rbuf->head, pos + hdr->size,
+				      memory_order_release);
+	} else {
+		size_t end = pos + hdr->size;
+
+		/*
+		 * Give back the unused tail while no other record follows, it
+		 * has to be zeroed again before another producer can take it
+		 */
+		if (size < hdr->size) {
+			memset((uint8_t *)hdr + size, 0, hdr->size - size);
+			if (atomic_compare_exchange_strong_explicit(&rbuf->head, &end,
+								    pos + size,
+								    memory_order_release,
+								    memory_order_relaxed)) {
+				hdr->size = size;
+			}
+		}
+		atomic_store_explicit(&hdr->seq, pos + 1, memory_order_release);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief  Update the high-watermark, only called by the consumer
+ *
+ * Nothing is released while the consumer isn't reading, so the usage only
+ * grows until it looks at the write offset again.
+ */
+static inline void _sample_peak(struct rbuffer_t *rbuf, size_t head, size_t tail)
+{
+	if (head - tail > atomic_load_explicit(&rbuf->peak, memory_order_relaxed)) {
+		atomic_store_explicit(&rbuf->peak, head - tail, memory_order_relaxed);
+	}
+}
+
+/**
+ * @brief  Check if the record at the read offset has been committed
+ *
+ * @returns  NULL if not committed (or empty), otherwise the record header
+ */
+static inline struct rbuffer_hdr_t *_committed_hdr(struct rbuffer_t *rbuf,
+						   size_t tail)
+{
+	struct rbuffer_hdr_t *hdr = _hdr_at(rbuf, tail);
+
+	if (rbuf->mode == RBUFFER_MODE_SPSC) {
+		if (tail == rbuf->head_cache) {
+			/* Looks empty, only now look at the producer side */
+			rbuf->head_cache = atomic_load_explicit(&rbuf->head,
+								memory_order_acquire);
+			_sample_peak(rbuf, rbuf->head_cache,
+				     atomic_load_explicit(&rbuf->tail,
+							  memory_order_relaxed));
+			if (tail == rbuf->head_cache) {
+				return NULL;
+			}
+		}
+		return hdr;
+	}
+
+	if (atomic_load_explicit(&hdr->seq, memory_order_acquire) != tail + 1) {
+		return NULL;
+	}
+	return hdr;
+}
+
+/**
+ * @brief  Release the record at the read offset
+ */
+static inline void _release_hdr(struct rbuffer_t *rbuf, struct rbuffer_hdr_t *hdr,
+				size_t tail)
+{
+	size_t size = hdr->size;
+
+	if (rbuf->mode == RBUFFER_MODE_MPSC) {
+		memset(hdr, 0, size);
+	}
+	atomic_store_explicit(&rbuf->tail, tail + size, memory_order_release);
+}
+
+void *rbuffer_get_read_pointer(struct rbuffer_t *rbuf, size_t *len)
+{
+	struct rbuffer_hdr_t *hdr = NULL;
+
+	if (!rbuf || !rbuf->data) {
+		RBUF_ERR("Invalid argument, rbuf || rbuf->data == NULL");
+		return NULL;
+	}
+
+	size_t tail = atomic_load_explicit(&rbuf->tail, memory_order_relaxed);
+
+	while ((hdr = _committed_hdr(rbuf, tail)) != NULL) {
+		if (hdr->len != RBUFFER_PAD) {
+			if (len) {
+				*len = hdr->len;
+			}
+			return hdr + 1;
+		}
+		size_t size = hdr->size;
+		_release_hdr(rbuf, hdr, tail);
+		tail += size;
+	}
+
+	return NULL;
+}
+
+void *rbuffer_get_next_read_pointer(struct rbuffer_t *rbuf, const void *prev,
+				    size_t *len)
+{
+	struct rbuffer_hdr_t *hdr = NULL;
+	size_t off = 0;
+
+	if (!rbuf || !rbuf->data) {
+		RBUF_ERR("Invalid argument, rbuf || rbuf->data == NULL");
+		return NULL;
+	}
+
+	if (!prev) {
+		off = atomic_load_explicit(&rbuf->tail, memory_order_relaxed);
+		if (rbuf->mode == RBUFFER_MODE_MPSC) {
+			/* Once per batch, SPSC samples when it reloads head */
+			_sample_peak(rbuf, atomic_load_explicit(&rbuf->head,
+								memory_order_relaxed),
+				     off);
+		}
+	} else {
+		hdr = (struct rbuffer_hdr_t *)prev - 1;
+		/* A committed record holds its offset + 1 */
+		off = atomic_load_explicit(&hdr->seq, memory_order_relaxed) - 1 +
+		      hdr->size;
+	}
+
+	while ((hdr = _committed_hdr(rbuf, off)) != NULL) {
+		if (hdr->len != RBUFFER_PAD) {
+			if (len) {
+				*len = hdr->len;
+			}
+			return hdr + 1;
+		}
+		/* Released together with the record that follows it */
+		off += hdr->size;
+	}
+
+	return NULL;
+}
+
+int rbuffer_signal_element_read(struct rbuffer_t *rbuf)
+{
+	struct rbuffer_hdr_t *hdr = NULL;
+
+	if (!rbuf || !rbuf->data) {
+		RBUF_ERR("RP: rbuffer or rbuffer->data cannot be NULL!");
+		return -1;
+	}
+
+	size_t tail = atomic_load_explicit(&rbuf->tail, memory_order_relaxed);
+
+	while ((hdr = _committed_hdr(rbuf, tail)) != NULL && hdr->len == RBUFFER_PAD) {
+		size_t size = hdr->size;
+		_release_hdr(rbuf, hdr, tail);
+		tail += size;
+	}
+
+	if (!hdr) {
+		RBUF_ERR("RP: No record to release!");
+		return -1;
+	}
+
+	_release_hdr(rbuf, hdr, tail);
+
+	return 0;
+}
+
+void rbuffer_flush(struct rbuffer_t *rbuf)
+{
+	if (!rbuf) {
+		return;
+	}
+
+	while (rbuffer_get_read_pointer(rbuf, NULL)) {
+		rbuffer_signal_element_read(rbuf);
+	}
+}
+
+void rbuffer_destroy_rbuffer(struct rbuffer_t *rbuf)
+{
+	if (rbuf && !rbuf->external) {
+		free(rbuf);
+	}
+}
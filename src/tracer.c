@@ -0,0 +1,371 @@
+/**
+ * @file tracer.c
+ * @brief  Per-thread span rings and the Chrome trace exporter
+ *
+ * Every thread writes its spans to its own ring, only the head index is
+ * shared with the exporter. The exporter copies a ring and then checks the
+ * head again: spans that may have been overwritten while copying are skipped,
+ * so recording never waits on an export.
+ *
+ * Only the owner writes to its ring. The thread id and name are published
+ * with a sequence count, tracer_reset() only bumps a generation that every
+ * owner applies to its own ring when it records the next span.
+ *
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v0.1
+ * @date 2026-10-16
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "tracer.h"
+
+#if (CFG_TRACER_RING_EVENTS & (CFG_TRACER_RING_EVENTS - 1)) != 0
+#error "CFG_TRACER_RING_EVENTS must be a power of 2"
+#endif /* CFG_TRACER_RING_EVENTS */
+
+/** Max thread name length (NUL included) */
+#define MAX_THREAD_NAME 16
+
+/** Reads of a thread name that is being rewritten before it is left out */
+#define MAX_NAME_TRIES 100
+
+/**
+ * @brief  A recorded span, every field is read while it may be rewritten
+ */
+struct tracer_event_t {
+	_Atomic(const char *)	name;   //!< Span name
+	atomic_ullong		ts;     //!< Start, tracer_now_ns()
+	atomic_ullong		dur;    //!< Duration in ns
+	atomic_int		tid;    //!< Thread that recorded the span
+};
+
+/**
+ * @brief  Span ring of a thread
+ *
+ * A ring is never freed. When its thread exits it can be taken over by a new
+ * thread, the spans of the old one are kept until they are overwritten. That's
+ * why every span holds its thread id.
+ */
+struct tracer_ring_t {
+	atomic_ullong		head;                   //!< Spans written (free running)
+	atomic_ullong		first;                  //!< First span since the reset of gen
+	atomic_uint		gen;                    //!< Last _reset_gen applied by the owner
+	atomic_bool		owned;                  //!< A thread writes to this ring
+	atomic_uint		seq;                    //!< Odd while tid and name are rewritten
+	atomic_int		tid;                    //!< Thread id of the (last) owner
+	_Atomic char		name[MAX_THREAD_NAME];  //!< Thread name of the (last) owner
+	struct tracer_ring_t *	next;                   //!< Next registered ring
+	struct tracer_event_t	events[CFG_TRACER_RING_EVENTS]; //!< The spans
+};
+
+/**
+ * @brief  Exported copy of a span
+ */
+struct tracer_copy_t {
+	const char *	name;   //!< Span name
+	uint64_t	ts;     //!< Start
+	uint64_t	dur;    //!< Duration
+	int		tid;    //!< Thread id
+};
+
+atomic_bool _tracer_enabled = true;
+
+static _Atomic(struct tracer_ring_t *) _rings;  //!< All rings ever created
+static pthread_once_t _ring_once = PTHREAD_ONCE_INIT;
+static pthread_key_t _ring_key;
+static _Thread_local struct tracer_ring_t *_own_ring;
+static atomic_uint _reset_gen;                  //!< Calls of tracer_reset()
+
+/**
+ * @brief  Thread exit hook, releases the ring for another thread
+ */
+static void _ring_release(void *arg)
+{
+	struct tracer_ring_t *ring = (struct tracer_ring_t *)arg;
+
+	atomic_store_explicit(&ring->owned, false, memory_order_release);
+}
+
+static void _ring_init_once(void)
+{
+	pthread_key_create(&_ring_key, _ring_release);
+}
+
+/**
+ * @brief  Publish the thread id and name of the ring, owner only
+ *
+ * @param ring Ring of the calling thread
+ * @param tid Thread id, 0 to keep the current one
+ * @param name Thread name, truncated to MAX_THREAD_NAME - 1 characters
+ */
+static void _ring_set_owner(struct tracer_ring_t *ring, int tid, const char *name)
+{
+	unsigned seq = atomic_load_explicit(&ring->seq, memory_order_relaxed);
+	size_t i = 0;
+
+	atomic_store_explicit(&ring->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	if (tid) {
+		atomic_store_explicit(&ring->tid, tid, memory_order_relaxed);
+	}
+	for (; i < MAX_THREAD_NAME - 1 && name[i]; i++) {
+		atomic_store_explicit(&ring->name[i], name[i], memory_order_relaxed);
+	}
+	for (; i < MAX_THREAD_NAME; i++) {
+		atomic_store_explicit(&ring->name[i], '\0', memory_order_relaxed);
+	}
+
+	atomic_store_explicit(&ring->seq, seq + 2, memory_order_release);
+}
+
+/**
+ * @brief  Read a consistent thread id and name of a ring
+ *
+ * @param ring Ring that is exported
+ * @param tid Output, thread id
+ * @param name Output, MAX_THREAD_NAME characters
+ *
+ * @returns  -1 if the owner kept rewriting them, otherwise 0
+ */
+static int _ring_get_owner(struct tracer_ring_t *ring, int *tid, char *name)
+{
+	for (int tries = 0; tries < MAX_NAME_TRIES; tries++) {
+		unsigned seq = atomic_load_explicit(&ring->seq, memory_order_acquire);
+
+		if (seq & 1) {
+			sched_yield();
+			continue;
+		}
+		*tid = atomic_load_explicit(&ring->tid, memory_order_relaxed);
+		for (size_t i = 0; i < MAX_THREAD_NAME; i++) {
+			name[i] = atomic_load_explicit(&ring->name[i], memory_order_relaxed);
+		}
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(&ring->seq, memory_order_relaxed) == seq) {
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief  Retrieve (or create) the ring of the calling thread
+ *
+ * @returns  NULL if failed, otherwise the ring of the thread
+ */
+static struct tracer_ring_t *_thread_ring(void)
+{
+	struct tracer_ring_t *ring = NULL;
+	bool owned = false;
+
+	if (_own_ring) {
+		return _own_ring;
+	}
+
+	pthread_once(&_ring_once, _ring_init_once);
+
+	/* Take over the ring of a thread that has exited */
+	for (ring = atomic_load(&_rings); ring; ring = ring->next) {
+		owned = false;
+		if (atomic_compare_exchange_strong(&ring->owned, &owned, true)) {
+			break;
+		}
+	}
+
+	if (!ring) {
+		ring = calloc(1, sizeof(struct tracer_ring_t));
+		if (!ring) {
+			return NULL;
+		}
+		atomic_init(&ring->owned, true);
+		ring->next = atomic_load(&_rings);
+		while (!atomic_compare_exchange_weak(&_rings, &ring->next, ring)) {
+		}
+	}
+
+	_ring_set_owner(ring, (int)syscall(SYS_gettid), "");
+	pthread_setspecific(_ring_key, ring);
+	_own_ring = ring;
+
+	return ring;
+}
+
+void tracer_record(const char *name, uint64_t begin, uint64_t end)
+{
+	struct tracer_ring_t *ring = _thread_ring();
+
+	if (!ring) {
+		return;
+	}
+
+	/* Only this thread moves the head */
+	unsigned long long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	struct tracer_event_t *ev = &ring->events[head & (CFG_TRACER_RING_EVENTS - 1)];
+	unsigned gen = atomic_load_explicit(&_reset_gen, memory_order_relaxed);
+
+	/* tracer_reset() was called, the spans before this one are gone */
+	if (atomic_load_explicit(&ring->gen, memory_order_relaxed) != gen) {
+		atomic_store_explicit(&ring->first, head, memory_order_relaxed);
+		atomic_store_explicit(&ring->gen, gen, memory_order_release);
+	}
+
+	atomic_store_explicit(&ev->name, name, memory_order_relaxed);
+	atomic_store_explicit(&ev->ts, begin, memory_order_relaxed);
+	atomic_store_explicit(&ev->dur, end - begin, memory_order_relaxed);
+	atomic_store_explicit(&ev->tid, atomic_load_explicit(&ring->tid, memory_order_relaxed),
+			      memory_order_relaxed);
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void tracer_set_enabled(bool enabled)
+{
+	atomic_store(&_tracer_enabled, enabled);
+}
+
+int tracer_set_thread_name(const char *name)
+{
+	struct tracer_ring_t *ring = _thread_ring();
+
+	if (!ring || !name) {
+		return -1;
+	}
+
+	_ring_set_owner(ring, 0, name);
+	return 0;
+}
+
+/**
+ * @brief  Copy the spans of a ring that weren't overwritten
+ *
+ * @param ring Ring that will be copied
+ * @param gen Current _reset_gen
+ * @param copy Output, CFG_TRACER_RING_EVENTS spans
+ *
+ * @returns  Number of spans copied
+ */
+static size_t _copy_ring(struct tracer_ring_t *ring, unsigned gen, struct tracer_copy_t *copy)
+{
+	/* The owner didn't record since the reset, everything is older */
+	if (atomic_load_explicit(&ring->gen, memory_order_acquire) != gen) {
+		return 0;
+	}
+
+	unsigned long long first = atomic_load_explicit(&ring->first, memory_order_relaxed);
+	unsigned long long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	unsigned long long start = head > CFG_TRACER_RING_EVENTS ?
+				   head - CFG_TRACER_RING_EVENTS : 0;
+
+	if (start < first) {
+		start = first;
+	}
+
+	for (unsigned long long i = start; i < head; i++) {
+		struct tracer_event_t *ev = &ring->events[i & (CFG_TRACER_RING_EVENTS - 1)];
+		struct tracer_copy_t *c = &copy[i - start];
+
+		c->name = atomic_load_explicit(&ev->name, memory_order_relaxed);
+		c->ts = atomic_load_explicit(&ev->ts, memory_order_relaxed);
+		c->dur = atomic_load_explicit(&ev->dur, memory_order_relaxed);
+		c->tid = atomic_load_explicit(&ev->tid, memory_order_relaxed);
+	}
+
+	/* Spans the owner started rewriting meanwhile may be torn */
+	atomic_thread_fence(memory_order_acquire);
+	unsigned long long now = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	unsigned long long valid = now >= CFG_TRACER_RING_EVENTS ?
+				   now - CFG_TRACER_RING_EVENTS + 1 : 0;
+
+	if (valid <= start) {
+		return head - start;
+	}
+	if (valid >= head) {
+		return 0;
+	}
+	memmove(copy, &copy[valid - start], (head - valid) * sizeof(*copy));
+	return head - valid;
+}
+
+/**
+ * @brief  Write a JSON string
+ */
+static void _json_str(FILE *out, const char *str)
+{
+	fputc('"', out);
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\') {
+			fputc('\\', out);
+			fputc(*str, out);
+		} else if ((unsigned char)*str < 0x20) {
+			fprintf(out, "\\u%04x", (unsigned char)*str);
+		} else {
+			fputc(*str, out);
+		}
+	}
+	fputc('"', out);
+}
+
+int tracer_export_chrome(FILE *out)
+{
+	struct tracer_copy_t *copy = NULL;
+	unsigned gen = atomic_load(&_reset_gen);
+	char name[MAX_THREAD_NAME];
+	int pid = getpid();
+	bool first = true;
+	int count = 0;
+
+	if (!out) {
+		return -1;
+	}
+
+	copy = malloc(CFG_TRACER_RING_EVENTS * sizeof(struct tracer_copy_t));
+	if (!copy) {
+		return -1;
+	}
+
+	fputs("{\"traceEvents\":[", out);
+	for (struct tracer_ring_t *ring = atomic_load(&_rings); ring; ring = ring->next) {
+		size_t nr = _copy_ring(ring, gen, copy);
+		int tid = 0;
+
+		if (!_ring_get_owner(ring, &tid, name) && name[0]) {
+			fprintf(out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+				"\"tid\":%d,\"args\":{\"name\":", first ? "" : ",", pid, tid);
+			_json_str(out, name);
+			fputs("}}", out);
+			first = false;
+		}
+
+		for (size_t i = 0; i < nr; i++) {
+			fprintf(out, "%s\n{\"name\":", first ? "" : ",");
+			_json_str(out, copy[i].name);
+			/* Microseconds, ns resolution */
+			fprintf(out, ",\"ph\":\"X\",\"ts\":%llu.%03u,\"dur\":%llu.%03u,"
+				"\"pid\":%d,\"tid\":%d}",
+				(unsigned long long)(copy[i].ts / 1000),
+				(unsigned)(copy[i].ts % 1000),
+				(unsigned long long)(copy[i].dur / 1000),
+				(unsigned)(copy[i].dur % 1000), pid, copy[i].tid);
+			first = false;
+			count++;
+		}
+	}
+	fputs("\n],\"displayTimeUnit\":\"ns\"}\n", out);
+
+	free(copy);
+	return ferror(out) ? -1 : count;
+}
+
+void tracer_reset(void)
+{
+	atomic_fetch_add(&_reset_gen, 1);
+}
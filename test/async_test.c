@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "logger.h"
+#include "test-common.h"
+
+#define NR_THREADS 4
+#define NR_THREAD_MSGS 1000
+#define MAX_LINES (2 * NR_THREADS * NR_THREAD_MSGS)
+
+static char _lines[MAX_LINES][CAPTURE_LINE_LEN];
+static struct capture_t _capture = {
+	.hist		= _lines,
+	.nr_hist	= MAX_LINES,
+};
+
+static struct logger_driver_t capture_logger = CAPTURE_DRIVER("capture", capture_ops, _capture);
+
+struct logger_driver_t *adrivers[] = {
+	&capture_logger,
+	NULL,
+};
+
+static bool _seen[NR_THREADS][NR_THREAD_MSGS];
+
+static void *_producer(void *arg)
+{
+	int id = (int)(long)arg;
+
+	for (int i = 0; i < NR_THREAD_MSGS; i++) {
+		LOG_INFO("Thread %d message %d", id, i);
+	}
+	return NULL;
+}
+
+int main()
+{
+	pthread_t threads[NR_THREADS];
+	struct logger_drops_t drops;
+	int last[NR_THREADS];
+	unsigned markers = 0;
+	int msgs = 0;
+	int error = 0;
+
+	CHECK(logger_init() == 0);
+	CHECK(logger_start_async() == 0);
+	for (long i = 0; i < NR_THREADS; i++) {
+		pthread_create(&threads[i], NULL, _producer, (void *)i);
+	}
+	for (int i = 0; i < NR_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	logger_stop_async();
+	logger_flush();
+	logger_get_drops(&drops);
+
+	/* Every message shows up once, in the order of its thread */
+	for (int i = 0; i < NR_THREADS; i++) {
+		last[i] = -1;
+	}
+	CHECK(_capture.lines <= MAX_LINES);
+	for (int i = 0; i < _capture.lines && i < MAX_LINES; i++) {
+		const char *msg = strstr(_lines[i], ": Thread ");
+		int id = -1;
+		int nr = -1;
+
+		if (strstr(_lines[i], " messages dropped")) {
+			markers++;
+			continue;
+		}
+		if (!msg || sscanf(msg, ": Thread %d message %d", &id, &nr) != 2 ||
+		    id < 0 || id >= NR_THREADS || nr < 0 || nr >= NR_THREAD_MSGS) {
+			printf("Unexpected line '%s'\n", _lines[i]);
+			error = -1;
+			continue;
+		}
+		CHECK(!_seen[id][nr]);
+		CHECK(nr > last[id]);
+		_seen[id][nr] = true;
+		last[id] = nr;
+		msgs++;
+	}
+	CHECK(msgs + drops.msgs == NR_THREADS * NR_THREAD_MSGS);
+	CHECK(markers <= drops.msgs);
+	CHECK(_capture.lines == msgs + (int)markers);
+
+	logger_close();
+
+	printf("Async test: %d written, %llu dropped, %s\n", msgs, drops.msgs,
+	       error ? "FAILED" : "OK");
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "logger.h"
+#include "logger-bin.h"
+#include "test-common.h"
+
+#define NR_ROUNDS 200
+
+static struct logger_bin_ctxt_t _ctxt = {
+	.path	= "bin_test.bin",
+	.sync	= false,
+	.fd	= -1,
+};
+
+static char *_text;
+static size_t _text_len;
+static FILE *_text_out;
+
+/* Keeps what the text drivers get, to compare with the decoded file */
+static int _capture_writev(void *drv, const struct logger_iovec_t *iov, int cnt)
+{
+	(void)drv;
+	for (int i = 0; i < cnt; i++) {
+		fwrite(iov[i].base, 1, iov[i].len, _text_out);
+	}
+	return 0;
+}
+
+static const struct logger_ops_t text_ops = {
+	.init	= NULL,
+	.write	= NULL,
+	.read	= NULL,
+	.flush	= NULL,
+	.close	= NULL,
+	.writev	= _capture_writev,
+};
+
+static struct logger_driver_t capture_logger = {
+	.enabled	= true,
+	.name		= "capture",
+	.ops		= &text_ops,
+	.priv_data	= NULL,
+};
+
+struct logger_driver_t *adrivers[] = {
+	&capture_logger,
+	&bin_logger,
+	NULL,
+};
+
+/* Both sides have to see the same time stamps */
+static uint64_t _now = 1000000000ULL;
+
+uint64_t logger_clock_ns()
+{
+	return _now;
+}
+
+/**
+ * @brief  Decode the first len bytes of the binary file
+ */
+static int _decode(size_t len, enum logger_bin_output_t fmt, char **out, size_t *out_len)
+{
+	FILE *bin = fopen(_ctxt.path, "rb");
+	char *data = malloc(len);
+	int count = -1;
+
+	if (bin && data && fread(data, 1, len, bin) == len) {
+		FILE *in = fmemopen(data, len, "rb");
+		FILE *text = open_memstream(out, out_len);
+
+		count = logger_bin_decode(in, text, fmt, LOGGER_TS_UPTIME);
+		fclose(in);
+		fclose(text);
+	}
+
+	free(data);
+	if (bin) {
+		fclose(bin);
+	}
+	return count;
+}
+
+int main()
+{
+	struct logger_bin_ctxt_t *ctxt = &_ctxt;
+	const char *names[] = { "alpha", "", "a \"quoted\"\tname" };
+	struct stat st;
+	char *decoded = NULL;
+	size_t decoded_len = 0;
+	int error = 0;
+	int count = 0;
+
+	unlink(ctxt->path);
+	bin_logger.priv_data = ctxt;
+	_text_out = open_memstream(&_text, &_text_len);
+
+	logger_init();
+	logger_set_ts_format(LOGGER_TS_UPTIME);
+
+	for (int i = 0; i < NR_ROUNDS; i++) {
+		LOG_INFO("Round %d of %d, name %s", i, NR_ROUNDS, names[i % 3]);
+		_now += 1234567;
+		LOG_WARN("Value %5.2f %x %c %p", i / 7.0, i * 31, 'a' + i % 26,
+			 (void *)(uintptr_t)(i * 4096));
+		_now += 1000;
+		LOG_RAW("raw %ld\n", (long)i * -100000);
+		logger_log(LOG_LVL_OK, __FILE__, __FUNCTION__, __LINE__, "Dynamic %d", i);
+		if (i % 50 == 0) {
+			LOG_ERROR("Error %s %u", "in round", (unsigned)i);
+			count++;
+		}
+		LOG_INFO_KV("Round done", KV_INT("round", i), KV_STR("name", names[i % 3]),
+			    KV_DOUBLE("ratio", i / 7.0), KV_BOOL("even", i % 2 == 0));
+		count += 5;
+
+		if (i % 2 == 0) {
+			logger_flush();
+		}
+	}
+
+	logger_close();
+	logger_set_ts_format(LOGGER_TS_NONE);
+	fclose(_text_out);
+
+	CHECK(stat(ctxt->path, &st) == 0);
+	size_t bin_len = st.st_size;
+
+	/* Same text as the text drivers got */
+	CHECK(_decode(st.st_size, LOGGER_BIN_OUT_TEXT, &decoded, &decoded_len) == count);
+	CHECK(decoded_len == _text_len && !memcmp(decoded, _text, _text_len));
+	if (decoded_len != _text_len || memcmp(decoded, _text, _text_len)) {
+		for (size_t i = 0; i < decoded_len && i < _text_len; i++) {
+			if (decoded[i] != _text[i]) {
+				printf("First difference at %zu:\n%.80s\n%.80s\n", i, &_text[i],
+				       &decoded[i]);
+				break;
+			}
+		}
+	}
+	free(decoded);
+
+	/* JSON, one object per message */
+	CHECK(_decode(st.st_size, LOGGER_BIN_OUT_JSON, &decoded, &decoded_len) == count);
+	CHECK(strstr(decoded, "\"msg\":\"Round 2 of 200, name a \\\"quoted\\\"\\tname\"}\n"));
+	CHECK(strstr(decoded, "\"level\":\"WARN\",\"file\":\"bin_test.c\""));
+	CHECK(strstr(decoded, "\"time\":\"0.000000\""));
+	CHECK(strstr(decoded, "\"msg\":\"Round done\",\"round\":7,\"name\":\"\","
+			      "\"ratio\":1,\"even\":false}\n"));
+	free(decoded);
+
+	/* A record cut off by a crash ends the file, close() wrote a CLOCK record last */
+	size_t cut = bin_len - sizeof(struct logger_bin_rec_t) - sizeof(int64_t) - 3;
+	CHECK(_decode(cut, LOGGER_BIN_OUT_TEXT, &decoded, &decoded_len) == count - 1);
+	free(decoded);
+
+	/* Not a binary log */
+	FILE *garbage = fopen(ctxt->path, "wb");
+	fputs("[ INFO] (bin_test.c)(main @ 1) : text\r\n", garbage);
+	fclose(garbage);
+	CHECK(stat(ctxt->path, &st) == 0);
+	CHECK(_decode(st.st_size, LOGGER_BIN_OUT_TEXT, &decoded, &decoded_len) == -1);
+	free(decoded);
+
+	printf("Text: %zu bytes, binary: %zu bytes\n", _text_len, bin_len);
+	unlink(ctxt->path);
+	free(_text);
+
+	printf("Binary driver test: %s\n", error ? "FAILED" : "OK");
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
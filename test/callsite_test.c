@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+#include "test-common.h"
+
+static void _noisy(int i)
+{
+	LOG_DEBUG("Noisy debug line %d", i);
+}
+
+static void _quiet(int i)
+{
+	LOG_DEBUG("Quiet debug line %d", i);
+}
+
+static const struct logger_callsite_t *_find(const char *fmt)
+{
+	for (size_t i = 0; i < logger_callsite_count(); i++) {
+		const struct logger_callsite_t *cs = logger_callsite_get(i);
+		if (cs->fmt == fmt || !strcmp(cs->fmt, fmt)) {
+			return cs;
+		}
+	}
+	return NULL;
+}
+
+int main()
+{
+	const struct logger_callsite_t *noisy = NULL;
+	const struct logger_callsite_t *quiet = NULL;
+	int error = 0;
+
+	logger_init();
+
+	noisy = _find("Noisy debug line %d");
+	quiet = _find("Quiet debug line %d");
+	CHECK(noisy && quiet);
+	if (error) {
+		return EXIT_FAILURE;
+	}
+	CHECK(logger_callsite_get(logger_callsite_id(noisy)) == noisy);
+	CHECK(logger_callsite_id(noisy) != logger_callsite_id(quiet));
+	CHECK(noisy->lvl == LOG_LVL_DEBUG);
+
+	/* Level filtered out, only the forced callsite is written */
+	logger_set_loglvl(LOG_LVL_PRODUCTION);
+	CHECK(logger_callsite_set(quiet, LOGGER_CS_ON) == 0);
+	for (int i = 0; i < 3; i++) {
+		_noisy(i);
+		_quiet(i);
+	}
+	logger_flush();
+	CHECK(atomic_load(&noisy->state->hits) == 0);
+	CHECK(atomic_load(&quiet->state->hits) == 3);
+
+	/* Disable the whole file, regardless of the level */
+	logger_set_loglvl(LOG_LVL_EXTRA);
+	CHECK(logger_callsite_set_file("test/callsite_test.c", 0, LOGGER_CS_OFF) >= 2);
+	_noisy(3);
+	_quiet(3);
+	CHECK(atomic_load(&noisy->state->hits) == 0);
+	CHECK(atomic_load(&quiet->state->hits) == 3);
+
+	/* Back to following the level */
+	CHECK(logger_callsite_set_file("callsite_test.c", noisy->ln,
+				       LOGGER_CS_DEFAULT) == 1);
+	_noisy(4);
+	logger_flush();
+	CHECK(atomic_load(&noisy->state->hits) == 1);
+
+	logger_close();
+
+	printf("Callsite test: %s\n", error ? "FAILED" : "OK");
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "logger.h"
+#include "test-common.h"
+
+static char _small_mem[512];
+static struct capture_t _capture;
+
+static struct logger_driver_t capture_logger = CAPTURE_DRIVER("capture", capture_ops, _capture);
+
+static int _opened;
+
+static int _count_init(void *drv)
+{
+	(void)drv;
+	_opened++;
+	return 0;
+}
+
+static void _count_close(void *drv)
+{
+	(void)drv;
+	_opened--;
+}
+
+static int _fail_init(void *drv)
+{
+	(void)drv;
+	return -1;
+}
+
+static const struct logger_ops_t count_ops = {
+	.init	= _count_init,
+	.close	= _count_close,
+};
+
+static const struct logger_ops_t fail_ops = {
+	.init	= _fail_init,
+};
+
+static struct logger_driver_t count_logger = {
+	.enabled	= true,
+	.name		= "count",
+	.ops		= &count_ops,
+};
+
+static struct logger_driver_t fail_logger = {
+	.enabled	= false,
+	.name		= "fail",
+	.ops		= &fail_ops,
+};
+
+struct logger_driver_t *adrivers[] = {
+	&capture_logger,
+	&count_logger,
+	&fail_logger,
+	NULL,
+};
+
+static void *_producer(void *arg)
+{
+	(void)arg;
+	LOG_INFO("From a thread");
+	return NULL;
+}
+
+int main()
+{
+	struct logger_config_t cfg;
+	struct logger_stats_t stats;
+	pthread_t thread;
+	int error = 0;
+
+	/* Invalid configurations */
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.max_msg_len = LOGGER_MIN_MSG_LEN - 1;
+	CHECK(logger_init_ex(&cfg) == -1);
+	cfg.max_msg_len = MAX_STR_LEN + 1;
+	CHECK(logger_init_ex(&cfg) == -1);
+	cfg.max_msg_len = 0;
+	cfg.ring_size = 256;
+	CHECK(logger_init_ex(&cfg) == -1);
+	cfg.ring_size = 0;
+	cfg.thread_ring_size = 256;
+	CHECK(logger_init_ex(&cfg) == -1);
+	cfg.thread_ring_size = 0;
+	cfg.ring_mem = _small_mem;
+	cfg.ring_size = sizeof(_small_mem);
+	CHECK(logger_init_ex(&cfg) == -1);
+
+	/* A small daemon: 2 KiB ring, short messages */
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.ring_size = 2048;
+	cfg.max_msg_len = 32;
+	CHECK(logger_init_ex(&cfg) == 0);
+	logger_get_stats(&stats);
+	CHECK(stats.ring.size == 2048);
+
+	LOG_INFO("%s", "A message that is longer than thirty-one characters");
+	logger_flush();
+	CHECK(strstr(_capture.last, ": A message that is longer than t\r\n") != NULL);
+
+	/* Short messages need less room, more of them fit */
+	for (int i = 0; i < 8; i++) {
+		LOG_INFO("Message %d", i);
+	}
+	logger_get_stats(&stats);
+	CHECK(stats.drops.msgs == 0);
+	logger_flush();
+	CHECK(strstr(_capture.last, ": Message 7\r\n") != NULL);
+	logger_close();
+
+	/* The settings stay for the next logger_init() */
+	CHECK(logger_init() == 0);
+	logger_get_stats(&stats);
+	CHECK(stats.ring.size == 2048);
+	logger_close();
+
+	/* A busy service: 4 MiB ring, spill ring, larger thread rings */
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.ring_size = 4 * 1024 * 1024;
+	cfg.thread_ring_size = 64 * 1024;
+	cfg.overflow.mode = LOGGER_OVERFLOW_SPILL;
+	cfg.overflow.spill_size = 16384;
+	CHECK(logger_init_ex(&cfg) == 0);
+	for (int i = 0; i < 5000; i++) {
+		LOG_INFO("Burst %d", i);
+	}
+	logger_get_stats(&stats);
+	CHECK(stats.ring.size == 4 * 1024 * 1024);
+	CHECK(stats.spill.size == 16384);
+	CHECK(stats.drops.msgs == 0);
+
+	char long_msg[MAX_STR_LEN];
+	memset(long_msg, 'x', sizeof(long_msg) - 1);
+	long_msg[sizeof(long_msg) - 1] = '\0';
+	logger_flush();
+	LOG_INFO("%s", long_msg);
+	logger_flush();
+	CHECK(strstr(_capture.last, long_msg) != NULL);
+
+	CHECK(logger_start_async() == 0);
+	pthread_create(&thread, NULL, _producer, NULL);
+	pthread_join(thread, NULL);
+	logger_get_stats(&stats);
+	CHECK(stats.nr_threads == 1 && stats.threads.size == 64 * 1024);
+	logger_stop_async();
+	logger_close();
+
+	/* The spill ring comes back with the next logger_init() */
+	CHECK(logger_init() == 0);
+	logger_get_stats(&stats);
+	CHECK(stats.spill.size == 16384);
+	logger_close();
+
+	/* A driver that fails to start leaves nothing open */
+	fail_logger.enabled = true;
+	CHECK(logger_init() == -1);
+	CHECK(_opened == 0);
+	logger_get_stats(&stats);
+	CHECK(stats.ring.size == 0 && stats.spill.size == 0);
+	fail_logger.enabled = false;
+	CHECK(logger_init() == 0);
+	CHECK(_opened == 1);
+	logger_get_stats(&stats);
+	CHECK(stats.ring.size == 4 * 1024 * 1024 && stats.spill.size == 16384);
+	logger_close();
+	CHECK(_opened == 0);
+
+	/* Back to the build time defaults */
+	memset(&cfg, 0, sizeof(cfg));
+	CHECK(logger_init_ex(&cfg) == 0);
+	logger_get_stats(&stats);
+	CHECK(stats.ring.size == CFG_RING_SIZE && stats.spill.size == 0);
+	logger_close();
+
+	printf("Config test: %s\n", error ? "FAILED" : "OK");
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "logger-deferred.h"
+
+static int _errors;
+
+/* Packs the arguments, renders them and compares with vsnprintf() */
+static void _check(const char *fmt, ...)
+{
+	char packed[512];
+	char expect[512];
+	char got[512];
+	va_list va, va_ref;
+	int len = 0;
+
+	va_start(va, fmt);
+	va_copy(va_ref, va);
+	vsnprintf(expect, sizeof(expect), fmt, va_ref);
+	va_end(va_ref);
+	len = logger_deferred_pack(fmt, packed, sizeof(packed), va);
+	va_end(va);
+
+	if (len < 0) {
+		printf("'%s': not packed\n", fmt);
+		_errors++;
+		return;
+	}
+	logger_deferred_render(got, sizeof(got), fmt, packed, len);
+	if (strcmp(expect, got)) {
+		printf("'%s': expected '%s' got '%s'\n", fmt, expect, got);
+		_errors++;
+	}
+}
+
+static int _pack(void *buf, size_t len, const char *fmt, ...)
+{
+	va_list va;
+	int ret = 0;
+
+	va_start(va, fmt);
+	ret = logger_deferred_pack(fmt, buf, len, va);
+	va_end(va);
+	return ret;
+}
+
+int main()
+{
+	char str[16] = "copied";
+	char packed[64];
+	char got[64];
+
+	/* Integers, widths and flags */
+	_check("%d %i %u", -42, 17, 42u);
+	_check("[%5d] [%-5d] [%05d] [%+d] [% d]", 42, 42, 42, 42, 42);
+	_check("%x %X %#x %#o %o", 0xbeef, 0xbeef, 0xbeef, 8, 8);
+	_check("[%*d] [%-*d]", 6, 7, 6, 7);
+	_check("%hd %hhu", (short)-3, (unsigned char)200);
+	_check("%ld %lu %lx", -1L, 1UL << 40, 0xdeadbeefUL);
+	_check("%lld %llu %llx", -(1LL << 50), 18446744073709551615ULL, 1ULL << 63);
+	_check("%zu %zd %td", sizeof(long), (ssize_t)-5, (ptrdiff_t)-6);
+	_check("%jd %ju", (intmax_t)-7, (uintmax_t)7);
+
+	/* Precision */
+	_check("[%.3d] [%8.3d] [%-8.3x]", 5, 5, 5);
+	_check("%f %.0f %.3f %10.2f %-10.2f|", 3.14159, 2.5, 1.0005, -1.5, 1.5);
+	_check("%e %.3E %g %G %.10g", 1e-5, 123456.0, 1e20, 1e-20, 1.0 / 3);
+	_check("[%*.*f]", 10, 2, 1.005);
+	_check("%a", 1.0);
+
+	/* Strings and characters */
+	_check("'%s' '%10s' '%-10s' '%.2s' '%10.3s'", "abc", "abc", "abc", "abc", "abcdef");
+	_check("'%.*s'", 3, "abcdef");
+	_check("%s", "");
+	_check("%c%c%c [%3c] [%-3c]", 'a', 'b', 'c', 'x', 'y');
+	_check("%s", (char *)NULL);
+
+	/* Pointers and literals */
+	_check("%p %p", (void *)&str, (void *)NULL);
+	_check("100%% %d%%", 5);
+	_check("no conversions");
+
+	/* Strings are copied, not referenced */
+	int len = _pack(packed, sizeof(packed), "%s!", str);
+	strcpy(str, "overwritten");
+	logger_deferred_render(got, sizeof(got), "%s!", packed, len);
+	if (strcmp(got, "copied!")) {
+		printf("'%%s' not copied: '%s'\n", got);
+		_errors++;
+	}
+
+	printf("Deferred formatting test: %s\n", _errors ? "FAILED" : "OK");
+	return _errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+#include "test-common.h"
+
+static struct capture_t _mem;
+static struct capture_t _uart;
+static struct capture_t _ent;
+
+/* Everything, in RAM */
+static struct logger_driver_t mem_logger = CAPTURE_DRIVER("memory", capture_ops, _mem);
+
+/* A slow console, warnings and errors only */
+static struct logger_driver_t uart_logger = {
+	.enabled	= true,
+	.name		= "uart",
+	.ops		= &capture_ops,
+	.priv_data	= &_uart,
+	.loglvl		= LOG_LVL_WARN | LOG_LVL_ERROR,
+};
+
+/* Errors only, unrendered */
+static struct logger_driver_t ent_logger = {
+	.enabled	= true,
+	.name		= "entries",
+	.ops		= &capture_entries_ops,
+	.priv_data	= &_ent,
+	.loglvl		= LOG_LVL_ERROR,
+};
+
+struct logger_driver_t *adrivers[] = {
+	&mem_logger,
+	&uart_logger,
+	&ent_logger,
+	NULL,
+};
+
+static void _reset(void)
+{
+	capture_reset(&_mem);
+	capture_reset(&_uart);
+	capture_reset(&_ent);
+}
+
+int main()
+{
+	struct logger_stats_t stats;
+	int error = 0;
+
+	CHECK(logger_init() == 0);
+	logger_set_loglvl(LOG_LVL_EXTRA);
+	logger_flush();
+	CHECK(logger_get_driver_loglvl(&mem_logger) == LOG_LVL_EXTRA);
+	CHECK(logger_get_driver_loglvl(&uart_logger) == (LOG_LVL_WARN | LOG_LVL_ERROR));
+
+	/* Every driver gets its own levels */
+	_reset();
+	LOG_DEBUG("debug %d", 1);
+	LOG_WARN("warn %d", 2);
+	logger_flush();
+	CHECK(_mem.lines == 2);
+	CHECK(_uart.lines == 1);
+	CHECK(strstr(_uart.last, ": warn 2\r\n") != NULL);
+	CHECK(_ent.lines == 0);
+
+	LOG_ERROR("error %d", 3);
+	logger_flush();
+	CHECK(_mem.lines == 3 && _uart.lines == 2 && _ent.lines == 1);
+	CHECK(_ent.lvl == LOG_LVL_ERROR);
+
+	/* A level no driver wants is not even formatted */
+	_reset();
+	CHECK(logger_set_driver_loglvl(&mem_logger, LOG_LVL_WARN) == 0);
+	logger_get_stats(&stats);
+	unsigned long long debug_msgs = stats.levels[logger_mask2id(LOG_LVL_DEBUG)].msgs;
+	LOG_DEBUG("debug %d", test_side_effect());
+	LOG_INFO("info %d", test_side_effect());
+	LOG_WARN("warn %d", test_side_effect());
+	logger_flush();
+	logger_get_stats(&stats);
+	CHECK(test_evaluated == 1);
+	CHECK(stats.levels[logger_mask2id(LOG_LVL_DEBUG)].msgs == debug_msgs);
+	CHECK(_mem.lines == 1 && _uart.lines == 1);
+	CHECK(strstr(_mem.last, ": warn 1\r\n") != NULL);
+
+	/* 0 is every level again */
+	CHECK(logger_set_driver_loglvl(&mem_logger, LOG_LVL_NONE) == 0);
+	CHECK(logger_get_driver_loglvl(&mem_logger) == LOG_LVL_EXTRA);
+	LOG_DEBUG("debug %d", test_side_effect());
+	logger_flush();
+	CHECK(strstr(_mem.last, ": debug 2\r\n") != NULL);
+
+	/* Switched off directly: stored, but released unrendered */
+	_reset();
+	mem_logger.enabled = false;
+	for (int i = 0; i < 10; i++) {
+		LOG_DEBUG("debug %d", i);
+	}
+	LOG_WARN("%s", "after the burst");
+	logger_flush();
+	CHECK(_mem.lines == 0 && _uart.lines == 1 && _ent.lines == 0);
+	CHECK(strstr(_uart.last, ": after the burst\r\n") != NULL);
+	logger_get_stats(&stats);
+	CHECK(stats.ring.used == 0);
+	mem_logger.enabled = true;
+
+	/* Switched off through the logger: a level only it wants isn't formatted */
+	_reset();
+	CHECK(logger_set_driver_enabled(&mem_logger, false) == 0);
+	logger_get_stats(&stats);
+	debug_msgs = stats.levels[logger_mask2id(LOG_LVL_DEBUG)].msgs;
+	LOG_DEBUG("debug %d", test_side_effect());
+	LOG_WARN("warn %d", test_side_effect());
+	logger_flush();
+	logger_get_stats(&stats);
+	CHECK(test_evaluated == 3);
+	CHECK(stats.levels[logger_mask2id(LOG_LVL_DEBUG)].msgs == debug_msgs);
+	CHECK(_mem.lines == 0 && _uart.lines == 1);
+	CHECK(strstr(_uart.last, ": warn 3\r\n") != NULL);
+	CHECK(logger_set_driver_enabled(&mem_logger, true) == 0);
+	LOG_DEBUG("debug %d", test_side_effect());
+	logger_flush();
+	CHECK(strstr(_mem.last, ": debug 4\r\n") != NULL);
+	CHECK(logger_set_driver_enabled(NULL, true) == -1);
+
+	CHECK(logger_set_driver_loglvl(NULL, LOG_LVL_WARN) == -1);
+	CHECK(logger_set_driver_loglvl(&mem_logger, 0x100) == -1);
+	CHECK(logger_get_driver_loglvl(NULL) == LOG_LVL_NONE);
+
+	logger_close();
+
+	printf("Driver level test: %s\n", error ? "FAILED" : "OK");
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "logger-file.h"
+
+#define NR_MESSAGES 100
+#define FLUSH_EVERY 15
+
+static struct logger_file_ctxt_t _ctxt = {
+	.path	= "file_test.log",
+	.sync	= false,
+	.fd	= -1,
+};
+
+int main()
+{
+	char line[512];
+	int error = 0;
+	int nr = 0;
+
+	unlink(_ctxt.path);
+	file_logger.priv_data = &_ctxt;
+	logger_init();
+
+	for (int i = 0; i < NR_MESSAGES; i++) {
+		LOG_INFO("Message %d of %d, %s", i, NR_MESSAGES, "file driver");
+		if (i % FLUSH_EVERY == FLUSH_EVERY - 1) {
+			logger_flush();
+		}
+	}
+	logger_flush();
+	logger_close();
+
+	FILE *fp = fopen(_ctxt.path, "r");
+	if (!fp) {
+		printf("Failed to open %s\n", _ctxt.path);
+		return EXIT_FAILURE;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		char expected[64];
+
+		snprintf(expected, sizeof(expected), ": Message %d of %d, file driver\r\n",
+			 nr, NR_MESSAGES);
+		if (!strstr(line, expected)) {
+			printf("Line %d: unexpected '%s'\n", nr, line);
+			error = -1;
+			break;
+		}
+		nr++;
+	}
+	fclose(fp);
+
+	if (nr != NR_MESSAGES) {
+		printf("Expected %d lines, got %d\n", NR_MESSAGES, nr);
+		error = -1;
+	}
+
+	printf("File driver test: %s\n", error ? "FAILED" : "OK");
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "test-common.h"
+
+static struct capture_t _count;
+static bool _reenter;
+
+static int _reenter_write(void *drv, char *str)
+{
+	capture_write(drv, str);
+	if (_reenter) {
+		/* Must neither deadlock nor nest a drain */
+		_reenter = false;
+		LOG_WARN("From the driver");
+		logger_flush();
+	}
+	return 0;
+}
+
+static const struct logger_ops_t count_ops = {
+	.init	= NULL,
+	.write	= _reenter_write,
+	.read	= NULL,
+	.flush	= capture_flush,
+	.close	= NULL,
+};
+
+static struct logger_driver_t count_logger = CAPTURE_DRIVER("count", count_ops, _count);
+
+struct logger_driver_t *adrivers[] = {
+	&count_logger,
+	NULL,
+};
+
+static void _log_n(int n)
+{
+	for (int i = 0; i < n; i++) {
+		LOG_INFO("Message %d", i);
+	}
+}
+
+int main()
+{
+	struct logger_flush_policy_t policy = { 0 };
+	int error = 0;
+
+	logger_init();
+
+	/* Default: one flush per logger_flush() */
+	_log_n(5);
+	logger_flush();
+	CHECK(_count.writes == 5 && _count.flushes == 1);
+	logger_flush();
+	CHECK(_count.flushes == 1);
+
+	/* Message threshold, checked once per written batch */
+	policy.msgs = 8;
+	CHECK(logger_set_flush_policy(&policy) == 0);
+	_log_n(5);
+	logger_flush();
+	CHECK(_count.flushes == 1);
+	_log_n(5);
+	logger_flush();
+	CHECK(_count.flushes == 2);
+
+	/* ERROR messages are flushed right away */
+	policy.msgs = 0;
+	policy.bytes = 1 << 20;
+	policy.on_error = true;
+	CHECK(logger_set_flush_policy(&policy) == 0);
+	_log_n(1);
+	logger_flush();
+	CHECK(_count.flushes == 2);
+	LOG_ERROR("Something failed");
+	logger_flush();
+	CHECK(_count.flushes == 3);
+
+	/* Time window */
+	policy.bytes = 0;
+	policy.interval_ms = 50;
+	CHECK(logger_set_flush_policy(&policy) == 0);
+	_log_n(1);
+	logger_flush();
+	CHECK(_count.flushes == 3);
+	usleep(60 * 1000);
+	logger_flush();
+	CHECK(_count.flushes == 4);
+
+	/* A driver that logs and flushes, the ongoing drain writes its message */
+	_reenter = true;
+	_log_n(1);
+	logger_flush();
+	CHECK(_count.writes == 20);
+
+	/* Close always flushes pending output */
+	_log_n(1);
+	logger_flush();
+	CHECK(_count.flushes == 4);
+	logger_close();
+	CHECK(_count.flushes == 5);
+	CHECK(_count.writes == 21);
+
+	printf("Flush policy test: %s\n", error ? "FAILED" : "OK");
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
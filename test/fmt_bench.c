@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "logger.h"
+#include "logger-fmt.h"
+
+#define NR_ITERATIONS 200000
+#define NR_ROUNDS 5
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+static volatile size_t _sink;
+static int _mismatches;
+
+static double _now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Both go through a va_list, like logger_log() does */
+static size_t _libc_body(const char *fmt, ...)
+{
+	char str[MAX_STR_LEN];
+	va_list va;
+	int len;
+
+	va_start(va, fmt);
+	len = vsnprintf(str, sizeof(str), fmt, va);
+	va_end(va);
+	return len;
+}
+
+static size_t _fast_body(const char *fmt, ...)
+{
+	char str[MAX_STR_LEN];
+	va_list va;
+	int len;
+
+	va_start(va, fmt);
+	len = logger_fmt_vformat(str, sizeof(str), fmt, va);
+	va_end(va);
+	return len;
+}
+
+static size_t _compare_body(const char *fmt, ...)
+{
+	char libc_str[MAX_STR_LEN];
+	char fast_str[MAX_STR_LEN];
+	va_list va;
+	va_list vc;
+
+	va_start(va, fmt);
+	va_copy(vc, va);
+	vsnprintf(libc_str, sizeof(libc_str), fmt, va);
+	logger_fmt_vformat(fast_str, sizeof(fast_str), fmt, vc);
+	va_end(vc);
+	va_end(va);
+
+	if (strcmp(libc_str, fast_str)) {
+		printf("Mismatch: '%s' != '%s'\n", libc_str, fast_str);
+		_mismatches++;
+	}
+	return 0;
+}
+
+static size_t _libc_header(int i)
+{
+	char str[MAX_STR_LEN];
+	int id = i % 5;
+
+	return snprintf(str, 128, "[%s%5s%s] (%20s)(%30s @%3d) : ",
+			_log_levels[id].color, _log_levels[id].name, RESET,
+			"logger_v3_test.c", "main", i & 1023);
+}
+
+static size_t _fast_header(int i)
+{
+	char str[MAX_STR_LEN];
+
+	return logger_fmt_header(str, 128, _log_levels[i % 5].mask,
+				 "logger_v3_test.c", "main", i & 1023);
+}
+
+static size_t _compare_header(int i)
+{
+	char libc_str[MAX_STR_LEN];
+	char fast_str[MAX_STR_LEN];
+	int id = i % 5;
+
+	snprintf(libc_str, 128, "[%s%5s%s] (%20s)(%30s @%3d) : ",
+		 _log_levels[id].color, _log_levels[id].name, RESET,
+		 "logger_v3_test.c", "main", i & 1023);
+	logger_fmt_header(fast_str, 128, _log_levels[id].mask,
+			  "logger_v3_test.c", "main", i & 1023);
+
+	if (strcmp(libc_str, fast_str)) {
+		printf("Mismatch: '%s' != '%s'\n", libc_str, fast_str);
+		_mismatches++;
+	}
+	return 0;
+}
+
+/* A few typical message bodies */
+#define BODIES(F, i) \
+	do { \
+		_sink += F("Starting worker %d of %d", (i) & 7, 8); \
+		_sink += F("req %u from %s took %u us", (i), "10.0.0.1", (i) * 7u); \
+		_sink += F("reg 0x%08x = 0x%x @%p", (i), (i) >> 3, (void *)&_sink); \
+		_sink += F("temperature %.2f C, load %5.1f%%", (i) / 1000.0, \
+			   ((i) % 1000) / 10.0); \
+		_sink += F("Connection closed by peer"); \
+	} while (0)
+
+#define NR_BODIES 5
+
+int main()
+{
+	double start, libc_hdr, fast_hdr, libc_body, fast_body, speedup;
+
+	logger_init();
+
+	for (int i = 0; i < 10000; i++) {
+		_compare_header(i);
+		BODIES(_compare_body, i);
+	}
+
+	/* Best of a few rounds, to filter out noise of other processes */
+	libc_hdr = fast_hdr = libc_body = fast_body = 1e9;
+	for (int round = 0; round < NR_ROUNDS; round++) {
+		start = _now();
+		for (int i = 0; i < NR_ITERATIONS; i++) {
+			_sink += _libc_header(i);
+		}
+		libc_hdr = MIN(libc_hdr, (_now() - start) * 1e9 / NR_ITERATIONS);
+
+		start = _now();
+		for (int i = 0; i < NR_ITERATIONS; i++) {
+			_sink += _fast_header(i);
+		}
+		fast_hdr = MIN(fast_hdr, (_now() - start) * 1e9 / NR_ITERATIONS);
+
+		start = _now();
+		for (int i = 0; i < NR_ITERATIONS / NR_BODIES; i++) {
+			BODIES(_libc_body, i);
+		}
+		libc_body = MIN(libc_body, (_now() - start) * 1e9 / NR_ITERATIONS);
+
+		start = _now();
+		for (int i = 0; i < NR_ITERATIONS / NR_BODIES; i++) {
+			BODIES(_fast_body, i);
+		}
+		fast_body = MIN(fast_body, (_now() - start) * 1e9 / NR_ITERATIONS);
+	}
+
+	logger_close();
+
+	speedup = (libc_hdr + libc_body) / (fast_hdr + fast_body);
+	printf("header: snprintf %6.1f ns, logger_fmt %6.1f ns (%.1fx)\n",
+	       libc_hdr, fast_hdr, libc_hdr / fast_hdr);
+	printf("body:   snprintf %6.1f ns, logger_fmt %6.1f ns (%.1fx)\n",
+	       libc_body, fast_body, libc_body / fast_body);
+	printf("line:   snprintf %6.1f ns, logger_fmt %6.1f ns (%.1fx)\n",
+	       libc_hdr + libc_body, fast_hdr + fast_body, speedup);
+
+	/* The timings are for information only, they depend on the machine and its load */
+	printf("Formatter benchmark: %d mismatches, %s\n", _mismatches,
+	       _mismatches ? "FAILED" : "OK");
+	return _mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
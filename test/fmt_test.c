@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <float.h>
+
+#include "logger.h"
+#include "logger-fmt.h"
+
+static int _errors;
+static int _checks;
+
+#define CHECK_FMT(size, fmt, ...) \
+	do { \
+		char _exp[512]; \
+		char _got[512]; \
+		memset(_exp, 'X', sizeof(_exp)); \
+		memset(_got, 'X', sizeof(_got)); \
+		int _e = snprintf(_exp, size, fmt, ## __VA_ARGS__); \
+		int _g = logger_fmt_format(_got, size, fmt, ## __VA_ARGS__); \
+		_checks++; \
+		if (_e != _g || memcmp(_exp, _got, sizeof(_exp))) { \
+			printf("'%s' (size %d): expected %d '%s', got %d '%s'\n", \
+			       fmt, (int)(size), _e, _exp, _g, _got); \
+			_errors++; \
+		} \
+	} while (0)
+
+static const char *_int_fmts[] = {
+	"%d", "%5d", "%-5d|", "%05d", "%+d", "% d", "%.3d", "%8.3d", "%-8.3d|",
+	"%.0d", "%3.0d", "%+05d", "%i", "%u", "%x", "%X", "%#x", "%#X", "%08x",
+	"%#08x", "%o", "%#o", "%#.0o", "%.0x", "%-#10x|", "%hhd", "%hd", "%hhu",
+	"%hx", "%c",
+};
+
+static const char *_long_fmts[] = {
+	"%ld", "%lu", "%lx", "%20ld", "%-20lu|", "%lo",
+};
+
+static const char *_llong_fmts[] = {
+	"%lld", "%llu", "%llx", "%#llX", "%025lld",
+};
+
+static const char *_float_fmts[] = {
+	"%f", "%.0f", "%.1f", "%.2f", "%.3f", "%.9f", "%12.4f", "%-12.4f|",
+	"%012.4f", "%+f", "% f", "%+.0f", "%F", "%#.0f", "%.12f", "%e", "%g",
+};
+
+static const char *_str_fmts[] = {
+	"%s", "%10s", "%-10s|", "%.2s", "%10.2s", "%.0s", "%.10s",
+};
+
+static const int _ints[] = {
+	0, 1, -1, 7, 42, -42, 99, 100, 255, 4096, 65535, 123456789, INT_MAX,
+	INT_MIN,
+};
+
+static const long long _llongs[] = {
+	0, 1, -1, 1LL << 40, -(1LL << 40), LLONG_MAX, LLONG_MIN, 1000000000000LL,
+};
+
+static const double _doubles[] = {
+	0.0, -0.0, 1.0, -1.0, 0.5, 1.5, 2.5, -2.5, 0.125, 0.05, 0.15, 0.25,
+	0.35, 1.005, 2.675, 3.14159265358979, 1e-5, -1e-5, 123456.789,
+	9999999.9999999, 1e15, 1e17, 1e300, -1e300, DBL_MIN, DBL_MAX,
+	0.1 + 0.2, 1.0 / 3.0, 2.0 / 3.0, 999999.9999995, 0.0000005, 0.0000015,
+};
+
+/* Not a literal, the compiler would warn about the truncation being tested */
+static char _trunc_fmt[] = "int %d, str '%10s', float %.3f";
+
+static void _test_random_doubles(void)
+{
+	char fmt[8];
+
+	srand(1234);
+	for (int i = 0; i < 200000; i++) {
+		double scale = (double)(1ULL << (rand() % 40));
+		double v = ((double)rand() / RAND_MAX - 0.5) * scale;
+		int prec = rand() % 10;
+
+		if (i & 1) {
+			/* Values around a rounding tie */
+			v = (double)(rand() % 100000) / 1000.0 + 0.0005;
+			prec = 3;
+		}
+		snprintf(fmt, sizeof(fmt), "%%.%df", prec);
+		CHECK_FMT(64, fmt, v);
+	}
+}
+
+int main()
+{
+	char fmt[64];
+	int nr;
+
+	logger_init();
+
+	nr = sizeof(_int_fmts) / sizeof(_int_fmts[0]);
+	for (int i = 0; i < nr; i++) {
+		for (size_t j = 0; j < sizeof(_ints) / sizeof(_ints[0]); j++) {
+			CHECK_FMT(64, _int_fmts[i], _ints[j]);
+		}
+	}
+
+	nr = sizeof(_long_fmts) / sizeof(_long_fmts[0]);
+	for (int i = 0; i < nr; i++) {
+		for (size_t j = 0; j < sizeof(_llongs) / sizeof(_llongs[0]); j++) {
+			CHECK_FMT(64, _long_fmts[i], (long)_llongs[j]);
+		}
+	}
+
+	nr = sizeof(_llong_fmts) / sizeof(_llong_fmts[0]);
+	for (int i = 0; i < nr; i++) {
+		for (size_t j = 0; j < sizeof(_llongs) / sizeof(_llongs[0]); j++) {
+			CHECK_FMT(64, _llong_fmts[i], _llongs[j]);
+		}
+	}
+
+	nr = sizeof(_float_fmts) / sizeof(_float_fmts[0]);
+	for (int i = 0; i < nr; i++) {
+		for (size_t j = 0; j < sizeof(_doubles) / sizeof(_doubles[0]); j++) {
+			CHECK_FMT(512, _float_fmts[i], _doubles[j]);
+		}
+	}
+	_test_random_doubles();
+
+	nr = sizeof(_str_fmts) / sizeof(_str_fmts[0]);
+	for (int i = 0; i < nr; i++) {
+		CHECK_FMT(64, _str_fmts[i], "abcdef");
+		CHECK_FMT(64, _str_fmts[i], "");
+		CHECK_FMT(64, _str_fmts[i], (char *)NULL);
+	}
+
+	/* Mixed, '*' arguments, pointers, fallback and truncation */
+	CHECK_FMT(64, "%*d|%-*d|%.*f|%*.*s", 6, 42, 6, 42, 3, 1.25, 8, 2, "abc");
+	CHECK_FMT(64, "%*d|%.*d", -6, 42, -3, 7);
+	CHECK_FMT(64, "%p %10p %-10p|", (void *)0x1234, (void *)0xbeef, (void *)0x1);
+	CHECK_FMT(64, "%p %10p", NULL, NULL);
+	CHECK_FMT(64, "%zu %zd %zx %td %jd", (size_t)12345, (size_t)-5, (size_t)255,
+		  (ptrdiff_t)-7, (intmax_t)-9);
+	CHECK_FMT(64, "100%% done, %d%%", 5);
+	CHECK_FMT(64, "%d %e %s %5.1f", 1, 1.5e10, "after fallback", 2.25);
+	CHECK_FMT(64, "%d %Lf %d", 1, (long double)2.5, 3);
+	CHECK_FMT(64, "no conversions at all");
+	CHECK_FMT(64, "trailing %s", "%");
+	for (int size = 0; size < 40; size++) {
+		CHECK_FMT(size, _trunc_fmt, -12345, "abc", 3.14159);
+	}
+
+	/* Header against the original snprintf */
+	for (size_t j = 0; j < 6; j++) {
+		int lvl = _log_levels[j].mask;
+		const char *long_name = "a_rather_long_function_name_that_does_not_fit";
+
+		snprintf(fmt, sizeof(fmt), "%s", "file.c");
+		for (int size = 1; size < 140; size += 7) {
+			char exp[256];
+			char got[256];
+			int e = snprintf(exp, size, "[%s%5s%s] (%20s)(%30s @%3d) : ",
+					 _log_levels[j].color, _log_levels[j].name, RESET,
+					 fmt, long_name, 1234);
+			size_t g = logger_fmt_header(got, size, lvl, fmt, long_name, 1234);
+
+			_checks++;
+			if (strcmp(exp, got) || g != ((size_t)e < (size_t)size ? (size_t)e :
+						      (size_t)size - 1)) {
+				printf("Header (size %d): expected '%s', got '%s'\n", size,
+				       exp, got);
+				_errors++;
+			}
+		}
+	}
+
+	logger_close();
+
+	printf("Formatter test: %d checks, %s\n", _checks, _errors ? "FAILED" : "OK");
+	return _errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
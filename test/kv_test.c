@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "logger.h"
+#include "test-common.h"
+
+static struct capture_t _capture;
+static struct capture_t _entries;
+
+static struct logger_driver_t capture_logger = CAPTURE_DRIVER("capture", capture_ops, _capture);
+static struct logger_driver_t entries_logger = CAPTURE_DRIVER("entries", capture_entries_ops, _entries);
+
+struct logger_driver_t *adrivers[] = {
+	&capture_logger,
+	&entries_logger,
+	NULL,
+};
+
+static void _request(int id, const char *state)
+{
+	LOG_INFO_KV("request done", KV_INT("id", id), KV_STR("state", state),
+		    KV_UINT("bytes", 4096), KV_DOUBLE("ms", 1.5), KV_BOOL("cached", true));
+}
+
+int main()
+{
+	char line[512];
+	int error = 0;
+
+	CHECK(logger_init() == 0);
+	logger_set_loglvl(LOG_LVL_EXTRA);
+	CHECK(logger_get_kv_format() == LOGGER_KV_TEXT);
+
+	/* The fields follow the message in the text layout */
+	_request(-7, "up");
+	logger_flush();
+	CHECK(strstr(_capture.last, " kv_test.c)(") != NULL && strstr(_capture.last, " _request @ ") != NULL);
+	CHECK(strstr(_capture.last, ": request done id=-7 state=up bytes=4096 ms=1.5 cached=true\r\n") != NULL);
+
+	/* The entry drivers get the fields as they are stored */
+	CHECK(_entries.last_ent.type == LOGGER_ENTRY_KV);
+	CHECK(!strcmp(_entries.last_ent.cs->fmt, "request done"));
+	struct logger_kv_line_t kv = {
+		.time	= NULL,
+		.lvl	= LOG_LVL_INFO,
+		.file	= "x.c",
+		.fn	= "fn",
+		.ln	= 1,
+		.msg	= "msg",
+	};
+	logger_kv_render(line, sizeof(line), LOGGER_KV_LOGFMT, &kv,
+			 _entries.last_ent.data, _entries.last_ent.len);
+	CHECK(!strcmp(line, "level=INFO file=x.c function=fn line=1 msg=msg id=-7 state=up "
+			    "bytes=4096 ms=1.5 cached=true"));
+
+	/* logfmt quotes where needed */
+	CHECK(logger_set_kv_format(LOGGER_KV_LOGFMT) == 0);
+	_request(1, "two words \"quoted\"");
+	logger_flush();
+	CHECK(strstr(_capture.last, "level=INFO file=kv_test.c function=_request line=") == _capture.last);
+	CHECK(strstr(_capture.last, " msg=\"request done\" id=1 state=\"two words \\\"quoted\\\"\" bytes=4096"));
+
+	/* Keys are quoted too, built-in names get a prefix */
+	LOG_INFO_KV("keys", KV_INT("a b", 1), KV_STR("msg", "mine"), KV_BOOL("level", false));
+	logger_flush();
+	CHECK(strstr(_capture.last, " msg=keys \"a b\"=1 fields.msg=mine fields.level=false\r\n"));
+
+	/* One JSON object per line, with the time stamp */
+	CHECK(logger_set_kv_format(LOGGER_KV_JSON) == 0);
+	logger_set_ts_format(LOGGER_TS_UPTIME);
+	LOG_WARN_KV("odd values", KV_STR("null", NULL), KV_STR("ctrl", "a\tb\n"),
+		    KV_DOUBLE("nan", NAN), KV_UINT("max", 18446744073709551615ULL));
+	logger_flush();
+	CHECK(!strncmp(_capture.last, "{\"time\":\"", 9));
+	CHECK(strstr(_capture.last, "\",\"level\":\"WARN\",\"file\":\"kv_test.c\",\"function\":\"main\",\"line\":"));
+	CHECK(strstr(_capture.last, ",\"msg\":\"odd values\",\"null\":null,\"ctrl\":\"a\\tb\\n\",\"nan\":null,"
+			    "\"max\":18446744073709551615}\r\n"));
+	LOG_INFO_KV("keys", KV_INT("line", 7), KV_STR("time", "now"), KV_INT("a\"b", 2));
+	logger_flush();
+	CHECK(strstr(_capture.last, ",\"msg\":\"keys\",\"fields.line\":7,\"fields.time\":\"now\","
+			    "\"a\\\"b\":2}\r\n"));
+	logger_set_ts_format(LOGGER_TS_NONE);
+	CHECK(logger_set_kv_format(LOGGER_KV_JSON + 1) == -1);
+	CHECK(logger_set_kv_format(LOGGER_KV_TEXT) == 0);
+
+	/* Long strings are cut to the message length */
+	char big[2 * MAX_STR_LEN];
+	memset(big, 'x', sizeof(big) - 1);
+	big[sizeof(big) - 1] = '\0';
+	LOG_ERROR_KV("big", KV_STR("s", big), KV_INT("after", 1));
+	logger_flush();
+	CHECK(strstr(_capture.last, ": big s=xxxx") != NULL);
+	CHECK(strstr(_capture.last, "after=") == NULL);
+	CHECK(_entries.last_ent.len <= MAX_STR_LEN);
+
+	/* The text layout has no members to collide with */
+	LOG_INFO_KV("text", KV_INT("msg", 1), KV_INT("a=b", 2));
+	logger_flush();
+	CHECK(strstr(_capture.last, ": text msg=1 \"a=b\"=2\r\n") != NULL);
+
+	/* Nothing is evaluated for an inactive callsite */
+	logger_set_loglvl(LOG_LVL_ERROR);
+	LOG_INFO_KV("skipped", KV_INT("n", test_side_effect()));
+	logger_set_loglvl(LOG_LVL_EXTRA);
+	LOG_INFO_KV("done", KV_INT("n", test_side_effect()));
+	logger_flush();
+	CHECK(test_evaluated == 1);
+	CHECK(strstr(_capture.last, ": done n=1\r\n") != NULL);
+
+	logger_close();
+
+	printf("KV test: %s\n", error ? "FAILED" : "OK");
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "logger-file.h"
+
+/*
+ * End-to-end logger benchmark. Every result is printed as one JSON object
+ * per line: {"bench":..., "mode":..., "value":..., "unit":...}. Timings are
+ * the best of NR_ROUNDS rounds, latencies include the cost of reading the
+ * clock.
+ */
+
+#define NR_ROUNDS 5
+#define NR_CALLS 32000
+#define NR_FILTERED 1000000
+#define NR_FLUSHES 2000
+#define NR_STEADY 20000
+#define NR_BURSTS 200
+
+/* Messages logged between two flushes, has to fit in the ring */
+#define CHUNK 16
+#define BURST 32
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+#if defined(CFG_LOGGER_DEFERRED_FMT)
+#define MODE "deferred"
+#else
+#define MODE "eager"
+#endif /* CFG_LOGGER_DEFERRED_FMT */
+
+extern struct logger_driver_t stdio_logger;
+
+static int _null_writev(void *drv, const struct logger_iovec_t *iov, int cnt)
+{
+	(void)drv;
+	(void)iov;
+	(void)cnt;
+	return 0;
+}
+
+static const struct logger_ops_t null_ops = {
+	.init	= NULL,
+	.write	= NULL,
+	.read	= NULL,
+	.flush	= NULL,
+	.close	= NULL,
+	.writev	= _null_writev,
+};
+
+static struct logger_driver_t null_logger = {
+	.enabled	= true,
+	.name		= "null",
+	.ops		= &null_ops,
+	.priv_data	= NULL,
+};
+
+static struct logger_file_ctxt_t _file_ctxt = {
+	.path	= "logger_bench.log",
+	.sync	= false,
+	.fd	= -1,
+};
+
+struct logger_driver_t *adrivers[] = {
+	&null_logger,
+	&stdio_logger,
+	&file_logger,
+	NULL,
+};
+
+static uint64_t _now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void _result(const char *name, const char *unit, double value)
+{
+	printf("{\"bench\":\"%s\",\"mode\":\"%s\",\"value\":%.1f,\"unit\":\"%s\"}\n",
+	       name, MODE, value, unit);
+}
+
+/* Only one driver at a time */
+static void _use_driver(struct logger_driver_t *drv)
+{
+	for (int i = 0; adrivers[i] != NULL; i++) {
+		adrivers[i]->enabled = adrivers[i] == drv;
+	}
+}
+
+/* The stdio driver writes to stdout, which carries the results */
+static int _mute_stdout(void)
+{
+	int saved = dup(STDOUT_FILENO);
+	int null = open("/dev/null", O_WRONLY);
+
+	fflush(stdout);
+	dup2(null, STDOUT_FILENO);
+	close(null);
+	return saved;
+}
+
+static void _unmute_stdout(int saved)
+{
+	fflush(stdout);
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+}
+
+/* ns per LOG_INFO call, the flushes in between are not counted */
+#define BENCH_CALL(name, ...) \
+	do { \
+		double best = 1e12; \
+		for (int r = 0; r < NR_ROUNDS; r++) { \
+			uint64_t spent = 0; \
+			for (int i = 0; i < NR_CALLS; i += CHUNK) { \
+				uint64_t start = _now_ns(); \
+				for (int j = 0; j < CHUNK; j++) { \
+					LOG_INFO(__VA_ARGS__); \
+				} \
+				spent += _now_ns() - start; \
+				logger_flush(); \
+			} \
+			best = MIN(best, (double)spent / NR_CALLS); \
+		} \
+		_result(name, "ns/call", best); \
+	} while (0)
+
+static void _bench_calls(void)
+{
+	_use_driver(&null_logger);
+
+	BENCH_CALL("call_enabled", "Message %d", 42);
+
+	double best = 1e12;
+	for (int r = 0; r < NR_ROUNDS; r++) {
+		uint64_t start = _now_ns();
+		for (int i = 0; i < NR_FILTERED; i++) {
+			LOG_DEBUG("Filtered %d", i);
+		}
+		best = MIN(best, (double)(_now_ns() - start) / NR_FILTERED);
+	}
+	_result("call_filtered", "ns/call", best);
+}
+
+static void _bench_args(void)
+{
+	_use_driver(&null_logger);
+
+	BENCH_CALL("arg_none", "Static message without arguments");
+	BENCH_CALL("arg_int", "%d", 123456);
+	BENCH_CALL("arg_long", "%ld", -123456789012L);
+	BENCH_CALL("arg_hex", "%08x", 0xdeadbeefU);
+	BENCH_CALL("arg_char", "%c", 'x');
+	BENCH_CALL("arg_string", "%s", "a string argument");
+	BENCH_CALL("arg_pointer", "%p", (void *)&null_logger);
+	BENCH_CALL("arg_double", "%.3f", 3.14159);
+	BENCH_CALL("arg_5_ints", "%d %d %d %d %d", 1, 22, 333, 4444, 55555);
+}
+
+static void _bench_flush(const char *name, struct logger_driver_t *drv)
+{
+	int saved = -1;
+	double best = 1e12;
+
+	_use_driver(drv);
+	if (drv == &stdio_logger) {
+		saved = _mute_stdout();
+	}
+
+	for (int r = 0; r < NR_ROUNDS; r++) {
+		uint64_t spent = 0;
+		for (int i = 0; i < NR_FLUSHES; i++) {
+			for (int j = 0; j < CHUNK; j++) {
+				LOG_INFO("Flushed message %d of %s", j, name);
+			}
+			uint64_t start = _now_ns();
+			logger_flush();
+			spent += _now_ns() - start;
+		}
+		best = MIN(best, (double)spent / (NR_FLUSHES * CHUNK));
+	}
+
+	if (saved >= 0) {
+		_unmute_stdout(saved);
+	}
+	_result(name, "msgs/s", 1e9 / best);
+}
+
+static int _cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void _percentiles(const char *name, uint32_t *lat, size_t nr)
+{
+	static const struct {
+		const char *	suffix;
+		double		p;
+	} pct[] = {
+		{ "p50",  0.50  },
+		{ "p99",  0.99  },
+		{ "p999", 0.999 },
+	};
+	char bench[64];
+
+	qsort(lat, nr, sizeof(*lat), _cmp_u32);
+	for (size_t i = 0; i < sizeof(pct) / sizeof(pct[0]); i++) {
+		snprintf(bench, sizeof(bench), "%s_%s", name, pct[i].suffix);
+		_result(bench, "ns", lat[(size_t)(pct[i].p * (nr - 1))]);
+	}
+}
+
+/* Per call latency in async mode, the drainer writes to the null driver */
+static void _bench_latency(void)
+{
+	struct timespec pause = { .tv_sec = 0, .tv_nsec = 20000 };
+	struct timespec gap = { .tv_sec = 0, .tv_nsec = 1000000 };
+	uint32_t *lat = malloc(NR_STEADY * sizeof(*lat));
+	struct logger_drops_t before, after;
+
+	if (!lat || logger_start_async() < 0) {
+		free(lat);
+		return;
+	}
+	_use_driver(&null_logger);
+
+	/* Steady: one message every 20 us */
+	logger_get_drops(&before);
+	for (int i = 0; i < NR_STEADY; i++) {
+		uint64_t start = _now_ns();
+		LOG_INFO("Steady message %d", i);
+		lat[i] = _now_ns() - start;
+		nanosleep(&pause, NULL);
+	}
+	logger_get_drops(&after);
+	_percentiles("latency_steady", lat, NR_STEADY);
+	_result("latency_steady_drops", "msgs", after.msgs - before.msgs);
+
+	/* Burst: BURST messages back to back, then 1 ms of silence */
+	before = after;
+	for (int i = 0; i < NR_BURSTS; i++) {
+		for (int j = 0; j < BURST; j++) {
+			uint64_t start = _now_ns();
+			LOG_INFO("Burst message %d", j);
+			lat[i * BURST + j] = _now_ns() - start;
+		}
+		nanosleep(&gap, NULL);
+	}
+	logger_get_drops(&after);
+	_percentiles("latency_burst", lat, NR_BURSTS * BURST);
+	_result("latency_burst_drops", "msgs", after.msgs - before.msgs);
+
+	logger_stop_async();
+	free(lat);
+}
+
+int main()
+{
+	file_logger.priv_data = &_file_ctxt;
+	unlink(_file_ctxt.path);
+
+	if (logger_init() < 0) {
+		printf("Failed to initialize the logger\n");
+		return EXIT_FAILURE;
+	}
+	logger_set_loglvl(LOG_LVL_ALL);
+
+	_bench_calls();
+	_bench_args();
+	_bench_flush("flush_null", &null_logger);
+	_bench_flush("flush_stdio", &stdio_logger);
+	_bench_flush("flush_file", &file_logger);
+	_bench_latency();
+
+	for (int i = 0; adrivers[i] != NULL; i++) {
+		adrivers[i]->enabled = true;
+	}
+	logger_close();
+	unlink(_file_ctxt.path);
+
+	return EXIT_SUCCESS;
+}
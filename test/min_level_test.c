@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+#include "test-common.h"
+
+#if CFG_LOGGER_MIN_LEVEL != LOG_LVL_WARN
+#error "Build with -DCFG_LOGGER_MIN_LEVEL=LOG_LVL_WARN"
+#endif /* CFG_LOGGER_MIN_LEVEL */
+
+static struct capture_t _capture;
+
+static struct logger_driver_t capture_logger = CAPTURE_DRIVER("capture", capture_ops, _capture);
+
+struct logger_driver_t *adrivers[] = {
+	&capture_logger,
+	NULL,
+};
+
+int main()
+{
+	int error = 0;
+
+	CHECK(logger_init() == 0);
+	logger_set_loglvl(LOG_LVL_EXTRA);
+
+	/* Below the minimum level nothing is evaluated, whatever the runtime level */
+	LOG_DEBUG("debug %d", test_side_effect());
+	LOG_INFO("info %d", test_side_effect());
+	LOG_OK("ok %d", test_side_effect());
+	LOG_DEBUG_KV("debug", KV_INT("n", test_side_effect()));
+	LOG_INFO_KV("info", KV_INT("n", test_side_effect()));
+	LOG_OK_KV("ok", KV_INT("n", test_side_effect()));
+	logger_flush();
+	CHECK(test_evaluated == 0);
+	CHECK(_capture.lines == 0);
+
+	/* The remaining levels still are */
+	LOG_WARN("warn %d", test_side_effect());
+	LOG_ERROR("error %d", test_side_effect());
+	LOG_WARN_KV("warn", KV_INT("n", test_side_effect()));
+	LOG_ERROR_KV("error", KV_INT("n", test_side_effect()));
+	logger_flush();
+	CHECK(test_evaluated == 4);
+	CHECK(_capture.lines == 4);
+	CHECK(strstr(_capture.last, ": error n=4\r\n") != NULL);
+
+	/* A compiled out call is still a single statement */
+	for (int i = 0; i < 2; i++) {
+		if (i == 0)
+			LOG_DEBUG("if %d", test_side_effect());
+		else
+			LOG_WARN("else %d", test_side_effect());
+	}
+	if (test_evaluated == 5)
+		LOG_INFO("info %d", test_side_effect());
+	else
+		LOG_ERROR("not reached %d", test_side_effect());
+	logger_flush();
+	CHECK(test_evaluated == 5);
+	CHECK(_capture.lines == 5);
+	CHECK(strstr(_capture.last, ": else 5\r\n") != NULL);
+
+	/* No callsite is emitted for them either */
+	for (size_t i = 0; i < logger_callsite_count(); i++) {
+		const struct logger_callsite_t *cs = logger_callsite_get(i);
+
+		if (strstr(cs->file, "min_level_test.c")) {
+			CHECK(cs->lvl >= LOG_LVL_WARN);
+		}
+	}
+
+	logger_close();
+
+	printf("Minimum level test: %s\n", error ? "FAILED" : "OK");
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
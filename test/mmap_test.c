@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "logger.h"
+#include "logger-mmap.h"
+#include "test-common.h"
+
+#define NR_MESSAGES 200
+
+static struct logger_mmap_ctxt_t _ctxt = {
+	.path	= "mmap_test.ring",
+	.size	= 4096,
+	.sync	= false,
+	.fd	= -1,
+};
+
+struct logger_driver_t *adrivers[] = {
+	&mmap_logger,
+	NULL,
+};
+
+/**
+ * @brief  Read the complete tail of the previous run
+ */
+static size_t _read_tail(char *tail, size_t size)
+{
+	size_t len = 0;
+	int n;
+
+	/* Small reads on purpose, every read continues the previous one */
+	while ((n = mmap_logger.ops->read(&mmap_logger, &tail[len],
+					  (size - len < 100) ? size - len : 100)) > 0) {
+		len += n;
+	}
+	return len;
+}
+
+/**
+ * @brief  Check that the tail holds complete, consecutive messages
+ *
+ * @returns  Number of the last message, -1 if failed
+ */
+static int _check_tail(const char *tail)
+{
+	const char *line = tail;
+	int last = -1;
+
+	while (*line) {
+		const char *msg = strstr(line, ": Message ");
+		const char *end = strstr(line, "\r\n");
+		int nr;
+
+		if (line[0] != '[' || !msg || !end || msg > end ||
+		    sscanf(msg, ": Message %d", &nr) != 1) {
+			printf("Unexpected line '%.*s'\n", end ? (int)(end - line) : 40, line);
+			return -1;
+		}
+		if (last >= 0 && nr != last + 1) {
+			printf("Expected message %d, got %d\n", last + 1, nr);
+			return -1;
+		}
+		last = nr;
+		line = end + 2;
+	}
+	return last;
+}
+
+int main()
+{
+	static char tail[8192];
+	int status = 0;
+	int error = 0;
+	pid_t pid;
+
+	unlink(_ctxt.path);
+	mmap_logger.priv_data = &_ctxt;
+
+	/* First run, killed right after writing its messages */
+	pid = fork();
+	if (pid == 0) {
+		logger_init();
+		for (int i = 0; i < NR_MESSAGES; i++) {
+			LOG_INFO("Message %d", i);
+			if (i % 10 == 9) {
+				logger_flush();
+			}
+		}
+		raise(SIGKILL);
+		return 0;
+	}
+	waitpid(pid, &status, 0);
+	CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL);
+
+	/* Second run, recovers the tail of the first one */
+	CHECK(logger_init() == 0);
+	CHECK(_ctxt.hdr->runs == 2 && _ctxt.hdr->seq == NR_MESSAGES);
+	CHECK(_read_tail(tail, sizeof(tail)) > 0);
+	CHECK(_check_tail(tail) == NR_MESSAGES - 1);
+	CHECK(mmap_logger.ops->read(&mmap_logger, tail, sizeof(tail)) == 0);
+
+	/* Crash in the middle of a write: reserved moved, data half copied */
+	LOG_INFO("Message %d", NR_MESSAGES);
+	logger_flush();
+	_ctxt.hdr->reserved = _ctxt.hdr->offset + 64;
+	memset(&_ctxt.data[_ctxt.hdr->offset % _ctxt.size], '#', 64);
+	logger_close();
+
+	CHECK(logger_init() == 0);
+	CHECK(_read_tail(tail, sizeof(tail)) > 0);
+	CHECK(!strchr(tail, '#'));
+	CHECK(_check_tail(tail) == NR_MESSAGES);
+	logger_close();
+
+	/* Not a ring of ours, nothing to recover */
+	FILE *fp = fopen(_ctxt.path, "r+");
+	if (fp) {
+		fputs("garbage", fp);
+		fclose(fp);
+	}
+	CHECK(logger_init() == 0);
+	CHECK(mmap_logger.ops->read(&mmap_logger, tail, sizeof(tail)) == 0);
+	CHECK(_ctxt.hdr->runs == 1);
+	logger_close();
+
+	unlink(_ctxt.path);
+
+	printf("Mmap driver test: %s\n", error ? "FAILED" : "OK");
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+#include "test-common.h"
+
+#define NR_MESSAGES 200
+#define MAX_LINES (2 * NR_MESSAGES)
+
+static char _lines[MAX_LINES][CAPTURE_LINE_LEN];
+static struct capture_t _store = {
+	.hist		= _lines,
+	.nr_hist	= MAX_LINES,
+};
+
+static struct logger_driver_t store_logger = CAPTURE_DRIVER("store", capture_write_ops, _store);
+
+struct logger_driver_t *adrivers[] = {
+	&store_logger,
+	NULL,
+};
+
+/**
+ * @brief  Log a burst without draining, then one more message after the drain
+ */
+static void _burst(enum logger_overflow_t mode)
+{
+	struct logger_overflow_policy_t policy = {
+		.mode		= mode,
+		.timeout_ms	= 100,
+		.spill_size	= 1 << 20,
+	};
+
+	capture_reset(&_store);
+	logger_set_overflow_policy(&policy);
+	for (int i = 0; i < NR_MESSAGES; i++) {
+		LOG_INFO("Message %03d", i);
+	}
+	logger_flush();
+	LOG_INFO("After the burst");
+	logger_flush();
+}
+
+/**
+ * @brief  Retrieve the message number of a line, -1 if it isn't a message
+ */
+static int _msg_nr(const char *line)
+{
+	const char *p = strstr(line, ": Message ");
+
+	return p ? atoi(p + strlen(": Message ")) : -1;
+}
+
+/**
+ * @brief  Retrieve the number of a drop marker line, 0 if it isn't a marker
+ */
+static unsigned _marker(const char *line)
+{
+	const char *p = strstr(line, ": ");
+
+	if (!p || !strstr(line, " messages dropped")) {
+		return 0;
+	}
+	return strtoul(p + 2, NULL, 10);
+}
+
+int main()
+{
+	struct logger_drops_t drops;
+	int error = 0;
+	int nr = 0;
+
+	logger_init();
+
+	/* Drop newest: the first messages survive, the marker comes after them */
+	_burst(LOGGER_OVERFLOW_DROP_NEWEST);
+	logger_get_drops(&drops);
+	for (nr = 0; nr < _store.lines && _msg_nr(_lines[nr]) == nr; nr++) {
+	}
+	CHECK(nr > 0 && nr < NR_MESSAGES);
+	CHECK(drops.msgs == (unsigned long long)(NR_MESSAGES - nr));
+	/* Estimated from the format string, "%03d" is one longer than its output */
+	CHECK(drops.bytes == drops.msgs * (strlen(_lines[0]) + 1));
+	CHECK(_store.lines == nr + 2);
+	CHECK(_marker(_lines[nr]) == drops.msgs);
+	CHECK(strstr(_lines[nr + 1], "After the burst") != NULL);
+
+	/* Overwrite oldest: the last messages survive, the marker comes first */
+	_burst(LOGGER_OVERFLOW_OVERWRITE_OLDEST);
+	struct logger_drops_t prev = drops;
+	logger_get_drops(&drops);
+	unsigned dropped = drops.msgs - prev.msgs;
+	CHECK(dropped > 0 && dropped < NR_MESSAGES);
+	CHECK(_marker(_lines[0]) == dropped);
+	for (nr = 1; nr < _store.lines - 1; nr++) {
+		CHECK(_msg_nr(_lines[nr]) == (int)dropped + nr - 1);
+	}
+	CHECK(_msg_nr(_lines[_store.lines - 2]) == NR_MESSAGES - 1);
+
+	/* Block and spill: nothing is lost */
+	prev = drops;
+	_burst(LOGGER_OVERFLOW_BLOCK);
+	logger_get_drops(&drops);
+	CHECK(drops.msgs == prev.msgs);
+	CHECK(_store.lines == NR_MESSAGES + 1);
+	for (nr = 0; nr < NR_MESSAGES; nr++) {
+		CHECK(_msg_nr(_lines[nr]) == nr);
+	}
+
+	_burst(LOGGER_OVERFLOW_SPILL);
+	logger_get_drops(&drops);
+	CHECK(drops.msgs == prev.msgs);
+	CHECK(_store.lines == NR_MESSAGES + 1);
+	for (nr = 0; nr < NR_MESSAGES; nr++) {
+		CHECK(_msg_nr(_lines[nr]) == nr);
+	}
+
+	logger_close();
+
+	printf("Overflow test: %s\n", error ? "FAILED" : "OK");
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
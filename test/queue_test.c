@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "queue.h"
+#include "test-common.h"
+
+#define NR_PRODUCERS 2
+#define NR_CONSUMERS 2
+#define NR_THREAD_ITEMS 100000
+#define NR_BENCH 1000000
+#define BATCH 32
+
+static struct queue_t *_q;
+static atomic_ullong _sum;
+static atomic_int _popped;
+static int _destroyed;
+
+static void _destroy(void *data)
+{
+	(void)data;
+	_destroyed++;
+}
+
+static void *_producer(void *arg)
+{
+	long base = (long)arg * NR_THREAD_ITEMS;
+
+	for (long i = 1; i <= NR_THREAD_ITEMS; i++) {
+		while (queue_push(_q, (void *)(base + i)) < 0) {
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static void *_consumer(void *arg)
+{
+	void *data = NULL;
+
+	(void)arg;
+	while (atomic_load(&_popped) < NR_PRODUCERS * NR_THREAD_ITEMS) {
+		if (queue_pop(_q, &data) < 0) {
+			sched_yield();
+			continue;
+		}
+		atomic_fetch_add(&_sum, (unsigned long long)(long)data);
+		atomic_fetch_add(&_popped, 1);
+	}
+	return NULL;
+}
+
+/* Sleeps while the queue is full */
+static void *_blocking_producer(void *arg)
+{
+	long base = (long)arg * NR_THREAD_ITEMS;
+
+	for (long i = 1; i <= NR_THREAD_ITEMS; i++) {
+		queue_push_timed(_q, (void *)(base + i), -1);
+	}
+	return NULL;
+}
+
+/* Sleeps while the queue is empty, takes what's there at once */
+static void *_batch_consumer(void *arg)
+{
+	void *batch[BATCH];
+	int n = 0;
+
+	(void)arg;
+	while (atomic_load(&_popped) < NR_PRODUCERS * NR_THREAD_ITEMS) {
+		n = queue_pop_batch_timed(_q, batch, BATCH, 10);
+		for (int i = 0; i < n; i++) {
+			atomic_fetch_add(&_sum, (unsigned long long)(long)batch[i]);
+		}
+		atomic_fetch_add(&_popped, n);
+	}
+	return NULL;
+}
+
+static uint64_t _now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main()
+{
+	pthread_t threads[NR_PRODUCERS + NR_CONSUMERS];
+	void *data = NULL;
+	int error = 0;
+
+	logger_init();
+
+	/* FIFO order */
+	_q = queue_create(NULL);
+	CHECK(_q != NULL);
+	CHECK(queue_pop(_q, &data) == -1);
+	for (long i = 0; i < 10; i++) {
+		CHECK(queue_push(_q, (void *)i) == 0);
+	}
+	CHECK(QUEUE_SIZE(_q) == 10);
+	for (long i = 0; i < 10; i++) {
+		CHECK(queue_pop(_q, &data) == 0 && (long)data == i);
+	}
+	CHECK(queue_pop(_q, &data) == -1 && QUEUE_SIZE(_q) == 0);
+
+	/* The pool doubles when it runs out, then stays put */
+	CHECK(queue_capacity(_q) == CFG_QUEUE_POOL_NODES);
+	for (long i = 0; i < CFG_QUEUE_POOL_NODES + 1; i++) {
+		queue_push(_q, (void *)i);
+	}
+	size_t capacity = queue_capacity(_q);
+	CHECK(capacity == 2 * CFG_QUEUE_POOL_NODES + 1);
+	for (int round = 0; round < 1000; round++) {
+		CHECK(queue_pop(_q, &data) == 0);
+		CHECK(queue_push(_q, data) == 0);
+	}
+	CHECK(queue_capacity(_q) == capacity);
+	queue_destroy(_q);
+
+	/* A bounded queue refuses to grow beyond its limit */
+	_q = queue_create_pool(_destroy, 4, 8);
+	for (long i = 0; i < 8; i++) {
+		CHECK(queue_push(_q, (void *)i) == 0);
+	}
+	CHECK(queue_push(_q, (void *)8) == -1);
+	CHECK(queue_capacity(_q) == 8);
+	CHECK(queue_pop(_q, &data) == 0 && (long)data == 0);
+	CHECK(queue_push(_q, (void *)8) == 0);
+	queue_destroy(_q);
+	CHECK(_destroyed == 8);
+
+	/* Nothing is lost or duplicated with concurrent producers and consumers */
+	_q = queue_create_pool(NULL, 16, 256);
+	for (long i = 0; i < NR_PRODUCERS; i++) {
+		pthread_create(&threads[i], NULL, _producer, (void *)i);
+	}
+	for (int i = 0; i < NR_CONSUMERS; i++) {
+		pthread_create(&threads[NR_PRODUCERS + i], NULL, _consumer, NULL);
+	}
+	for (int i = 0; i < NR_PRODUCERS + NR_CONSUMERS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	unsigned long long n = NR_PRODUCERS * NR_THREAD_ITEMS;
+	CHECK(atomic_load(&_sum) == n * (n + 1) / 2);
+	CHECK(QUEUE_SIZE(_q) == 0);
+	queue_destroy(_q);
+
+	/* Batches come out in order */
+	void *batch[BATCH];
+	_q = queue_create_pool(NULL, 8, 8);
+	CHECK(queue_pop_batch(_q, batch, BATCH) == 0);
+	CHECK(queue_pop_batch(_q, batch, 0) == -1);
+	for (long i = 0; i < 8; i++) {
+		queue_push(_q, (void *)i);
+	}
+	CHECK(queue_pop_batch(_q, batch, 3) == 3);
+	CHECK((long)batch[0] == 0 && (long)batch[2] == 2);
+	CHECK(queue_pop_batch(_q, batch, BATCH) == 5);
+	CHECK((long)batch[0] == 3 && (long)batch[4] == 7);
+
+	/* Timeouts on an empty and on a full queue */
+	uint64_t start = _now_ns();
+	CHECK(queue_pop_timed(_q, &data, 50) == -1);
+	CHECK(_now_ns() - start >= 50000000ULL);
+	for (long i = 0; i < 8; i++) {
+		queue_push(_q, (void *)i);
+	}
+	start = _now_ns();
+	CHECK(queue_push_timed(_q, NULL, 50) == -1);
+	CHECK(_now_ns() - start >= 50000000ULL);
+	CHECK(queue_pop_batch_timed(_q, batch, BATCH, -1) == 8);
+	CHECK(QUEUE_SIZE(_q) == 0 && queue_capacity(_q) == 8);
+	queue_destroy(_q);
+
+	/* Producers and consumers sleep on a small bounded queue */
+	_q = queue_create_pool(NULL, 16, 16);
+	atomic_store(&_sum, 0);
+	atomic_store(&_popped, 0);
+	for (long i = 0; i < NR_PRODUCERS; i++) {
+		pthread_create(&threads[i], NULL, _blocking_producer, (void *)i);
+	}
+	for (int i = 0; i < NR_CONSUMERS; i++) {
+		pthread_create(&threads[NR_PRODUCERS + i], NULL, _batch_consumer, NULL);
+	}
+	for (int i = 0; i < NR_PRODUCERS + NR_CONSUMERS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	CHECK(atomic_load(&_sum) == n * (n + 1) / 2);
+	CHECK(QUEUE_SIZE(_q) == 0 && queue_capacity(_q) == 16);
+	queue_destroy(_q);
+
+	/* Cost of a push and a pop */
+	_q = queue_create(NULL);
+	start = _now_ns();
+	for (long i = 0; i < NR_BENCH; i++) {
+		queue_push(_q, (void *)i);
+		queue_pop(_q, &data);
+	}
+	printf("Push + pop: %.1f ns\n", (double)(_now_ns() - start) / NR_BENCH);
+	queue_destroy(_q);
+
+	logger_close();
+
+	printf("Queue test: %s\n", error ? "FAILED" : "OK");
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
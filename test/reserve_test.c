@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "logger.h"
+#include "test-common.h"
+
+static struct capture_t _capture;
+
+static struct logger_driver_t capture_logger = CAPTURE_DRIVER("capture", capture_ops, _capture);
+
+struct logger_driver_t *adrivers[] = {
+	&capture_logger,
+	NULL,
+};
+
+/* Serializes a "packet" as hex, straight into the ring */
+static int _dump(const unsigned char *pkt, size_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+	char *msg = logger_reserve(LOG_LVL_INFO, 2 * len);
+
+	if (!msg) {
+		return -1;
+	}
+	for (size_t i = 0; i < len; i++) {
+		msg[2 * i] = hex[pkt[i] >> 4];
+		msg[2 * i + 1] = hex[pkt[i] & 0xf];
+	}
+	return logger_commit(2 * len);
+}
+
+static void *_producer(void *arg)
+{
+	(void)arg;
+	char *msg = logger_reserve(LOG_LVL_WARN, 16);
+
+	memcpy(msg, "From a thread", 13);
+	logger_commit(13);
+	return NULL;
+}
+
+int main()
+{
+	unsigned char pkt[64];
+	struct logger_config_t cfg;
+	struct logger_stats_t stats;
+	pthread_t thread;
+	char *msg = NULL;
+	int error = 0;
+
+	for (size_t i = 0; i < sizeof(pkt); i++) {
+		pkt[i] = (unsigned char)i;
+	}
+
+	CHECK(logger_init() == 0);
+	logger_set_loglvl(LOG_LVL_EXTRA);
+
+	/* Written in place, the header is the one of the reservation */
+	CHECK(_dump(pkt, 4) == 0);
+	logger_flush();
+	CHECK(strstr(_capture.last, "_dump") != NULL);
+	CHECK(strstr(_capture.last, ": 00010203\r\n") != NULL);
+
+	/* Only the committed length is kept */
+	msg = logger_reserve(LOG_LVL_ERROR, 100);
+	CHECK(msg != NULL);
+	memcpy(msg, "short", 5);
+	CHECK(logger_commit(5) == 0);
+	logger_flush();
+	CHECK(strstr(_capture.last, ": short\r\n") != NULL);
+
+	/* One reservation at a time */
+	msg = logger_reserve(LOG_LVL_INFO, 8);
+	CHECK(msg != NULL);
+	CHECK(logger_reserve(LOG_LVL_INFO, 8) == NULL);
+	memcpy(msg, "first", 5);
+	CHECK(logger_commit(5) == 0);
+	CHECK(logger_commit(0) == -1);
+
+	/* Without a static callsite */
+	msg = logger_reserve_at(LOG_LVL_OK, "file.c", "fn", 42, 8);
+	CHECK(msg != NULL);
+	memcpy(msg, "located", 7);
+	CHECK(logger_commit(7) == 0);
+	logger_flush();
+	CHECK(strstr(_capture.last, "file.c") != NULL);
+	CHECK(strstr(_capture.last, ": located\r\n") != NULL);
+
+	/* Disabled levels and oversized bodies get nothing */
+	logger_set_loglvl(LOG_LVL_ERROR);
+	CHECK(logger_reserve(LOG_LVL_INFO, 8) == NULL);
+	CHECK(logger_reserve_at(LOG_LVL_INFO, "file.c", "fn", 42, 8) == NULL);
+	CHECK(logger_reserve(LOG_LVL_ERROR, MAX_STR_LEN) == NULL);
+	logger_set_loglvl(LOG_LVL_EXTRA);
+	logger_close();
+
+	/* A full ring drops the reservation and reports it */
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.ring_size = 2048;
+	cfg.max_msg_len = 256;
+	CHECK(logger_init_ex(&cfg) == 0);
+	logger_set_loglvl(LOG_LVL_EXTRA);
+	logger_flush();
+	logger_get_stats(&stats);
+	unsigned long long before = stats.levels[logger_mask2id(LOG_LVL_INFO)].msgs;
+	int stored = 0;
+	while (_dump(pkt, sizeof(pkt)) == 0) {
+		stored++;
+	}
+	CHECK(stored > 0);
+	logger_get_stats(&stats);
+	CHECK(stats.drops.msgs == 1);
+	CHECK(stats.levels[logger_mask2id(LOG_LVL_INFO)].msgs - before == (unsigned long long)stored);
+	_capture.lines = 0;
+	logger_flush();
+	CHECK(_capture.lines == stored);
+	CHECK(_dump(pkt, 1) == 0);
+	logger_flush();
+	CHECK(_capture.lines == stored + 2);
+	CHECK(strstr(_capture.last, ": 00\r\n") != NULL);
+	logger_close();
+
+	/* Thread rings */
+	CHECK(logger_init() == 0);
+	CHECK(logger_start_async() == 0);
+	pthread_create(&thread, NULL, _producer, NULL);
+	pthread_join(thread, NULL);
+	logger_stop_async();
+	CHECK(strstr(_capture.last, ": From a thread\r\n") != NULL);
+	logger_close();
+
+	printf("Reserve test: %s\n", error ? "FAILED" : "OK");
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
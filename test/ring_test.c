@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "cbuffer.h"
+#include "rbuffer.h"
+#include "logger.h"
+
+#define NR_PRODUCERS 4
+#define NR_MESSAGES 100000
+
+/* A LOG_* call reserves room for its longest line, a short line uses less */
+#define CAPACITY_RESERVE 480
+#define CAPACITY_LINE 80
+
+#define ALIGN_UP(x) (((x) + RBUFFER_ALIGN - 1) & ~(size_t)(RBUFFER_ALIGN - 1))
+
+struct msg_t {
+	int	producer;
+	int	seq;
+};
+
+static struct cbuffer_t *_cbuf;
+static struct rbuffer_t *_rbuf;
+
+static void *_cbuffer_producer(void *arg)
+{
+	int id = (int)(intptr_t)arg;
+
+	for (int i = 0; i < NR_MESSAGES; i++) {
+		struct msg_t *msg;
+		while ((msg = cbuffer_get_write_pointer(_cbuf)) == NULL) {
+			sched_yield();
+		}
+		msg->producer = id;
+		msg->seq = i;
+		cbuffer_signal_element_written(_cbuf);
+	}
+	return NULL;
+}
+
+static void *_rbuffer_producer(void *arg)
+{
+	int id = (int)(intptr_t)arg;
+
+	for (int i = 0; i < NR_MESSAGES; i++) {
+		/* Vary the record size to exercise the wrap around */
+		size_t len = sizeof(struct msg_t) + (i % 7) * 8;
+		struct msg_t *msg;
+		while ((msg = rbuffer_get_write_pointer(_rbuf, len)) == NULL) {
+			sched_yield();
+		}
+		msg->producer = id;
+		msg->seq = i;
+		rbuffer_signal_element_written(_rbuf, msg, len);
+	}
+	return NULL;
+}
+
+static int _check(struct msg_t *msg, int *next)
+{
+	if (msg->producer < 0 || msg->producer >= NR_PRODUCERS) {
+		printf("Invalid producer %d\n", msg->producer);
+		return -1;
+	}
+	if (msg->seq != next[msg->producer]) {
+		printf("Producer %d: expected %d got %d\n", msg->producer,
+		       next[msg->producer], msg->seq);
+		return -1;
+	}
+	next[msg->producer]++;
+	return 0;
+}
+
+static int _test_cbuffer(enum cbuffer_mode_t mode, int nr_producers)
+{
+	pthread_t threads[NR_PRODUCERS];
+	struct msg_t *elements = calloc(64, sizeof(struct msg_t));
+	int next[NR_PRODUCERS] = { 0 };
+	int error = 0;
+
+	_cbuf = cbuffer_init_cbuffer_mode(64, mode);
+	if (!_cbuf || (uintptr_t)&_cbuf->tail - (uintptr_t)&_cbuf->head < CBUFFER_CACHE_LINE) {
+		printf("cbuffer: invalid layout\n");
+		return -1;
+	}
+	for (int i = 0; i < 64; i++) {
+		cbuffer_set_element(_cbuf, i, &elements[i]);
+	}
+
+	/* The count follows both indices, a full buffer refuses a write */
+	for (int i = 0; i < 64; i++) {
+		if (!cbuffer_get_write_pointer(_cbuf)) {
+			error = -1;
+		}
+		cbuffer_signal_element_written(_cbuf);
+	}
+	if (cbuffer_get_write_pointer(_cbuf) || cbuffer_get_count(_cbuf) != 64) {
+		error = -1;
+	}
+	for (int i = 0; i < 64; i++) {
+		cbuffer_get_read_pointer(_cbuf);
+		cbuffer_signal_element_read(_cbuf);
+	}
+	if (cbuffer_get_read_pointer(_cbuf) || cbuffer_get_count(_cbuf) != 0) {
+		error = -1;
+	}
+
+	for (int i = 0; i < nr_producers; i++) {
+		pthread_create(&threads[i], NULL, _cbuffer_producer, (void *)(intptr_t)i);
+	}
+
+	for (int received = 0; received < nr_producers * NR_MESSAGES && !error;) {
+		struct msg_t *msg = cbuffer_get_read_pointer(_cbuf);
+		if (!msg) {
+			sched_yield();
+			continue;
+		}
+		error = _check(msg, next);
+		cbuffer_signal_element_read(_cbuf);
+		received++;
+	}
+
+	for (int i = 0; i < nr_producers; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	cbuffer_destroy_cbuffer(_cbuf);
+	free(elements);
+
+	printf("cbuffer %s %d producer(s): %s\n",
+	       mode == CBUFFER_MODE_MPSC ? "MPSC" : "SPSC", nr_producers,
+	       error ? "FAILED" : "OK");
+	return error;
+}
+
+/* Unaligned on purpose */
+static uint8_t _rbuf_mem[1 + 64 + 1024 + 512];
+
+static int _test_rbuffer(enum rbuffer_mode_t mode, int nr_producers, bool external)
+{
+	pthread_t threads[NR_PRODUCERS];
+	int next[NR_PRODUCERS] = { 0 };
+	int error = 0;
+
+	if (external) {
+		_rbuf = rbuffer_init_rbuffer_mem(&_rbuf_mem[1], sizeof(_rbuf_mem) - 1, mode);
+	} else {
+		_rbuf = rbuffer_init_rbuffer_mode(1024, mode);
+	}
+	if (!_rbuf || rbuffer_get_size(_rbuf) != 1024 ||
+	    (uintptr_t)_rbuf->data % RBUFFER_CACHE_LINE ||
+	    offsetof(struct rbuffer_t, tail) - offsetof(struct rbuffer_t, head) <
+	    RBUFFER_CACHE_LINE) {
+		printf("rbuffer: invalid layout\n");
+		return -1;
+	}
+
+	for (int i = 0; i < nr_producers; i++) {
+		pthread_create(&threads[i], NULL, _rbuffer_producer, (void *)(intptr_t)i);
+	}
+
+	for (int received = 0; received < nr_producers * NR_MESSAGES && !error;) {
+		size_t len = 0;
+		struct msg_t *msg = rbuffer_get_read_pointer(_rbuf, &len);
+		if (!msg) {
+			sched_yield();
+			continue;
+		}
+		if (len != sizeof(struct msg_t) + (msg->seq % 7) * 8) {
+			printf("Invalid record length %zu\n", len);
+			error = -1;
+		}
+		error |= _check(msg, next);
+		rbuffer_signal_element_read(_rbuf);
+		received++;
+	}
+
+	for (int i = 0; i < nr_producers; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	rbuffer_destroy_rbuffer(_rbuf);
+
+	printf("rbuffer %s %d producer(s)%s: %s\n",
+	       mode == RBUFFER_MODE_MPSC ? "MPSC" : "SPSC", nr_producers,
+	       external ? " in static memory" : "", error ? "FAILED" : "OK");
+	return error;
+}
+
+/* Room for the alignment, the structure, 256 data bytes and a guard area */
+static uint8_t _wrap_mem[RBUFFER_CACHE_LINE + sizeof(struct rbuffer_t) + 256 + 64];
+
+/*
+ * Walks the write offset over every position in front of the end of the
+ * buffer, 8 bytes before the end included. Nothing may be written past the
+ * data area.
+ */
+static int _test_rbuffer_wrap(enum rbuffer_mode_t mode)
+{
+	struct rbuffer_t *rbuf = NULL;
+	uint8_t *guard = NULL;
+	int error = 0;
+
+	memset(_wrap_mem, 0xa5, sizeof(_wrap_mem));
+	rbuf = rbuffer_init_rbuffer_mem(_wrap_mem, rbuffer_mem_size(256), mode);
+	if (!rbuf || rbuffer_get_size(rbuf) != 256) {
+		printf("rbuffer wrap: invalid layout\n");
+		return -1;
+	}
+	guard = rbuf->data + rbuf->size;
+
+	for (int i = 0; i < 1000 && !error; i++) {
+		size_t len = 1 + (i * 7) % 40;
+		size_t rd_len = 0;
+		uint8_t *msg = rbuffer_get_write_pointer(rbuf, len);
+
+		if (!msg) {
+			printf("rbuffer wrap: no room for %zu bytes\n", len);
+			error = -1;
+			break;
+		}
+		memset(msg, i & 0xff, len);
+		rbuffer_signal_element_written(rbuf, msg, len);
+
+		msg = rbuffer_get_read_pointer(rbuf, &rd_len);
+		if (!msg || rd_len != len || msg[0] != (i & 0xff) ||
+		    msg[len - 1] != (i & 0xff)) {
+			printf("rbuffer wrap: record %d damaged\n", i);
+			error = -1;
+		}
+		rbuffer_signal_element_read(rbuf);
+	}
+
+	for (uint8_t *p = guard; p < &_wrap_mem[sizeof(_wrap_mem)]; p++) {
+		if (*p != 0xa5) {
+			printf("rbuffer wrap: written past the end at %td\n", p - guard);
+			error = -1;
+			break;
+		}
+	}
+	rbuffer_destroy_rbuffer(rbuf);
+
+	printf("rbuffer %s wrap: %s\n", mode == RBUFFER_MODE_MPSC ? "MPSC" : "SPSC",
+	       error ? "FAILED" : "OK");
+	return error;
+}
+
+/*
+ * Fills a CFG_RING_SIZE ring with short lines without reading it. Every line
+ * only takes its committed length, in both modes.
+ */
+static int _test_rbuffer_capacity(enum rbuffer_mode_t mode)
+{
+	size_t rec = ALIGN_UP(sizeof(struct rbuffer_hdr_t) + CAPACITY_LINE);
+	size_t need = ALIGN_UP(sizeof(struct rbuffer_hdr_t) + CAPACITY_RESERVE);
+	struct rbuffer_t *rbuf = rbuffer_init_rbuffer_mode(CFG_RING_SIZE, mode);
+	size_t stored = 0;
+	size_t len = 0;
+	void *msg = NULL;
+	int error = 0;
+
+	while ((msg = rbuffer_get_write_pointer(rbuf, CAPACITY_RESERVE)) != NULL) {
+		memset(msg, 'x', CAPACITY_LINE);
+		rbuffer_signal_element_written(rbuf, msg, CAPACITY_LINE);
+		stored++;
+	}
+	if (stored != (CFG_RING_SIZE - need) / rec + 1 ||
+	    rbuffer_get_used(rbuf) != stored * rec) {
+		printf("rbuffer capacity: %zu lines, %zu bytes used\n", stored,
+		       rbuffer_get_used(rbuf));
+		error = -1;
+	}
+
+	/* Shrunk records read back like the others */
+	for (size_t i = 0; i < stored && !error; i++) {
+		msg = rbuffer_get_read_pointer(rbuf, &len);
+		if (!msg || len != CAPACITY_LINE) {
+			error = -1;
+		}
+		rbuffer_signal_element_read(rbuf);
+	}
+	if (rbuffer_get_read_pointer(rbuf, NULL) || rbuffer_get_used(rbuf) != 0) {
+		error = -1;
+	}
+	rbuffer_destroy_rbuffer(rbuf);
+
+	printf("rbuffer %s capacity: %zu lines, %s\n",
+	       mode == RBUFFER_MODE_MPSC ? "MPSC" : "SPSC", stored, error ? "FAILED" : "OK");
+	return error;
+}
+
+int main()
+{
+	int error = 0;
+
+	error |= _test_cbuffer(CBUFFER_MODE_SPSC, 1);
+	error |= _test_cbuffer(CBUFFER_MODE_MPSC, NR_PRODUCERS);
+	error |= _test_rbuffer(RBUFFER_MODE_SPSC, 1, false);
+	error |= _test_rbuffer(RBUFFER_MODE_MPSC, NR_PRODUCERS, false);
+	error |= _test_rbuffer(RBUFFER_MODE_MPSC, NR_PRODUCERS, true);
+	error |= _test_rbuffer_wrap(RBUFFER_MODE_SPSC);
+	error |= _test_rbuffer_wrap(RBUFFER_MODE_MPSC);
+	error |= _test_rbuffer_capacity(RBUFFER_MODE_SPSC);
+	error |= _test_rbuffer_capacity(RBUFFER_MODE_MPSC);
+
+	/* Too small for the structure and two headers */
+	if (rbuffer_init_rbuffer_mem(_rbuf_mem, 64, RBUFFER_MODE_SPSC) ||
+	    rbuffer_mem_size(1000) < 64 + 1024 + 63) {
+		printf("rbuffer_init_rbuffer_mem: FAILED\n");
+		error = -1;
+	}
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "logger.h"
+#include "rbuffer.h"
+#include "test-common.h"
+
+#define NR_THREADS 4
+#define NR_THREAD_MSGS 20000
+
+extern struct rbuffer_t *_rbuf;
+
+static uint8_t _ring_mem[RBUFFER_CACHE_LINE + sizeof(struct rbuffer_t) + 16384];
+static struct capture_t _slow;
+
+/* Counts what it gets, the write takes at least 50 us */
+static int _slow_writev(void *drv, const struct logger_iovec_t *iov, int cnt)
+{
+	struct timespec delay = { .tv_sec = 0, .tv_nsec = 50000 };
+
+	capture_writev(drv, iov, cnt);
+	nanosleep(&delay, NULL);
+	return 0;
+}
+
+static const struct logger_ops_t slow_ops = {
+	.init	= NULL,
+	.write	= NULL,
+	.read	= NULL,
+	.flush	= capture_flush,
+	.close	= NULL,
+	.writev	= _slow_writev,
+};
+
+static struct logger_driver_t slow_logger = CAPTURE_DRIVER("slow", slow_ops, _slow);
+
+struct logger_driver_t *adrivers[] = {
+	&slow_logger,
+	NULL,
+};
+
+static void *_producer(void *arg)
+{
+	(void)arg;
+	for (int i = 0; i < NR_THREAD_MSGS; i++) {
+		LOG_INFO("Thread message %d", i);
+	}
+	return NULL;
+}
+
+static unsigned long long _hist_calls(const struct logger_hist_t *hist)
+{
+	unsigned long long calls = 0;
+
+	for (int i = 0; i < LOGGER_HIST_BUCKETS; i++) {
+		calls += hist->count[i];
+	}
+	return calls;
+}
+
+int main()
+{
+	struct logger_driver_stats_t drv;
+	struct logger_stats_t stats;
+	pthread_t threads[NR_THREADS];
+	int error = 0;
+
+	logger_init();
+
+	/* Per level counters and bytes */
+	for (int i = 0; i < 100; i++) {
+		LOG_INFO("Info %d", i);
+		if (i % 10 == 0) {
+			LOG_WARN("Warning %d", i);
+		}
+		if (i % 5 == 0) {
+			logger_flush();
+		}
+	}
+	LOG_ERROR("Error");
+	logger_flush();
+
+	logger_get_stats(&stats);
+	CHECK(stats.levels[logger_mask2id(LOG_LVL_INFO)].msgs == 100);
+	CHECK(stats.levels[logger_mask2id(LOG_LVL_WARN)].msgs == 10);
+	CHECK(stats.levels[logger_mask2id(LOG_LVL_ERROR)].msgs == 1);
+	CHECK(stats.levels[logger_mask2id(LOG_LVL_DEBUG)].msgs == 0);
+
+	unsigned long long bytes = 0;
+	for (int i = 0; i < LOGGER_NR_LEVELS; i++) {
+		bytes += stats.levels[i].bytes;
+	}
+	CHECK(bytes == _slow.bytes);
+
+	/* Ring occupancy */
+	CHECK(stats.ring.size >= CFG_RING_SIZE);
+	CHECK(stats.ring.used == 0);
+	CHECK(stats.ring.peak > 0 && stats.ring.peak <= stats.ring.size);
+	CHECK(stats.spill.size == 0 && stats.nr_threads == 0);
+
+	/* Time spent */
+	CHECK(stats.render_ns > 0);
+	CHECK(stats.format_ns > 0);
+
+	/* Driver latencies */
+	CHECK(logger_get_driver_stats(&slow_logger, &drv) == 0);
+	CHECK(logger_get_driver_stats(NULL, &drv) == -1);
+	CHECK(_hist_calls(&drv.write) == (unsigned long long)_slow.writes);
+	CHECK(_hist_calls(&drv.flush) == (unsigned long long)_slow.flushes);
+	CHECK(drv.write.max_ns >= 50000 && drv.write.total_ns >= 50000ULL * _slow.writes);
+	/* 50 us and up, bucket 6 holds [32, 64) us */
+	for (int i = 0; i < 6; i++) {
+		CHECK(drv.write.count[i] == 0);
+	}
+
+	/* Fill the ring, the peak reaches the size and the rest is dropped */
+	for (int i = 0; i < 100; i++) {
+		LOG_INFO("Overflow %d", i);
+	}
+	logger_get_stats(&stats);
+	CHECK(stats.ring.used > 0);
+	CHECK(stats.ring.peak > stats.ring.size / 2);
+	CHECK(stats.drops.msgs > 0);
+	CHECK(stats.levels[logger_mask2id(LOG_LVL_INFO)].msgs + stats.drops.msgs == 200);
+	logger_flush();
+
+	/* Counters don't lose updates with concurrent producers */
+	logger_close();
+	logger_init();
+	for (int i = 0; i < NR_THREADS; i++) {
+		pthread_create(&threads[i], NULL, _producer, NULL);
+	}
+	for (int i = 0; i < NR_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	logger_get_stats(&stats);
+	CHECK(stats.levels[logger_mask2id(LOG_LVL_INFO)].msgs + stats.drops.msgs ==
+	      NR_THREADS * NR_THREAD_MSGS);
+	logger_flush();
+
+	/* Thread rings */
+	CHECK(logger_start_async() == 0);
+	pthread_create(&threads[0], NULL, _producer, NULL);
+	pthread_join(threads[0], NULL);
+	LOG_INFO("From main");
+	logger_get_stats(&stats);
+	CHECK(stats.nr_threads >= 1);
+	CHECK(stats.threads.size >= CFG_RING_THREAD_SIZE && stats.threads.peak > 0);
+	logger_stop_async();
+
+	logger_close();
+
+	/* Shared ring in caller memory */
+	CHECK(logger_set_ring_memory(_ring_mem, sizeof(_ring_mem), 0) == 0);
+	CHECK(logger_init() == 0);
+	CHECK(logger_set_ring_memory(NULL, 0, 0) == -1);
+	LOG_INFO("In static memory");
+	logger_get_stats(&stats);
+	CHECK(stats.ring.size == 16384 && stats.ring.used > 0);
+	CHECK((uint8_t *)_rbuf >= _ring_mem && (uint8_t *)_rbuf < _ring_mem + 128);
+	CHECK((uintptr_t)_rbuf->data % RBUFFER_CACHE_LINE == 0);
+	logger_close();
+
+	/* Runtime size, on huge pages if the system has them */
+	CHECK(logger_set_ring_memory(NULL, 100000, LOGGER_RING_HUGE_PAGES) == 0);
+	for (int i = 0; i < 3; i++) {
+		CHECK(logger_init() == 0);
+		LOG_INFO("Cycle %d", i);
+		logger_get_stats(&stats);
+		CHECK(stats.ring.size == 131072);
+		CHECK((uintptr_t)_rbuf->data % RBUFFER_CACHE_LINE == 0);
+		logger_close();
+	}
+	CHECK(logger_set_ring_memory(NULL, 0, 0) == 0);
+
+	printf("Stats test: %s\n", error ? "FAILED" : "OK");
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
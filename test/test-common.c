@@ -0,0 +1,123 @@
+/**
+ * @file test-common.c
+ * @brief  Capture driver and checks shared by the tests
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v1.0
+ * @date 2026-10-16
+ */
+
+#include <string.h>
+
+#include "test-common.h"
+
+int test_evaluated;
+
+static void _capture_span(struct capture_t *cap, const char *base, size_t len)
+{
+	size_t room;
+
+	if (cap->done) {
+		cap->len = 0;
+		cap->done = false;
+	}
+	room = sizeof(cap->last) - 1 - cap->len;
+	memcpy(&cap->last[cap->len], base, len < room ? len : room);
+	cap->len += len < room ? len : room;
+	cap->last[cap->len] = '\0';
+	cap->bytes += len;
+
+	if (len >= 2 && !memcmp(&base[len - 2], "\r\n", 2)) {
+		if (cap->lines < cap->nr_hist) {
+			memcpy(cap->hist[cap->lines], cap->last, cap->len + 1);
+		}
+		cap->lines++;
+		cap->done = true;
+	}
+}
+
+int capture_writev(void *drv, const struct logger_iovec_t *iov, int cnt)
+{
+	struct capture_t *cap = ((struct logger_driver_t *)drv)->priv_data;
+
+	for (int i = 0; i < cnt; i++) {
+		_capture_span(cap, iov[i].base, iov[i].len);
+	}
+	cap->writes++;
+	return 0;
+}
+
+int capture_write(void *drv, char *str)
+{
+	struct capture_t *cap = ((struct logger_driver_t *)drv)->priv_data;
+
+	_capture_span(cap, str, strlen(str));
+	cap->writes++;
+	return 0;
+}
+
+int capture_entries(void *drv, const struct logger_entry_t *ent, int cnt)
+{
+	struct capture_t *cap = ((struct logger_driver_t *)drv)->priv_data;
+
+	for (int i = 0; i < cnt; i++) {
+		cap->lvl |= ent[i].lvl;
+		cap->lines++;
+	}
+	if (cnt) {
+		cap->last_ent = ent[cnt - 1];
+		memcpy(cap->last_data, ent[cnt - 1].data, ent[cnt - 1].len);
+		cap->last_ent.data = cap->last_data;
+	}
+	cap->writes++;
+	return 0;
+}
+
+int capture_flush(void *drv)
+{
+	struct capture_t *cap = ((struct logger_driver_t *)drv)->priv_data;
+
+	cap->flushes++;
+	return 0;
+}
+
+void capture_reset(struct capture_t *cap)
+{
+	char (*hist)[CAPTURE_LINE_LEN] = cap->hist;
+	int nr_hist = cap->nr_hist;
+
+	memset(cap, 0, sizeof(*cap));
+	cap->hist = hist;
+	cap->nr_hist = nr_hist;
+}
+
+int test_side_effect(void)
+{
+	return ++test_evaluated;
+}
+
+const struct logger_ops_t capture_ops = {
+	.init	= NULL,
+	.write	= NULL,
+	.read	= NULL,
+	.flush	= capture_flush,
+	.close	= NULL,
+	.writev	= capture_writev,
+};
+
+const struct logger_ops_t capture_write_ops = {
+	.init	= NULL,
+	.write	= capture_write,
+	.read	= NULL,
+	.flush	= capture_flush,
+	.close	= NULL,
+};
+
+const struct logger_ops_t capture_entries_ops = {
+	.init		= NULL,
+	.write		= NULL,
+	.read		= NULL,
+	.flush		= capture_flush,
+	.close		= NULL,
+	.writev		= NULL,
+	.write_entries	= capture_entries,
+};
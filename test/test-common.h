@@ -0,0 +1,89 @@
+/**
+ * @file test-common.h
+ * @brief  Capture driver and checks shared by the tests
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v1.0
+ * @date 2026-10-16
+ */
+
+#ifndef _TEST_COMMON_H_
+#define _TEST_COMMON_H_
+
+#include <stdio.h>
+
+#include "logger.h"
+
+#define CAPTURE_LINE_LEN (MAX_STR_LEN + 256) //!< Room for a line with its prefix
+
+/* Prints the failed condition and fails the test through the local 'error' */
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: check '%s' failed\n", __FILE__, __LINE__, #cond); \
+			error = -1; \
+		} \
+	} while (0)
+
+/* A capture driver, the ops find this structure through priv_data */
+#define CAPTURE_DRIVER(_name, _ops, _cap) \
+	{ \
+		.enabled	= true, \
+		.name		= _name, \
+		.ops		= &(_ops), \
+		.priv_data	= &(_cap), \
+	}
+
+struct capture_t {
+	char	last[CAPTURE_LINE_LEN];         //!< Last complete line
+	size_t	len;                            //!< Length of the line being collected
+	bool	done;                           //!< The line in last is complete
+	char	(*hist)[CAPTURE_LINE_LEN];      //!< Optional, keeps the first nr_hist lines
+	int	nr_hist;                        //!< Size of hist
+	int	lines;                          //!< Lines or entries written
+	int	writes;                         //!< Calls of the write ops
+	int	flushes;                        //!< Calls of the flush op
+	size_t	bytes;                          //!< Bytes written
+	int	lvl;                            //!< Levels of the entries
+	struct logger_entry_t last_ent;         //!< Last entry, data points to last_data
+	char	last_data[MAX_STR_LEN];         //!< Body of the last entry
+};
+
+extern const struct logger_ops_t capture_ops;         //!< writev and flush
+extern const struct logger_ops_t capture_write_ops;   //!< write and flush
+extern const struct logger_ops_t capture_entries_ops; //!< write_entries and flush
+
+extern int test_evaluated; //!< Calls of test_side_effect()
+
+/**
+ * @brief  Collect the spans into lines, the time stamp may come as a separate span
+ */
+int capture_writev(void *drv, const struct logger_iovec_t *iov, int cnt);
+
+/**
+ * @brief  Collect one span
+ */
+int capture_write(void *drv, char *str);
+
+/**
+ * @brief  Keep the last entry and the levels of all entries
+ */
+int capture_entries(void *drv, const struct logger_entry_t *ent, int cnt);
+
+/**
+ * @brief  Count the flushes
+ */
+int capture_flush(void *drv);
+
+/**
+ * @brief  Forget everything captured so far, hist stays attached
+ */
+void capture_reset(struct capture_t *cap);
+
+/**
+ * @brief  Argument that shows whether a log call evaluated it
+ *
+ * @returns  Number of calls so far
+ */
+int test_side_effect(void);
+
+#endif /* _TEST_COMMON_H_ */
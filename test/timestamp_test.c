@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "logger.h"
+#include "test-common.h"
+
+static struct capture_t _capture;
+
+static struct logger_driver_t capture_logger = CAPTURE_DRIVER("capture", capture_ops, _capture);
+
+struct logger_driver_t *adrivers[] = {
+	&capture_logger,
+	NULL,
+};
+
+/**
+ * @brief  Log one message and return its line
+ */
+static const char *_log_line(void)
+{
+	capture_reset(&_capture);
+	LOG_INFO("Stamped message");
+	logger_flush();
+	return _capture.last;
+}
+
+int main()
+{
+	struct timespec delay = { .tv_sec = 0, .tv_nsec = 20000000 };
+	unsigned long sec = 0;
+	unsigned us = 0;
+	double prev = -1;
+	int error = 0;
+	int n = 0;
+
+	logger_init();
+
+	/* Default: no time stamp */
+	CHECK(logger_get_ts_format() == LOGGER_TS_NONE);
+	CHECK(_log_line()[0] == '[' && strstr(_log_line(), " INFO") != NULL);
+
+	CHECK(logger_set_ts_format(LOGGER_TS_UTC + 1) == -1);
+
+	/* Uptime, increasing */
+	CHECK(logger_set_ts_format(LOGGER_TS_UPTIME) == 0);
+	for (int i = 0; i < 3; i++) {
+		const char *line = _log_line();
+		double t;
+
+		CHECK(sscanf(line, "[%lf] %n", &t, &n) == 1 && n == 15);
+		CHECK(t > prev && t < 10.0);
+		prev = t;
+		nanosleep(&delay, NULL);
+	}
+
+	/* Seconds since the epoch */
+	CHECK(logger_set_ts_format(LOGGER_TS_EPOCH) == 0);
+	CHECK(sscanf(_log_line(), "%lu.%6u %n", &sec, &us, &n) == 2 && n == 18);
+	CHECK(labs((long)sec - (long)time(NULL)) <= 2);
+
+	/* UTC date, compared with gmtime() */
+	CHECK(logger_set_ts_format(LOGGER_TS_UTC) == 0);
+	for (int i = 0; i < 2; i++) {
+		char expected[32];
+		time_t now = time(NULL);
+		struct tm tm;
+		const char *line = _log_line();
+
+		gmtime_r(&now, &tm);
+		strftime(expected, sizeof(expected), "%Y-%m-%dT%H:%M", &tm);
+		CHECK(strncmp(line, expected, strlen(expected)) == 0);
+		CHECK(line[26] == 'Z' && line[27] == ' ' && line[28] == '[');
+	}
+
+	/* RAW messages never get a time stamp */
+	capture_reset(&_capture);
+	LOG_RAW("raw");
+	logger_flush();
+	CHECK(!strcmp(_capture.last, "raw\r\n"));
+
+	logger_set_ts_format(LOGGER_TS_NONE);
+	logger_close();
+
+	/* Stamping cost */
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < 1000000; i++) {
+		prev += logger_clock_ns();
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("logger_clock_ns: %.1f ns\n",
+	       ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / 1e6);
+
+	printf("Timestamp test: %s\n", error ? "FAILED" : "OK");
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "tracer.h"
+#include "test-common.h"
+
+#define NR_THREADS 4
+#define NR_SPANS 100
+#define NR_BENCH 1000000
+
+static _Thread_local volatile unsigned _work;
+static pthread_barrier_t _barrier;
+
+static void _inner(void)
+{
+	TRACE_SCOPE("inner");
+
+	for (int i = 0; i < 100; i++) {
+		_work += i;
+	}
+}
+
+static void *_worker(void *arg)
+{
+	char name[16];
+
+	snprintf(name, sizeof(name), "worker %d", (int)(long)arg);
+	tracer_set_thread_name(name);
+
+	/* All threads own a ring at the same time */
+	pthread_barrier_wait(&_barrier);
+	for (int i = 0; i < NR_SPANS; i++) {
+		TRACE_SCOPE("outer");
+		_inner();
+		_inner();
+	}
+	return NULL;
+}
+
+static void *_reset(void *arg)
+{
+	(void)arg;
+	tracer_reset();
+	return NULL;
+}
+
+/**
+ * @brief  Export to memory
+ */
+static char *_export(int *count)
+{
+	char *json = NULL;
+	size_t len = 0;
+	FILE *out = open_memstream(&json, &len);
+
+	*count = tracer_export_chrome(out);
+	fclose(out);
+	return json;
+}
+
+static int _occurrences(const char *str, const char *what)
+{
+	int n = 0;
+
+	for (str = strstr(str, what); str; str = strstr(str + 1, what)) {
+		n++;
+	}
+	return n;
+}
+
+int main()
+{
+	pthread_t threads[NR_THREADS];
+	int error = 0;
+	int count = 0;
+	char *json = NULL;
+
+	/* Nested spans in a few threads */
+	pthread_barrier_init(&_barrier, NULL, NR_THREADS);
+	for (long i = 0; i < NR_THREADS; i++) {
+		pthread_create(&threads[i], NULL, _worker, (void *)i);
+	}
+	for (int i = 0; i < NR_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	json = _export(&count);
+	CHECK(count == NR_THREADS * NR_SPANS * 3);
+	CHECK(_occurrences(json, "\"name\":\"outer\"") == NR_THREADS * NR_SPANS);
+	CHECK(_occurrences(json, "\"name\":\"inner\"") == 2 * NR_THREADS * NR_SPANS);
+	CHECK(_occurrences(json, "\"ph\":\"M\"") == NR_THREADS);
+	pthread_barrier_destroy(&_barrier);
+	CHECK(strstr(json, "\"args\":{\"name\":\"worker 3\"}") != NULL);
+	CHECK(!strncmp(json, "{\"traceEvents\":[", 16));
+	CHECK(strstr(json, "],\"displayTimeUnit\":\"ns\"}\n") != NULL);
+	free(json);
+
+	/* An inner span ends first and lies within its outer span */
+	tracer_reset();
+	unsigned long long outer_ts, inner_ts, outer_dur, inner_dur;
+	unsigned outer_ns, inner_ns, outer_dns, inner_dns;
+	{
+		TRACE_BEGIN(outer, "outer");
+		_inner();
+		TRACE_END(outer);
+	}
+	json = _export(&count);
+	CHECK(count == 2);
+	CHECK(sscanf(strstr(json, "\"inner\""), "\"inner\",\"ph\":\"X\",\"ts\":%llu.%u,\"dur\":%llu.%u",
+		     &inner_ts, &inner_ns, &inner_dur, &inner_dns) == 4);
+	CHECK(sscanf(strstr(json, "\"outer\""), "\"outer\",\"ph\":\"X\",\"ts\":%llu.%u,\"dur\":%llu.%u",
+		     &outer_ts, &outer_ns, &outer_dur, &outer_dns) == 4);
+	CHECK(strstr(json, "\"inner\"") < strstr(json, "\"outer\""));
+	inner_ts = inner_ts * 1000 + inner_ns;
+	outer_ts = outer_ts * 1000 + outer_ns;
+	inner_dur = inner_dur * 1000 + inner_dns;
+	outer_dur = outer_dur * 1000 + outer_dns;
+	CHECK(outer_ts <= inner_ts && inner_ts + inner_dur <= outer_ts + outer_dur);
+	free(json);
+
+	/* Only the last spans are kept, the oldest slot may be in use */
+	tracer_reset();
+	for (int i = 0; i < CFG_TRACER_RING_EVENTS + 10; i++) {
+		TRACE_SCOPE(i < 10 ? "old" : "new");
+	}
+	json = _export(&count);
+	CHECK(count == CFG_TRACER_RING_EVENTS - 1);
+	CHECK(strstr(json, "\"old\"") == NULL);
+	free(json);
+
+	/* Nothing is recorded while disabled */
+	tracer_reset();
+	tracer_set_enabled(false);
+	_inner();
+	tracer_set_enabled(true);
+	json = _export(&count);
+	CHECK(count == 0);
+	free(json);
+
+	/* A reset from another thread, the owner applies it with its next span */
+	_inner();
+	pthread_create(&threads[0], NULL, _reset, NULL);
+	pthread_join(threads[0], NULL);
+	json = _export(&count);
+	CHECK(count == 0);
+	free(json);
+	_inner();
+	json = _export(&count);
+	CHECK(count == 1);
+	free(json);
+
+	/* Cost of a span */
+	uint64_t start = tracer_now_ns();
+	for (int i = 0; i < NR_BENCH; i++) {
+		TRACE_SCOPE("bench");
+	}
+	printf("Span: %.1f ns\n", (double)(tracer_now_ns() - start) / NR_BENCH);
+
+	printf("Tracer test: %s\n", error ? "FAILED" : "OK");
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
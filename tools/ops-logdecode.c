@@ -0,0 +1,93 @@
+/**
+ * @file ops-logdecode.c
+ * @brief  Turn binary log files back into text or JSON lines
+ *
+ * Usage: ops-logdecode [-j] [-t none|uptime|epoch|utc] [file...]
+ * Reads stdin when no file is given.
+ *
+ * @author Bram Vlerick <bram.vlerick@openpixelsystems.org>
+ * @version v0.1
+ * @date 2026-10-16
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "logger-bin.h"
+
+static const char *_ts_names[] = {
+	[LOGGER_TS_NONE]	= "none",
+	[LOGGER_TS_UPTIME]	= "uptime",
+	[LOGGER_TS_EPOCH]	= "epoch",
+	[LOGGER_TS_UTC]		= "utc",
+};
+
+static void _usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-j] [-t none|uptime|epoch|utc] [file...]\n"
+		"  -j  one JSON object per message\n"
+		"  -t  time stamp format (default: none)\n", name);
+}
+
+static int _decode(FILE *in, const char *name, enum logger_bin_output_t fmt,
+		   enum logger_ts_format_t ts)
+{
+	if (logger_bin_decode(in, stdout, fmt, ts) < 0) {
+		fprintf(stderr, "%s: damaged or unsupported binary log\n", name);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	enum logger_bin_output_t fmt = LOGGER_BIN_OUT_TEXT;
+	enum logger_ts_format_t ts = LOGGER_TS_NONE;
+	int error = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "jt:h")) != -1) {
+		switch (opt) {
+		case 'j':
+			fmt = LOGGER_BIN_OUT_JSON;
+			break;
+		case 't':
+			for (ts = LOGGER_TS_NONE; ts <= LOGGER_TS_UTC; ts++) {
+				if (!strcmp(optarg, _ts_names[ts])) {
+					break;
+				}
+			}
+			if (ts > LOGGER_TS_UTC) {
+				_usage(argv[0]);
+				return 1;
+			}
+			break;
+		default:
+			_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (optind == argc) {
+		return _decode(stdin, "stdin", fmt, ts) < 0 ? 1 : 0;
+	}
+
+	for (int i = optind; i < argc; i++) {
+		FILE *in = fopen(argv[i], "rb");
+
+		if (!in) {
+			fprintf(stderr, "%s: %s\n", argv[i], strerror(errno));
+			error = 1;
+			continue;
+		}
+		if (_decode(in, argv[i], fmt, ts) < 0) {
+			error = 1;
+		}
+		fclose(in);
+	}
+
+	return error;
+}